@@ -0,0 +1,17 @@
+#!/bin/sh
+# Per-call overhead of an Algorithm invocation: bench/calls.ps makes 10^6
+# calls to an identity Algorithm, bench/loop.ps runs the same loop without
+# them. The difference, divided by the call count, is the cost of a call.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+CALLS=1000000
+
+time_us() {
+    $SHELL_BIN --time "$@" | sed -n 's/^Execution time: \([0-9]*\) us$/\1/p'
+}
+
+for engine in "" "--vm"; do
+    with_calls=$(time_us $engine bench/calls.ps)
+    without_calls=$(time_us $engine bench/loop.ps)
+    echo "${engine:-tree}: $(( (with_calls - without_calls) * 1000 / CALLS )) ns per call"
+done
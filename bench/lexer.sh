@@ -0,0 +1,15 @@
+#!/bin/sh
+# Lexer throughput: bench/lexer.ps is repeated into a script of about
+# SIZE_MB megabytes, which is only lexed, never run.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+SIZE_MB=${SIZE_MB:-50}
+SCRIPT=$(mktemp)
+
+{ cat bench/lexer.ps; echo; } > "$SCRIPT.chunk"
+COPIES=$((SIZE_MB * 1000000 / $(wc -c < "$SCRIPT.chunk")))
+LINES=$((COPIES * $(wc -l < "$SCRIPT.chunk")))
+yes "$(cat "$SCRIPT.chunk")" | head -n $LINES > "$SCRIPT"
+
+$SHELL_BIN --lex-bench "$SCRIPT"
+rm -f "$SCRIPT" "$SCRIPT.chunk"
\ No newline at end of file
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Parser throughput: bench/parser.ps is repeated into a script of about
+# SIZE_MB megabytes, which is only parsed, never run.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+SIZE_MB=${SIZE_MB:-20}
+SCRIPT=$(mktemp)
+
+{ cat bench/parser.ps; echo; } > "$SCRIPT.chunk"
+COPIES=$((SIZE_MB * 1000000 / $(wc -c < "$SCRIPT.chunk")))
+LINES=$((COPIES * $(wc -l < "$SCRIPT.chunk")))
+yes "$(cat "$SCRIPT.chunk")" | head -n $LINES > "$SCRIPT"
+
+$SHELL_BIN --parse-bench "$SCRIPT"
+rm -f "$SCRIPT" "$SCRIPT.chunk"
\ No newline at end of file
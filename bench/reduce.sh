@@ -0,0 +1,48 @@
+#!/bin/sh
+# Element throughput of the array builtins and operators against the loops
+# they replace.
+# Each script first builds an Int array `a` and a Float array `f` of
+# ELEMENTS elements; that time, measured on its own, is taken off. The
+# builtin runs REPS times, the loop once.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+ELEMENTS=${ELEMENTS:-1000000}
+REPS=${REPS:-200}
+DIR=$(mktemp -d)
+
+time_us() {
+    $SHELL_BIN --time "$@" | sed -n 's/^Execution time: \([0-9]*\) us$/\1/p'
+}
+
+setup="a <- for i <- 1 to $ELEMENTS do i % 1000
+f <- for i <- 1 to $ELEMENTS do i * 0.5"
+
+# name, builtin call or operation, loop doing the same.
+bench() {
+    printf '%s\n' "$setup" > "$DIR/setup.ps"
+    printf '%s\nfor r <- 1 to %s do\n    x <- %s\n' "$setup" "$REPS" "$2" > "$DIR/builtin.ps"
+    printf '%s\n%s\n' "$setup" "$3" > "$DIR/loop.ps"
+    for engine in "" "--vm"; do
+        base=$(time_us $engine "$DIR/setup.ps")
+        builtin=$(time_us $engine "$DIR/builtin.ps")
+        loop=$(time_us $engine "$DIR/loop.ps")
+        echo "${engine:-tree} $1: $(( ELEMENTS * REPS / (builtin - base + 1) )) M elements/s," \
+            "loop $(( ELEMENTS / (loop - base + 1) )) M elements/s"
+    done
+}
+
+bench "sum" "sum(a)" "x <- 0
+for i <- 1 to $ELEMENTS do
+    x <- x + a[i]"
+bench "max_of" "max_of(f)" "x <- f[1]
+for i <- 2 to $ELEMENTS do
+    if f[i] > x then x <- f[i]"
+bench "count" "count(a, 7)" "x <- 0
+for i <- 1 to $ELEMENTS do
+    if a[i] = 7 then x <- x + 1"
+bench "a * 3 + a" "a * 3 + a" "x <- for i <- 1 to $ELEMENTS do a[i] * 3 + a[i]"
+bench "dot" "dot(f, f)" "x <- 0.0
+for i <- 1 to $ELEMENTS do
+    x <- x + f[i] * f[i]"
+
+rm -rf "$DIR"
@@ -0,0 +1,109 @@
+/// --------------------
+/// Bytecode
+/// --------------------
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <cstdint>
+#include <utility>
+#include "node.h"
+#include "value.h"
+#include "resolver.h"
+
+enum class OpCode : uint8_t {
+    // a: constant index
+    Constant,
+    Pop,
+    // a: slot in the current frame
+    LoadLocal, StoreLocal,
+    // a: index into the global array
+    LoadGlobal, StoreGlobal,
+    // a: name index, looked up through the calling frames
+    LoadName,
+    Add, Sub, Mul, Div, Mod, Pow,
+    Equal, Neq, Less, Greater, Leq, Geq,
+    And, Or,
+    // Only in specialized versions, on operands known to be Int
+    AddInt, SubInt, MulInt,
+    EqualInt, NeqInt, LessInt, GreaterInt, LeqInt, GeqInt,
+    // Only in specialized versions, on numbers at least one of which is a Float
+    AddFloat, SubFloat, MulFloat,
+    EqualFloat, NeqFloat, LessFloat, GreaterFloat, LeqFloat, GeqFloat,
+    Negate, Not,
+    // a: jump target
+    Jump,
+    // Jump with the error left on the stack as the result of the construct
+    JumpIfError,
+    // Pops the condition, jumps unless it reads as 1
+    JumpIfFalse,
+    // Pops the condition, jumps when it reads as 0
+    JumpIfZero,
+    // Jumps leaving 0 when the operand on top makes an `and` false, and
+    // leaving it when it is an error. Pops it otherwise
+    JumpIfFalsy,
+    // Same for `or`, leaving 1 when the operand makes it true
+    JumpIfTruthy,
+    // Replaces the operand on top with 0 or 1, an error stays
+    Truth,
+    // Pop the two operands and jump to a unless the comparison holds. An
+    // error it gives is left on the stack with a jump to b
+    JumpUnlessEqual, JumpUnlessNeq, JumpUnlessLess, JumpUnlessGreater, JumpUnlessLeq, JumpUnlessGeq,
+    // a: number of elements taken from the stack
+    MakeArray,
+    // a: slot holding the array, pops the value to append
+    AppendLocal,
+    ArrayGet, ArraySet,
+    // a: number of arguments, the callee sits below them
+    Call,
+    // Call whose result is returned right away, made in place of the
+    // current frame when no callee can see it
+    TailCall,
+    Return,
+    // a: index into functions
+    MakeAlgo,
+    // a: first of the four loop slots (counter, end, step, direction),
+    // b: jump target when the step is 0
+    ForPrepare,
+    // a: loop slots, b: jump target once the counter passed the end
+    ForTest,
+    // a: loop slots, pushes the advanced counter
+    ForStep,
+    // a: loop slots, b: slot of the collected array. Ends the first pass of
+    // a loop over a constant: when the counter, end and step are Ints, the
+    // constant is appended for all passes but the last at once, and the
+    // counter moved to the last one
+    ForFill
+};
+
+struct Instruction {
+    OpCode op;
+    int32_t a, b;
+};
+
+/// A compiled Algorithm body, or a top level statement.
+struct FunctionProto {
+    std::string name;
+    std::shared_ptr<Node> def;
+    bool top_level{false};
+    // Named slots of an Algorithm, null at the top level. The rest of
+    // slot_count are compiler temporaries.
+    std::shared_ptr<FrameLayout> layout;
+    int slot_count{0};
+    std::vector<Instruction> code;
+    std::vector<TaggedValue> constants;
+    std::vector<std::shared_ptr<FunctionProto>> functions;
+    // Cache of a pure `memo` Algorithm, owned by its definition node.
+    MemoCache *memo{nullptr};
+    // Versions compiled for the argument kinds the Algorithm was called
+    // with, one bit per parameter set for Float. A null version means the
+    // kinds gave nothing to specialize.
+    std::vector<std::pair<uint32_t, std::shared_ptr<FunctionProto>>> specializations;
+    bool specialized{false};
+};
+
+#endif
\ No newline at end of file
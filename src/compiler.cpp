@@ -0,0 +1,496 @@
+/// --------------------
+/// Compiler
+/// --------------------
+
+#include "compiler.h"
+#include "symboltable.h"
+#include "node.h"
+#include "value.h"
+#include "optimizer.h"
+#include <algorithm>
+
+std::shared_ptr<FunctionProto> Compiler::compile_top_level(std::shared_ptr<Node> node) {
+    std::shared_ptr<FunctionProto> ret{std::make_shared<FunctionProto>()};
+    ret->name = "<top>";
+    ret->def = node;
+    ret->top_level = true;
+    proto = ret.get();
+    temp_top = 0;
+    compile(node);
+    emit(OpCode::Return);
+    proto = nullptr;
+    return ret;
+}
+
+std::shared_ptr<FunctionProto> Compiler::compile_specialized(std::shared_ptr<Node> node, const std::vector<StaticType> &params) {
+    AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+    TypeInference inference(*algo_def->get_layout(), params);
+    inference.infer(algo_def->get_body());
+    std::shared_ptr<FunctionProto> ret{compile_algo(node, &inference)};
+    ret->specialized = true;
+    for(auto &ins : ret->code) {
+        if(OpCode::AddInt <= ins.op && ins.op <= OpCode::GeqFloat)
+            return ret;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<FunctionProto> Compiler::compile_algo(std::shared_ptr<Node> node, const TypeInference *algo_types) {
+    FunctionProto *outer_proto{proto};
+    int outer_temp_top{temp_top};
+    const TypeInference *outer_types{types};
+    types = algo_types;
+
+    std::shared_ptr<FunctionProto> ret{std::make_shared<FunctionProto>()};
+    ret->name = node->get_name();
+    ret->def = node;
+    proto = ret.get();
+    proto->layout = static_cast<AlgorithmDefNode*>(node.get())->get_layout();
+    proto->slot_count = proto->layout->slot_count();
+    proto->memo = static_cast<AlgorithmDefNode*>(node.get())->get_memo_cache();
+    const NodeList &body{node->get_child()};
+    temp_top = proto->slot_count;
+
+    // The body runs to its end even when a statement fails, and the last
+    // statement is the result.
+    if(body.empty())
+        emit_constant(TaggedValue());
+    for(size_t i{0}; i < body.size(); ++i) {
+        if(i + 1 < body.size()) {
+            compile(body[i]);
+            emit(OpCode::Pop);
+        } else {
+            compile_tail(body[i]);
+        }
+    }
+    emit(OpCode::Return);
+
+    proto = outer_proto;
+    temp_top = outer_temp_top;
+    types = outer_types;
+    return ret;
+}
+
+void Compiler::compile(std::shared_ptr<Node> node) {
+    switch(node->get_kind()) {
+        case NodeKind::Value: return compile_number(node);
+        case NodeKind::VarAccess: return compile_var_access(node);
+        case NodeKind::VarAssign: return compile_var_assign(node);
+        case NodeKind::BinOp: return compile_bin_op(node);
+        case NodeKind::UnaryOp: return compile_unary_op(node);
+        case NodeKind::If: return compile_if(node);
+        case NodeKind::For: return compile_for(node);
+        case NodeKind::While: return compile_while(node);
+        case NodeKind::Repeat: return compile_repeat(node);
+        case NodeKind::AlgoDef: return compile_algo_def(node);
+        case NodeKind::AlgoCall: return compile_algo_call(node);
+        case NodeKind::Array: return compile_array(node);
+        case NodeKind::ArrAccess: return compile_array_access(node);
+        case NodeKind::ArrAssign: return compile_array_assign(node);
+        case NodeKind::Const:
+            emit_constant(static_cast<ConstNode*>(node.get())->get_value());
+            return;
+        default: break;
+    }
+    emit_constant(make_error("Fail to get result\n"));
+}
+
+// A statement whose value is returned by the Algorithm. Calls in such a
+// position, directly or at the end of an if branch, become TailCall.
+void Compiler::compile_tail(std::shared_ptr<Node> node) {
+    switch(node->get_kind()) {
+        case NodeKind::If: return compile_if(node, true);
+        case NodeKind::AlgoCall: return compile_algo_call(node, true);
+        default: return compile(node);
+    }
+}
+
+void Compiler::compile_number(std::shared_ptr<Node> node) {
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Int: emit_constant(make_int(std::stoll(node->get_tok()->get_value()))); break;
+        case TokenKind::Float: emit_constant(make_float(std::stod(node->get_tok()->get_value()))); break;
+        case TokenKind::String: emit_constant(make_string(node->get_tok()->get_value())); break;
+        default: emit_constant(make_error("Not a value type\n")); break;
+    }
+}
+
+void Compiler::compile_var_access(std::shared_ptr<Node> node) {
+    VarAccessNode *var = static_cast<VarAccessNode*>(node.get());
+    // Builtin names are lexed as their own token and can never be assigned.
+    if(node->get_tok()->get_kind() == TokenKind::BuiltinAlgo && BUILTIN_ALGOS.count(var->get_name())) {
+        emit_constant(BUILTIN_ALGOS.at(var->get_name()));
+        return;
+    }
+    switch(var->get_scope()) {
+        case VarScope::Local: emit(OpCode::LoadLocal, var->get_index()); break;
+        case VarScope::Global: emit(OpCode::LoadGlobal, var->get_index()); break;
+        default: emit(OpCode::LoadName, var->get_index()); break;
+    }
+}
+
+void Compiler::compile_var_assign(std::shared_ptr<Node> node) {
+    VarAssignNode *var = static_cast<VarAssignNode*>(node.get());
+    compile(node->get_child()[0]);
+    int error_jump{emit(OpCode::JumpIfError)};
+    store(var->get_scope(), var->get_index());
+    patch(error_jump);
+}
+
+// In a specialized version, operations on numbers of known types skip the
+// kind checks of the value operators.
+static OpCode typed_op_code(TokenKind kind, bool both_int) {
+    switch(kind) {
+        case TokenKind::Add: return both_int ? OpCode::AddInt : OpCode::AddFloat;
+        case TokenKind::Sub: return both_int ? OpCode::SubInt : OpCode::SubFloat;
+        case TokenKind::Mul: return both_int ? OpCode::MulInt : OpCode::MulFloat;
+        case TokenKind::Equal: return both_int ? OpCode::EqualInt : OpCode::EqualFloat;
+        case TokenKind::Neq: return both_int ? OpCode::NeqInt : OpCode::NeqFloat;
+        case TokenKind::Less: return both_int ? OpCode::LessInt : OpCode::LessFloat;
+        case TokenKind::Greater: return both_int ? OpCode::GreaterInt : OpCode::GreaterFloat;
+        case TokenKind::Leq: return both_int ? OpCode::LeqInt : OpCode::LeqFloat;
+        case TokenKind::Geq: return both_int ? OpCode::GeqInt : OpCode::GeqFloat;
+        default: return OpCode::Pop;
+    }
+}
+
+void Compiler::compile_bin_op(std::shared_ptr<Node> node) {
+    TokenKind op{static_cast<BinOpNode*>(node.get())->get_op()};
+    if(op == TokenKind::And || op == TokenKind::Or)
+        return compile_logical(node);
+    const NodeList &child{node->get_child()};
+    compile(child[0]);
+    compile(child[1]);
+    if(types != nullptr) {
+        StaticType left{types->type_of(child[0].get())}, right{types->type_of(child[1].get())};
+        bool both_number{(left == StaticType::Int || left == StaticType::Float)
+            && (right == StaticType::Int || right == StaticType::Float)};
+        OpCode op{typed_op_code(node->get_tok()->get_kind(), left == StaticType::Int && right == StaticType::Int)};
+        if(both_number && op != OpCode::Pop) {
+            emit(op);
+            return;
+        }
+    }
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Add: emit(OpCode::Add); break;
+        case TokenKind::Sub: emit(OpCode::Sub); break;
+        case TokenKind::Mul: emit(OpCode::Mul); break;
+        case TokenKind::Div: emit(OpCode::Div); break;
+        case TokenKind::Mod: emit(OpCode::Mod); break;
+        case TokenKind::Pow: emit(OpCode::Pow); break;
+        case TokenKind::Equal: emit(OpCode::Equal); break;
+        case TokenKind::Neq: emit(OpCode::Neq); break;
+        case TokenKind::Less: emit(OpCode::Less); break;
+        case TokenKind::Greater: emit(OpCode::Greater); break;
+        case TokenKind::Leq: emit(OpCode::Leq); break;
+        case TokenKind::Geq: emit(OpCode::Geq); break;
+        case TokenKind::And: emit(OpCode::And); break;
+        case TokenKind::Or: emit(OpCode::Or); break;
+        default:
+            emit(OpCode::Pop);
+            emit(OpCode::Pop);
+            emit_constant(make_error("Not a binary op\n"));
+            break;
+    }
+}
+
+// The right side only runs when the left one does not decide.
+void Compiler::compile_logical(std::shared_ptr<Node> node) {
+    BinOpNode *bin_op_node = static_cast<BinOpNode*>(node.get());
+    compile(bin_op_node->get_left());
+    int end_jump{emit(bin_op_node->get_op() == TokenKind::And ? OpCode::JumpIfFalsy : OpCode::JumpIfTruthy)};
+    compile(bin_op_node->get_right());
+    emit(OpCode::Truth);
+    patch(end_jump);
+}
+
+static OpCode compare_jump(TokenKind kind) {
+    switch(kind) {
+        case TokenKind::Equal: return OpCode::JumpUnlessEqual;
+        case TokenKind::Neq: return OpCode::JumpUnlessNeq;
+        case TokenKind::Less: return OpCode::JumpUnlessLess;
+        case TokenKind::Greater: return OpCode::JumpUnlessGreater;
+        case TokenKind::Leq: return OpCode::JumpUnlessLeq;
+        case TokenKind::Geq: return OpCode::JumpUnlessGeq;
+        default: return OpCode::Pop;
+    }
+}
+
+static bool is_compare_jump(OpCode op) {
+    return OpCode::JumpUnlessEqual <= op && op <= OpCode::JumpUnlessGeq;
+}
+
+// Compiles a condition and jump, whose target in a the caller sets. A
+// comparison gives 0 or 1, and branches on its operands without pushing
+// it. An error ends the construct, through one of error_jumps.
+int Compiler::compile_condition(std::shared_ptr<Node> node, std::vector<int> &error_jumps, OpCode jump) {
+    if(node->get_kind() == NodeKind::BinOp) {
+        BinOpNode *bin_op_node = static_cast<BinOpNode*>(node.get());
+        OpCode op{compare_jump(bin_op_node->get_op())};
+        if(op != OpCode::Pop) {
+            compile(bin_op_node->get_left());
+            compile(bin_op_node->get_right());
+            error_jumps.push_back(emit(op));
+            return error_jumps.back();
+        }
+    }
+    compile(node);
+    error_jumps.push_back(emit(OpCode::JumpIfError));
+    return emit(jump);
+}
+
+void Compiler::compile_unary_op(std::shared_ptr<Node> node) {
+    compile(node->get_child()[0]);
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Add: break;
+        case TokenKind::Sub: emit(OpCode::Negate); break;
+        case TokenKind::Not: emit(OpCode::Not); break;
+        default:
+            emit(OpCode::Pop);
+            emit_constant(make_error("Not an unary op\n"));
+            break;
+    }
+}
+
+void Compiler::compile_array(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    for(auto &element : child)
+        compile(element);
+    emit(OpCode::MakeArray, child.size());
+}
+
+void Compiler::compile_array_access(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    compile(child[0]);
+    compile(child[1]);
+    emit(OpCode::ArrayGet);
+}
+
+void Compiler::compile_array_assign(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    if(child[0]->get_kind() != NodeKind::ArrAccess) {
+        emit_constant(make_error("Access can only apply on array\n"));
+        return;
+    }
+    const NodeList &target{child[0]->get_child()};
+    compile(target[0]);
+    compile(target[1]);
+    compile(child[1]);
+    emit(OpCode::ArraySet);
+}
+
+// Statements of an if branch; a failing one ends the whole if.
+void Compiler::compile_branch(NodeSpan body, std::vector<int> &error_jumps, bool tail) {
+    if(body.empty())
+        emit_constant(TaggedValue());
+    for(size_t i{0}; i < body.size(); ++i) {
+        if(tail && i + 1 == body.size())
+            compile_tail(body[i]);
+        else
+            compile(body[i]);
+        if(i + 1 < body.size()) {
+            error_jumps.push_back(emit(OpCode::JumpIfError));
+            emit(OpCode::Pop);
+        }
+    }
+}
+
+// A loop with a single statement collects its results into result_slot,
+// unless the loop's own value is unused. Longer bodies throw theirs away.
+// A failing statement ends the loop with the error as its value.
+void Compiler::compile_loop_body(NodeSpan body, bool collect, int result_slot, std::vector<int> &error_jumps) {
+    for(auto &stmt : body) {
+        compile(stmt);
+        error_jumps.push_back(emit(OpCode::JumpIfError));
+        if(collect)
+            emit(OpCode::AppendLocal, result_slot);
+        else
+            emit(OpCode::Pop);
+    }
+}
+
+void Compiler::compile_if(std::shared_ptr<Node> node, bool tail) {
+    IfNode* if_node = dynamic_cast<IfNode*>(node.get());
+    std::vector<int> end_jumps;
+    int else_jump{compile_condition(if_node->get_condition(), end_jumps)};
+    compile_branch(if_node->get_expr(), end_jumps, tail);
+    end_jumps.push_back(emit(OpCode::Jump));
+    proto->code[else_jump].a = here();
+    if(!if_node->get_else().empty())
+        compile_branch(if_node->get_else(), end_jumps, tail);
+    else
+        emit_constant(make_int(0));
+    patch(end_jumps);
+}
+
+void Compiler::compile_for(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 3);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    int outer_temp_top{temp_top};
+    int loop_slots{alloc_temp(4)}, result_slot{alloc_temp()};
+    std::vector<int> end_jumps;
+
+    // Start, step and end are evaluated in that order, each may fail.
+    compile(child[0]);
+    end_jumps.push_back(emit(OpCode::JumpIfError));
+    emit(OpCode::StoreLocal, loop_slots);
+    emit(OpCode::Pop);
+    if(child[2] != nullptr) {
+        compile(child[2]);
+        end_jumps.push_back(emit(OpCode::JumpIfError));
+    } else {
+        emit_constant(make_int(1));
+    }
+    emit(OpCode::StoreLocal, loop_slots + 2);
+    emit(OpCode::Pop);
+    compile(child[1]);
+    end_jumps.push_back(emit(OpCode::JumpIfError));
+    emit(OpCode::StoreLocal, loop_slots + 1);
+    emit(OpCode::Pop);
+    int zero_step_jump{emit(OpCode::ForPrepare, loop_slots)};
+
+    if(collect) {
+        emit(OpCode::MakeArray, 0);
+        emit(OpCode::StoreLocal, result_slot);
+        emit(OpCode::Pop);
+    }
+    int loop_start{here()};
+    int exit_jump{emit(OpCode::ForTest, loop_slots)};
+    compile_loop_body(body, collect, result_slot, end_jumps);
+    if(collect && body[0]->get_kind() == NodeKind::Const)
+        emit(OpCode::ForFill, loop_slots, result_slot);
+    // The counter is kept apart from the variable, the body may assign the
+    // variable without changing how many times the loop runs.
+    emit(OpCode::ForStep, loop_slots);
+    VarAssignNode *var = static_cast<VarAssignNode*>(child[0].get());
+    store(var->get_scope(), var->get_index());
+    emit(OpCode::Pop);
+    emit(OpCode::Jump, loop_start);
+
+    proto->code[exit_jump].b = here();
+    if(!node->is_value_used()) {
+        emit_constant(TaggedValue());
+    } else if(collect) {
+        emit(OpCode::LoadLocal, result_slot);
+    } else {
+        emit_constant(TaggedValue());
+        emit(OpCode::MakeArray, 1);
+    }
+    patch(end_jumps);
+    proto->code[zero_step_jump].b = here();
+    temp_top = outer_temp_top;
+}
+
+void Compiler::compile_while(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 1);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    int outer_temp_top{temp_top};
+    int result_slot{alloc_temp()};
+    std::vector<int> end_jumps;
+
+    if(collect) {
+        emit(OpCode::MakeArray, 0);
+        emit(OpCode::StoreLocal, result_slot);
+        emit(OpCode::Pop);
+    }
+    int loop_start{here()};
+    int exit_jump{compile_condition(child[0], end_jumps)};
+    compile_loop_body(body, collect, result_slot, end_jumps);
+    emit(OpCode::Jump, loop_start);
+
+    proto->code[exit_jump].a = here();
+    if(!node->is_value_used())
+        emit_constant(TaggedValue());
+    else if(collect)
+        emit(OpCode::LoadLocal, result_slot);
+    else
+        emit(OpCode::MakeArray, 0);
+    patch(end_jumps);
+    temp_top = outer_temp_top;
+}
+
+void Compiler::compile_repeat(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 1);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    int outer_temp_top{temp_top};
+    int result_slot{alloc_temp()};
+    std::vector<int> end_jumps;
+
+    if(collect) {
+        emit(OpCode::MakeArray, 0);
+        emit(OpCode::StoreLocal, result_slot);
+        emit(OpCode::Pop);
+    }
+    int loop_start{here()};
+    compile_loop_body(body, collect, result_slot, end_jumps);
+    int repeat_jump{compile_condition(child[0], end_jumps, OpCode::JumpIfZero)};
+    proto->code[repeat_jump].a = loop_start;
+
+    if(!node->is_value_used())
+        emit_constant(TaggedValue());
+    else if(collect)
+        emit(OpCode::LoadLocal, result_slot);
+    else
+        emit(OpCode::MakeArray, 0);
+    patch(end_jumps);
+    temp_top = outer_temp_top;
+}
+
+void Compiler::compile_algo_def(std::shared_ptr<Node> node) {
+    proto->functions.push_back(compile_algo(node));
+    emit(OpCode::MakeAlgo, proto->functions.size() - 1);
+    AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+    store(algo_def->get_scope(), algo_def->get_index());
+}
+
+void Compiler::compile_algo_call(std::shared_ptr<Node> node, bool tail) {
+    AlgorithmCallNode *algo_call_node = dynamic_cast<AlgorithmCallNode*>(node.get());
+    const NodeList &child{node->get_child()};
+    compile(algo_call_node->get_call());
+    for(auto &arg : child)
+        compile(arg);
+    emit(tail ? OpCode::TailCall : OpCode::Call, child.size());
+}
+
+// Leaves the stored value on the stack. Resolver makes every assigned name
+// either a global or a local.
+void Compiler::store(VarScope scope, int index) {
+    if(scope == VarScope::Global)
+        emit(OpCode::StoreGlobal, index);
+    else
+        emit(OpCode::StoreLocal, index);
+}
+
+int Compiler::emit(OpCode op, int32_t a, int32_t b) {
+    proto->code.push_back(Instruction{op, a, b});
+    return proto->code.size() - 1;
+}
+
+int Compiler::emit_constant(TaggedValue value) {
+    proto->constants.push_back(std::move(value));
+    return emit(OpCode::Constant, proto->constants.size() - 1);
+}
+
+// Points a forward jump at the next instruction. For a compare and branch
+// that is the jump an error takes, the other one is set by its caller.
+void Compiler::patch(int at) {
+    Instruction &ins{proto->code[at]};
+    if(is_compare_jump(ins.op))
+        ins.b = here();
+    else
+        ins.a = here();
+}
+
+void Compiler::patch(const std::vector<int> &at) {
+    for(int index : at)
+        patch(index);
+}
+
+int Compiler::alloc_temp(int count) {
+    int ret{temp_top};
+    temp_top += count;
+    proto->slot_count = std::max(proto->slot_count, temp_top);
+    return ret;
+}
\ No newline at end of file
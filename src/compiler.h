@@ -0,0 +1,65 @@
+/// --------------------
+/// Compiler
+/// --------------------
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "bytecode.h"
+#include "typeinfer.h"
+#include "node.h"
+#include "value.h"
+#include <memory>
+#include <vector>
+
+/// Turns the NodeList returned by Parser::parse(), after Resolver, into
+/// FunctionProtos for the VM. Every construct leaves exactly one value on the stack, errors
+/// included, the same way Interpreter::visit returns one.
+class Compiler {
+public:
+    Compiler()
+        : proto(nullptr), temp_top(0), types(nullptr) {}
+    std::shared_ptr<FunctionProto> compile_top_level(std::shared_ptr<Node>);
+    // Compiles an Algorithm again for parameters of the given types. Null
+    // when no operation in it could be specialized.
+    std::shared_ptr<FunctionProto> compile_specialized(std::shared_ptr<Node>, const std::vector<StaticType> &params);
+
+protected:
+    std::shared_ptr<FunctionProto> compile_algo(std::shared_ptr<Node>, const TypeInference *algo_types = nullptr);
+    void compile(std::shared_ptr<Node>);
+    void compile_tail(std::shared_ptr<Node>);
+    void compile_number(std::shared_ptr<Node>);
+    void compile_var_access(std::shared_ptr<Node>);
+    void compile_var_assign(std::shared_ptr<Node>);
+    void compile_bin_op(std::shared_ptr<Node>);
+    void compile_logical(std::shared_ptr<Node>);
+    int compile_condition(std::shared_ptr<Node>, std::vector<int> &error_jumps, OpCode jump = OpCode::JumpIfFalse);
+    void compile_unary_op(std::shared_ptr<Node>);
+    void compile_array(std::shared_ptr<Node>);
+    void compile_array_access(std::shared_ptr<Node>);
+    void compile_array_assign(std::shared_ptr<Node>);
+    void compile_if(std::shared_ptr<Node>, bool tail = false);
+    void compile_for(std::shared_ptr<Node>);
+    void compile_while(std::shared_ptr<Node>);
+    void compile_repeat(std::shared_ptr<Node>);
+    void compile_algo_def(std::shared_ptr<Node>);
+    void compile_algo_call(std::shared_ptr<Node>, bool tail = false);
+
+    void compile_branch(NodeSpan, std::vector<int> &error_jumps, bool tail = false);
+    void compile_loop_body(NodeSpan, bool collect, int result_slot, std::vector<int> &error_jumps);
+    void store(VarScope, int index);
+
+    int emit(OpCode, int32_t a = 0, int32_t b = 0);
+    int emit_constant(TaggedValue);
+    void patch(int at);
+    void patch(const std::vector<int> &at);
+    int here() const { return proto->code.size();}
+    int alloc_temp(int count = 1);
+
+    FunctionProto *proto;
+    int temp_top;
+    // Types of the Algorithm being specialized, null otherwise.
+    const TypeInference *types;
+};
+
+#endif
\ No newline at end of file
@@ -5,300 +5,552 @@
 #include "interpreter.h"
 #include "node.h"
 #include "value.h"
+#include "optimizer.h"
 #include <iostream>
 #include <memory>
 #include <functional>
 
-std::shared_ptr<Value> Interpreter::visit(std::shared_ptr<Node> node) {
-    if(node->get_type() == NODE_VALUE) {
-        return visit_number(node);
+TaggedValue Interpreter::visit(const std::shared_ptr<Node> &node) {
+    switch(node->get_kind()) {
+        case NodeKind::Value: return visit_number(node);
+        case NodeKind::VarAccess: return visit_var_access(node);
+        case NodeKind::VarAssign: return visit_var_assign(node);
+        case NodeKind::BinOp: return visit_bin_op(node);
+        case NodeKind::UnaryOp: return visit_unary_op(node);
+        case NodeKind::If: return visit_if(node);
+        case NodeKind::For: return visit_for(node);
+        case NodeKind::While: return visit_while(node);
+        case NodeKind::Repeat: return visit_repeat(node);
+        case NodeKind::AlgoDef: return visit_algo_def(node);
+        case NodeKind::AlgoCall: return visit_algo_call(node);
+        case NodeKind::Array: return visit_array(node);
+        case NodeKind::ArrAccess: return visit_array_access(node);
+        case NodeKind::ArrAssign: return visit_array_assign(node);
+        case NodeKind::Const: return static_cast<ConstNode*>(node.get())->get_value();
+        default: break;
     }
-    if(node->get_type() == NODE_VARACCESS) {
-        return visit_var_access(node);
-    }
-    if(node->get_type() == NODE_VARASSIGN) {
-        return visit_var_assign(node);
-    }
-    if(node->get_type() == NODE_BINOP) {
-        return visit_bin_op(node);
-    }
-    if(node->get_type() == NODE_UNARYOP) {
-        return visit_unary_op(node);
-    }
-    if(node->get_type() == NODE_IF) {
-        return visit_if(node);
-    }
-    if(node->get_type() == NODE_FOR) {
-        return visit_for(node);
+    return make_error("Fail to get result\n");
+}
+
+TaggedValue Interpreter::visit_number(const std::shared_ptr<Node> &node) {
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Int: return make_int(std::stoll(node->get_tok()->get_value()));
+        case TokenKind::Float: return make_float(std::stod(node->get_tok()->get_value()));
+        case TokenKind::String: return make_string(node->get_tok()->get_value());
+        default: return make_error("Not a value type\n");
     }
-    if(node->get_type() == NODE_WHILE) {
-        return visit_while(node);
+}
+
+static inline const TaggedValue* find_slot(SymbolTable &symbol_table, VarAccessNode *var) {
+    switch(var->get_scope()) {
+        case VarScope::Local: return symbol_table.find_local(var->get_index());
+        case VarScope::Global: return symbol_table.find_global(var->get_index());
+        default: return nullptr;
     }
-    if(node->get_type() == NODE_REPEAT) {
-        return visit_repeat(node);
+}
+
+// A local or global found in its slot is read in place from then on.
+TaggedValue Interpreter::visit_var_access(const std::shared_ptr<Node> &node) {
+    VarAccessNode *var = static_cast<VarAccessNode*>(node.get());
+    if(node->get_quickened() == Quickened::Slot) {
+        if(const TaggedValue *value{find_slot(symbol_table, var)})
+            return *value;
+        despecialize(node.get());
     }
-    if(node->get_type() == NODE_ALGODEF) {
-        return visit_algo_def(node);
+    TaggedValue ret;
+    switch(var->get_scope()) {
+        case VarScope::Local: ret = symbol_table.get_local(var->get_index()); break;
+        case VarScope::Global: ret = symbol_table.get_global(var->get_index()); break;
+        case VarScope::Dynamic: ret = symbol_table.lookup(var->get_index()); break;
+        default: return make_error("Identifier: \"" + var->get_name() + "\" was not resolved\n");
     }
-    if(node->get_type() == NODE_ALGOCALL) {
-        return visit_algo_call(node);
+    if(node->get_quickened() == Quickened::Uninitialized)
+        quicken(node.get(), find_slot(symbol_table, var) != nullptr ? Quickened::Slot : Quickened::Generic);
+    return ret;
+}
+
+TaggedValue Interpreter::visit_var_assign(const std::shared_ptr<Node> &node) {
+    VarAssignNode *var = static_cast<VarAssignNode*>(node.get());
+    const NodeList &child{node->get_child()};
+    TaggedValue value = visit(child[0]);
+    if(value.is_error())
+        return value;
+    return assign(var->get_scope(), var->get_index(), value);
+}
+
+// Resolver makes every assigned name either a global or a local.
+TaggedValue Interpreter::assign(VarScope scope, int index, const TaggedValue &value) {
+    if(scope == VarScope::Global)
+        symbol_table.set_global(index, value);
+    else
+        symbol_table.set_local(index, value);
+    return value;
+}
+
+template<typename T>
+static inline bool compare(TokenKind op, T x, T y) {
+    switch(op) {
+        case TokenKind::Equal: return x == y;
+        case TokenKind::Neq: return x != y;
+        case TokenKind::Less: return x < y;
+        case TokenKind::Greater: return x > y;
+        case TokenKind::Leq: return x <= y;
+        default: return x >= y;
     }
-    if(node->get_type() == NODE_ARRAY) {
-        return visit_array(node);
+}
+
+// Operators that cannot fail on numbers, computed on int64_t or double.
+template<typename T>
+static inline TaggedValue number_bin_op(TokenKind op, T x, T y) {
+    switch(op) {
+        case TokenKind::Add: return make_number(x + y);
+        case TokenKind::Sub: return make_number(x - y);
+        case TokenKind::Mul: return make_number(x * y);
+        default: return make_int(compare(op, x, y));
     }
-    if(node->get_type() == NODE_ARRACCESS) {
-        return visit_array_access(node);
+}
+
+static inline bool is_number(const TaggedValue &a) {
+    return a.get_kind() == ValueKind::Int || a.get_kind() == ValueKind::Float;
+}
+
+static inline bool is_float_pair(const TaggedValue &a, const TaggedValue &b) {
+    return is_number(a) && is_number(b) && (a.get_kind() == ValueKind::Float || b.get_kind() == ValueKind::Float);
+}
+
+static Quickened quicken_bin_op(TokenKind op, const TaggedValue &a, const TaggedValue &b) {
+    switch(op) {
+        case TokenKind::Add: case TokenKind::Sub: case TokenKind::Mul:
+        case TokenKind::Equal: case TokenKind::Neq: case TokenKind::Less:
+        case TokenKind::Greater: case TokenKind::Leq: case TokenKind::Geq:
+            break;
+        default: return Quickened::Generic;
     }
-    if(node->get_type() == NODE_ARRASSIGN) {
-        return visit_array_assign(node);
+    if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int)
+        return Quickened::Int;
+    return is_float_pair(a, b) ? Quickened::Float : Quickened::Generic;
+}
+
+TaggedValue Interpreter::visit_bin_op(const std::shared_ptr<Node> &node) {
+    BinOpNode *bin_op_node = static_cast<BinOpNode*>(node.get());
+    if(bin_op_node->get_op() == TokenKind::And || bin_op_node->get_op() == TokenKind::Or)
+        return visit_logical(node);
+    TaggedValue a, b;
+    a = visit(bin_op_node->get_left());
+    b = visit(bin_op_node->get_right());
+    switch(node->get_quickened()) {
+        case Quickened::Int:
+            if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int)
+                return number_bin_op(bin_op_node->get_op(), a.get_int(), b.get_int());
+            despecialize(node.get());
+            break;
+        case Quickened::Float:
+            if(is_float_pair(a, b))
+                return number_bin_op(bin_op_node->get_op(), a.get_float(), b.get_float());
+            despecialize(node.get());
+            break;
+        case Quickened::Uninitialized:
+            quicken(node.get(), quicken_bin_op(bin_op_node->get_op(), a, b));
+            break;
+        default: break;
     }
-    return std::make_shared<ErrorValue>(VALUE_ERROR, "Fail to get result\n");
+    if(a.is_error() || b.is_error())
+        return a.is_error() ? a : b;
+    return bin_op(a, b, node->get_tok());
 }
 
-std::shared_ptr<Value> Interpreter::visit_number(std::shared_ptr<Node> node) {
-    if(node->get_tok()->get_type() == TOKEN_INT) 
-        return std::make_shared<TypedValue<int64_t>>(VALUE_INT, std::stoll(node->get_tok()->get_value()));
-    else if(node->get_tok()->get_type() == TOKEN_FLOAT)
-        return std::make_shared<TypedValue<double>>(VALUE_FLOAT, std::stod(node->get_tok()->get_value()));
-    else if(node->get_tok()->get_type() == TOKEN_STRING)
-        return std::make_shared<TypedValue<std::string>>(VALUE_STRING, node->get_tok()->get_value());
-    else
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Not a value type\n");
+TaggedValue Interpreter::visit_logical(const std::shared_ptr<Node> &node) {
+    TaggedValue error;
+    bool ret{visit_truth(node, error)};
+    return error.is_error() ? error : make_int(ret);
 }
 
-std::shared_ptr<Value> Interpreter::visit_var_access(std::shared_ptr<Node> node) {
-    std::string var_name = node->get_name();
-    return symbol_table.get(var_name);
+static inline bool is_comparison(TokenKind op) {
+    switch(op) {
+        case TokenKind::Equal: case TokenKind::Neq: case TokenKind::Less:
+        case TokenKind::Greater: case TokenKind::Leq: case TokenKind::Geq:
+            return true;
+        default: return false;
+    }
 }
 
-std::shared_ptr<Value> Interpreter::visit_var_assign(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    std::string var_name = node->get_name();
-    std::shared_ptr<Value> value = visit(child[0]);
-    if(value->get_type() == VALUE_ERROR)
-        return value;
-    symbol_table.set(var_name, value);
-    return symbol_table.get(var_name);
+static inline bool is_fused(std::shared_ptr<Node> node) {
+    if(node->get_kind() != NodeKind::BinOp)
+        return false;
+    TokenKind op{static_cast<BinOpNode*>(node.get())->get_op()};
+    return op == TokenKind::And || op == TokenKind::Or || is_comparison(op);
 }
 
-std::shared_ptr<Value> Interpreter::visit_bin_op(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    std::shared_ptr<Value> a, b;
-    a = visit(child[0]);
-    b = visit(child[1]);
-    if(a->get_type() == VALUE_ERROR || b->get_type() == VALUE_ERROR)
-        return a->get_type() == VALUE_ERROR ? a : b;
-    return bin_op(a, b, node->get_tok());
+// The condition of an if or a loop, read as as_integer reads its value.
+// Comparisons and `and`/`or` give their 0 or 1 without building it. An
+// error is left in error.
+int64_t Interpreter::visit_condition(const std::shared_ptr<Node> &node, TaggedValue &error) {
+    if(is_fused(node))
+        return visit_truth(node, error);
+    TaggedValue value{visit(node)};
+    if(value.is_error()) {
+        error = std::move(value);
+        return 0;
+    }
+    return as_integer(value);
+}
+
+// Comparisons of two numbers are computed natively, `and` and `or` only
+// visit their right side when the left one does not decide. An error
+// stops the evaluation and is left in error.
+bool Interpreter::visit_truth(const std::shared_ptr<Node> &node, TaggedValue &error) {
+    if(is_fused(node)) {
+        BinOpNode *bin_op_node = static_cast<BinOpNode*>(node.get());
+        TokenKind op{bin_op_node->get_op()};
+        if(op == TokenKind::And || op == TokenKind::Or) {
+            bool left{visit_truth(bin_op_node->get_left(), error)};
+            if(error.is_error() || left == (op == TokenKind::Or))
+                return left;
+            return visit_truth(bin_op_node->get_right(), error);
+        }
+        TaggedValue a, b;
+        a = visit(bin_op_node->get_left());
+        b = visit(bin_op_node->get_right());
+        if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int)
+            return compare(op, a.get_int(), b.get_int());
+        if(is_number(a) && is_number(b))
+            return compare(op, a.get_float(), b.get_float());
+        if(a.is_error() || b.is_error()) {
+            error = a.is_error() ? a : b;
+            return false;
+        }
+        TaggedValue result{bin_op(a, b, node->get_tok())};
+        if(result.is_error()) {
+            error = std::move(result);
+            return false;
+        }
+        return is_truthy(result);
+    }
+    TaggedValue value{visit(node)};
+    if(value.is_error()) {
+        error = std::move(value);
+        return false;
+    }
+    return is_truthy(value);
 }
 
-std::shared_ptr<Value> Interpreter::visit_unary_op(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    std::shared_ptr<Value> a = visit(child[0]);
-    if(a->get_type() == VALUE_ERROR)
+TaggedValue Interpreter::visit_unary_op(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
+    TaggedValue a = visit(child[0]);
+    if(a.is_error())
         return a;
     return unary_op(a, node->get_tok());
 }
 
-std::shared_ptr<Value> Interpreter::visit_array(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
+TaggedValue Interpreter::visit_array(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
     ValueList array_value;
-    for(int i{0}; i < child.size(); ++i) {
+    for(size_t i{0}; i < child.size(); ++i) {
         array_value.push_back(visit(child[i]));
     }
-    return std::make_shared<ArrayValue>(array_value);
+    return make_boxed<ArrayValue>(std::move(array_value));
 }
 
-std::shared_ptr<Value>& Interpreter::visit_array_access(std::shared_ptr<Node> node) {
-    NodeList child{node->get_child()};
-    std::shared_ptr<Value> arr{visit(child[0])}, index{visit(child[1])};
-    if(arr->get_type() != VALUE_ARRAY) {
-        error = std::make_shared<ErrorValue>(VALUE_ERROR, "Access can only apply on array, find " + 
-            arr->get_type() + "\n");
-        return error;
+TaggedValue Interpreter::visit_array_access(const std::shared_ptr<Node> &node) {
+    ArrayAccessNode *access = static_cast<ArrayAccessNode*>(node.get());
+    TaggedValue arr{visit(access->get_arr())}, index{visit(access->get_index())};
+    bool int_index{arr.get_kind() == ValueKind::Array && index.get_kind() == ValueKind::Int};
+    switch(node->get_quickened()) {
+        case Quickened::IntIndex:
+            if(int_index)
+                return arr.as<ArrayValue>()->get(index.get_int());
+            despecialize(node.get());
+            break;
+        case Quickened::Uninitialized:
+            quicken(node.get(), int_index ? Quickened::IntIndex : Quickened::Generic);
+            break;
+        default: break;
     }
-    algo_call_temp = arr;
-    return dynamic_cast<ArrayValue*>(arr.get())->operator[](std::stoll(index->get_num()));
+    return index_get(arr, index);
 }
 
-std::shared_ptr<Value> Interpreter::visit_array_assign(std::shared_ptr<Node> node) {
-    NodeList child{node->get_child()};
-    if(child[0]->get_type() != NODE_ARRACCESS) {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Access can only apply on array\n");
+// An assignment that misses the container still evaluates to the value.
+TaggedValue Interpreter::visit_array_assign(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
+    if(child[0]->get_kind() != NodeKind::ArrAccess) {
+        return make_error("Access can only apply on array\n");
     }
-    std::shared_ptr<Value> &arr{visit_array_access(child[0])}, value{visit(child[1])};
-    return arr = value;
-}
-
-std::shared_ptr<Value> Interpreter::visit_if(std::shared_ptr<Node> node) {
-    IfNode* if_node = dynamic_cast<IfNode*>(node.get());
-    std::shared_ptr<Value> cond = visit(if_node->get_condition());
-    if(cond->get_type() == VALUE_ERROR)
-        return cond;
-    if(std::stoll(cond->get_num()) == 1) {
-        std::shared_ptr<Value> ret;
-        for(auto expr : if_node->get_expr()) {
+    ArrayAccessNode *access = static_cast<ArrayAccessNode*>(child[0].get());
+    TaggedValue arr{visit(access->get_arr())}, index{visit(access->get_index())};
+    return index_set(arr, index, visit(child[1]));
+}
+
+TaggedValue Interpreter::visit_if(const std::shared_ptr<Node> &node) {
+    IfNode* if_node = static_cast<IfNode*>(node.get());
+    TaggedValue error;
+    int64_t cond{visit_condition(if_node->get_condition(), error)};
+    if(error.is_error())
+        return error;
+    if(cond == 1) {
+        TaggedValue ret;
+        for(const auto &expr : if_node->get_expr()) {
             ret = visit(expr);
-            if(ret->get_type() == VALUE_ERROR) {
+            if(ret.is_error()) {
                 return ret;
             }
         }
         return ret;
     } else if(!if_node->get_else().empty()) {
-        std::shared_ptr<Value> ret;
-        for(auto expr : if_node->get_else()) {
+        TaggedValue ret;
+        for(const auto &expr : if_node->get_else()) {
             ret = visit(expr);
-            if(ret->get_type() == VALUE_ERROR) {
+            if(ret.is_error()) {
                 return ret;
             }
         }
         return ret;
     }
-    return std::make_shared<TypedValue<int64_t>>(VALUE_INT, 0);
+    return make_int(0);
 }
 
-std::shared_ptr<Value> Interpreter::visit_for(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    std::shared_ptr<Value> i = visit(child[0]);
-    if (i->get_type() == VALUE_ERROR) return i;
-    std::shared_ptr<Value> step;
+// The array a loop collects its values into, appended to as they come so
+// that packed ones stay packed. None when nobody reads the loop's value.
+static TaggedValue collected(const std::shared_ptr<Node> &node) {
+    return node->is_value_used() ? make_boxed<ArrayValue>(ValueList()) : TaggedValue();
+}
+
+TaggedValue Interpreter::visit_for(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
+    VarAssignNode *var = static_cast<VarAssignNode*>(child[0].get());
+    TaggedValue i = visit(child[0]);
+    if (i.is_error()) return i;
+    TaggedValue step;
     if(child[2] != nullptr) {
         step = visit(child[2]);
-        if (step->get_type() == VALUE_ERROR) return step;
+        if (step.is_error()) return step;
     } else {
-        step = std::make_shared<TypedValue<int64_t>>(VALUE_INT, 1);
+        step = make_int(1);
     }
-    std::shared_ptr<Value> end_value = visit(child[1]);
-    if(end_value->get_type() == VALUE_ERROR) return end_value;
-    std::function<bool(std::shared_ptr<Value>, std::shared_ptr<Value>)> condition;
-    if(stod(step->get_num()) > 0) {
-        condition = [](std::shared_ptr<Value> i, std::shared_ptr<Value> end) -> bool {
-            return std::stoll((i <= end)->get_num()) == 1;
+    TaggedValue end_value = visit(child[1]);
+    if(end_value.is_error()) return end_value;
+    if(i.get_kind() == ValueKind::Int && end_value.get_kind() == ValueKind::Int && step.get_kind() == ValueKind::Int)
+        return visit_int_for(node, child, i.get_int(), end_value.get_int(), step.get_int());
+    std::function<bool(const TaggedValue&, const TaggedValue&)> condition;
+    if(stod(step.get_num()) > 0) {
+        condition = [](const TaggedValue &i, const TaggedValue &end) -> bool {
+            return as_integer(i <= end) == 1;
         };
-    } else if(std::stod(step->get_num()) < 0) {
-        condition = [](std::shared_ptr<Value> i, std::shared_ptr<Value> end) -> bool {
-            return std::stoll((i >= end)->get_num()) == 1;
+    } else if(std::stod(step.get_num()) < 0) {
+        condition = [](const TaggedValue &i, const TaggedValue &end) -> bool {
+            return as_integer(i >= end) == 1;
         };
     } else {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Infinite for loop\n");
+        return make_error("Infinite for loop\n");
     }
 
-    ValueList ret;
+    bool collect{child.size() == 4 && node->is_value_used()};
+    TaggedValue ret{collected(node)};
     while(condition(i, end_value)) {
-        if(child.size() == 4) {
-            ret.push_back(visit(child[3]));
-            if(ret.back()->get_type() == VALUE_ERROR) 
-                return ret.back();
+        if(collect) {
+            TaggedValue element{visit(child[3])};
+            if(element.is_error())
+                return element;
+            ret.as<ArrayValue>()->push_back(std::move(element));
         } else {
-            for(int index{3}; index < child.size(); ++index) {
-                std::shared_ptr<Value> ret{visit(child[index])};
-                if(ret->get_type() == VALUE_ERROR) 
+            for(size_t index{3}; index < child.size(); ++index) {
+                TaggedValue ret{visit(child[index])};
+                if(ret.is_error())
                     return ret;
             }
         }
-        symbol_table.set(child[0]->get_name(), i + step);
-        i = symbol_table.get(child[0]->get_name());
+        i = assign(var->get_scope(), var->get_index(), i + step);
     }
+    if(!node->is_value_used())
+        return TaggedValue();
     if(child.size() != 4)
-        ret.push_back(std::make_shared<Value>());
-    return std::make_shared<ArrayValue>(ret);
-}
-
-std::shared_ptr<Value> Interpreter::visit_while(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    ValueList ret;
-    while(std::stoll(visit(child[0])->get_num()) == 1) {
-        if(child.size() == 2) {
-            ret.push_back(visit(child[1]));
-            if(ret.back()->get_type() == VALUE_ERROR) 
-                return ret.back();
+        ret.as<ArrayValue>()->push_back(TaggedValue());
+    return ret;
+}
+// A for loop whose bounds and step are all Int counts in a native integer.
+// The variable is still assigned on every step, so the body can read and
+// change it as usual.
+TaggedValue Interpreter::visit_int_for(const std::shared_ptr<Node> &node, const NodeList &child, int64_t i, int64_t end_value, int64_t step) {
+    if(step == 0)
+        return make_error("Infinite for loop\n");
+    VarAssignNode *var = static_cast<VarAssignNode*>(child[0].get());
+    bool collect{child.size() == 4 && node->is_value_used()};
+    TaggedValue ret{collected(node)};
+    // Nothing can tell the passes over a constant apart, they are all made
+    // at once and the variable gets its last value.
+    if(collect && child[3]->get_kind() == NodeKind::Const) {
+        if(step > 0 ? i > end_value : i < end_value)
+            return ret;
+        uint64_t passes{fill_passes(i, end_value, step)};
+        if(passes > 0) {
+            ret.as<ArrayValue>()->fill(static_cast<ConstNode*>(child[3].get())->get_value(), passes + 1);
+            assign(var->get_scope(), var->get_index(), make_int(counter_after(i, passes + 1, step)));
+            return ret;
         }
-        for(int index{1}; index < child.size(); ++index) {
-            std::shared_ptr<Value> ret{visit(child[index])};
-            if(ret->get_type() == VALUE_ERROR) 
+    }
+    while(step > 0 ? i <= end_value : i >= end_value) {
+        if(collect) {
+            TaggedValue element{visit(child[3])};
+            if(element.is_error())
+                return element;
+            ret.as<ArrayValue>()->push_back(std::move(element));
+        } else {
+            for(size_t index{3}; index < child.size(); ++index) {
+                TaggedValue ret{visit(child[index])};
+                if(ret.is_error())
+                    return ret;
+            }
+        }
+        i += step;
+        assign(var->get_scope(), var->get_index(), make_int(i));
+    }
+    if(!node->is_value_used())
+        return TaggedValue();
+    if(child.size() != 4)
+        ret.as<ArrayValue>()->push_back(TaggedValue());
+    return ret;
+}
+
+
+TaggedValue Interpreter::visit_while(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
+    bool collect{child.size() == 2 && node->is_value_used()};
+    TaggedValue ret{collected(node)};
+    TaggedValue error;
+    // A failing condition ends the loop like a failing statement does.
+    while(visit_condition(child[0], error) == 1) {
+        if(collect) {
+            TaggedValue element{visit(child[1])};
+            if(element.is_error())
+                return element;
+            ret.as<ArrayValue>()->push_back(std::move(element));
+            continue;
+        }
+        for(size_t index{1}; index < child.size(); ++index) {
+            TaggedValue ret{visit(child[index])};
+            if(ret.is_error())
                 return ret;
         }
     }
-    return std::make_shared<ArrayValue>(ret);
+    if(error.is_error())
+        return error;
+    return ret;
 }
 
-std::shared_ptr<Value> Interpreter::visit_repeat(std::shared_ptr<Node> node) {
-    NodeList child = node->get_child();
-    ValueList ret;
+TaggedValue Interpreter::visit_repeat(const std::shared_ptr<Node> &node) {
+    const NodeList &child{node->get_child()};
+    bool collect{child.size() == 2 && node->is_value_used()};
+    TaggedValue ret{collected(node)};
+    TaggedValue error;
     do {
-        if(child.size() == 2) {
-            ret.push_back(visit(child[1]));
-            if(ret.back()->get_type() == VALUE_ERROR) 
-                return ret.back();
+        if(collect) {
+            TaggedValue element{visit(child[1])};
+            if(element.is_error())
+                return element;
+            ret.as<ArrayValue>()->push_back(std::move(element));
+            continue;
         }
-        for(int index{1}; index < child.size(); ++index) {
-            std::shared_ptr<Value> ret{visit(child[index])};
-            if(ret->get_type() == VALUE_ERROR) 
+        for(size_t index{1}; index < child.size(); ++index) {
+            TaggedValue ret{visit(child[index])};
+            if(ret.is_error())
                 return ret;
         }
-    } while(std::stoll(visit(child[0])->get_num()) == 0);
-    return std::make_shared<ArrayValue>(ret);
+    } while(visit_condition(child[0], error) == 0 && !error.is_error());
+    if(error.is_error())
+        return error;
+    return ret;
 }
 
-std::shared_ptr<Value> Interpreter::visit_algo_def(std::shared_ptr<Node> node) {
-    std::string algo_name = node->get_name();
-    std::shared_ptr<Value> value = std::make_shared<AlgoValue>(algo_name, node);
-    symbol_table.set(algo_name, value);
-    return symbol_table.get(algo_name);
+TaggedValue Interpreter::visit_algo_def(const std::shared_ptr<Node> &node) {
+    AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+    TaggedValue value = make_boxed<AlgoValue>(node->get_name(), node);
+    return assign(algo_def->get_scope(), algo_def->get_index(), value);
 }
 
-std::shared_ptr<Value> Interpreter::visit_algo_call(std::shared_ptr<Node> node) {
-    AlgorithmCallNode *algo_call_node = dynamic_cast<AlgorithmCallNode*>(node.get());
-    NodeList child = node->get_child();
-    std::shared_ptr<Node> algo_node = algo_call_node->get_call();
-    std::shared_ptr<Value> algo;
-    if(algo_node->get_type() == NODE_VARACCESS)
-        algo = symbol_table.get(algo_call_node->get_name());
-    else
-        algo = visit(algo_node);
-    return algo->execute(child, &symbol_table);
+TaggedValue Interpreter::visit_algo_call(const std::shared_ptr<Node> &node) {
+    AlgorithmCallNode *algo_call_node = static_cast<AlgorithmCallNode*>(node.get());
+    TaggedValue algo{visit(algo_call_node->get_call())};
+    return algo.execute(algo_call_node->get_args(), &symbol_table);
+}
+
+// Visits the last statement of an Algorithm body. A call there, directly or
+// at the end of an if branch, is evaluated up to its arguments and left in
+// tail when the current scope can be dropped before it runs.
+TaggedValue Interpreter::visit_tail(const std::shared_ptr<Node> &node, TailCall &tail) {
+    if(node->get_kind() == NodeKind::If) {
+        IfNode* if_node = static_cast<IfNode*>(node.get());
+        TaggedValue error;
+        int64_t cond{visit_condition(if_node->get_condition(), error)};
+        if(error.is_error())
+            return error;
+        NodeSpan branch{cond == 1 ? if_node->get_expr() : if_node->get_else()};
+        if(branch.empty())
+            return cond == 1 ? TaggedValue() : make_int(0);
+        for(size_t i{0}; i + 1 < branch.size(); ++i) {
+            TaggedValue ret{visit(branch[i])};
+            if(ret.is_error())
+                return ret;
+        }
+        return visit_tail(branch.back(), tail);
+    }
+    if(node->get_kind() != NodeKind::AlgoCall)
+        return visit(node);
+
+    AlgorithmCallNode *algo_call_node = static_cast<AlgorithmCallNode*>(node.get());
+    TaggedValue algo{visit(algo_call_node->get_call())};
+    const NodeList &args{algo_call_node->get_args()};
+    AlgoValue *callee{algo.get_kind() == ValueKind::Algo ? dynamic_cast<AlgoValue*>(algo.as<BaseAlgoValue>()) : nullptr};
+    if(callee == nullptr || callee->check_arity(args.size()).is_error() || callee->get_memo_cache() != nullptr
+        || !symbol_table.hidden_from_callees())
+        return algo.execute(args, &symbol_table);
+    tail.args.clear();
+    for(auto &arg : args)
+        tail.args.push_back(visit(arg));
+    tail.algo = std::move(algo);
+    return TaggedValue();
 }
 
-std::shared_ptr<Value> Interpreter::bin_op(
-    std::shared_ptr<Value> a, std::shared_ptr<Value> b, std::shared_ptr<Token> op
+void Interpreter::quicken(Node *node, Quickened state) {
+    if(state != Quickened::Generic)
+        ++specializations;
+    node->set_quickened(state);
+}
+
+// A guard failed. The node stays generic, so mixed operands do not make it
+// flip back and forth.
+void Interpreter::despecialize(Node *node) {
+    ++despecializations;
+    node->set_quickened(Quickened::Generic);
+}
+
+TaggedValue Interpreter::bin_op(
+    const TaggedValue &a, const TaggedValue &b, std::shared_ptr<Token> op
 ) {
-    if(op->get_type() == TOKEN_ADD)
-        return a + b;
-    else if(op->get_type() == TOKEN_SUB)
-        return a - b;
-    else if(op->get_type() == TOKEN_MUL)
-        return a * b;
-    else if(op->get_type() == TOKEN_DIV)
-        return a / b;
-    else if(op->get_type() == TOKEN_MOD)
-        return a % b;
-    else if(op->get_type() == TOKEN_POW)
-        return pow(a, b);
-    else if(op->get_type() == TOKEN_EQUAL)
-        return a == b;
-    else if(op->get_type() == TOKEN_NEQ)
-        return a != b;
-    else if(op->get_type() == TOKEN_LESS)
-        return a < b;
-    else if(op->get_type() == TOKEN_GREATER)
-        return a > b;
-    else if(op->get_type() == TOKEN_LEQ)
-        return a <= b;
-    else if(op->get_type() == TOKEN_GEQ)
-        return a >= b;
-    else if(op->get_type() == TOKEN_KEYWORD && op->get_value() == "and")
-        return a && b;
-    else if(op->get_type() == TOKEN_KEYWORD && op->get_value() == "or")
-        return a || b;
-    
-    return std::make_shared<ErrorValue>(VALUE_ERROR, "Not a binary op\n");
-}
-
-std::shared_ptr<Value> Interpreter::unary_op(std::shared_ptr<Value> a, std::shared_ptr<Token> op) {
-    if(op->get_type() == TOKEN_ADD)
-        return a;
-    else if(op->get_type() == TOKEN_SUB)
-        return -a;
-    else if(op->get_type() == TOKEN_KEYWORD && op->get_value() == "not")
-        return !a;
-    return std::make_shared<ErrorValue>(VALUE_ERROR, "Not an unary op\n");
+    switch(op->get_kind()) {
+        case TokenKind::Add: return a + b;
+        case TokenKind::Sub: return a - b;
+        case TokenKind::Mul: return a * b;
+        case TokenKind::Div: return a / b;
+        case TokenKind::Mod: return a % b;
+        case TokenKind::Pow: return pow(a, b);
+        case TokenKind::Equal: return a == b;
+        case TokenKind::Neq: return a != b;
+        case TokenKind::Less: return a < b;
+        case TokenKind::Greater: return a > b;
+        case TokenKind::Leq: return a <= b;
+        case TokenKind::Geq: return a >= b;
+        case TokenKind::And: return a && b;
+        case TokenKind::Or: return a || b;
+        default: break;
+    }
+    return make_error("Not a binary op\n");
+}
+
+TaggedValue Interpreter::unary_op(const TaggedValue &a, std::shared_ptr<Token> op) {
+    switch(op->get_kind()) {
+        case TokenKind::Add: return a;
+        case TokenKind::Sub: return -a;
+        case TokenKind::Not: return !a;
+        default: break;
+    }
+    return make_error("Not an unary op\n");
 }
\ No newline at end of file
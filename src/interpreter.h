@@ -11,31 +11,50 @@
 #include "token.h"
 #include <memory>
 
+// A call an Algorithm body ends with, left to the caller of run_body so it
+// does not nest on the native stack.
+struct TailCall {
+    TaggedValue algo;
+    ValueList args;
+};
+
 class Interpreter {
 public:
     Interpreter(SymbolTable &symbols)
         : symbol_table(symbols) {}
-    std::shared_ptr<Value> visit(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_number(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_var_access(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_var_assign(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_bin_op(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_unary_op(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_array(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_if(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_for(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_while(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_repeat(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_algo_def(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_algo_call(std::shared_ptr<Node>);
-    std::shared_ptr<Value>& visit_array_access(std::shared_ptr<Node>);
-    std::shared_ptr<Value> visit_array_assign(std::shared_ptr<Node>);
-
-    std::shared_ptr<Value> bin_op(std::shared_ptr<Value>, std::shared_ptr<Value>, std::shared_ptr<Token>);
-    std::shared_ptr<Value> unary_op(std::shared_ptr<Value>, std::shared_ptr<Token>);
+    TaggedValue visit(const std::shared_ptr<Node>&);
+    TaggedValue visit_number(const std::shared_ptr<Node>&);
+    TaggedValue visit_var_access(const std::shared_ptr<Node>&);
+    TaggedValue visit_var_assign(const std::shared_ptr<Node>&);
+    TaggedValue visit_bin_op(const std::shared_ptr<Node>&);
+    TaggedValue visit_unary_op(const std::shared_ptr<Node>&);
+    TaggedValue visit_array(const std::shared_ptr<Node>&);
+    TaggedValue visit_logical(const std::shared_ptr<Node>&);
+    int64_t visit_condition(const std::shared_ptr<Node>&, TaggedValue &error);
+    bool visit_truth(const std::shared_ptr<Node>&, TaggedValue &error);
+    TaggedValue visit_if(const std::shared_ptr<Node>&);
+    TaggedValue visit_for(const std::shared_ptr<Node>&);
+    TaggedValue visit_int_for(const std::shared_ptr<Node>&, const NodeList &child, int64_t i, int64_t end_value, int64_t step);
+    TaggedValue visit_while(const std::shared_ptr<Node>&);
+    TaggedValue visit_repeat(const std::shared_ptr<Node>&);
+    TaggedValue visit_algo_def(const std::shared_ptr<Node>&);
+    TaggedValue visit_algo_call(const std::shared_ptr<Node>&);
+    TaggedValue visit_tail(const std::shared_ptr<Node>&, TailCall&);
+    TaggedValue visit_array_access(const std::shared_ptr<Node>&);
+    TaggedValue visit_array_assign(const std::shared_ptr<Node>&);
+
+    static TaggedValue bin_op(const TaggedValue&, const TaggedValue&, std::shared_ptr<Token>);
+    static TaggedValue unary_op(const TaggedValue&, std::shared_ptr<Token>);
+    TaggedValue assign(VarScope, int index, const TaggedValue&);
+
+    static int64_t get_specializations() { return specializations;}
+    static int64_t get_despecializations() { return despecializations;}
 protected:
+    static void quicken(Node*, Quickened);
+    static void despecialize(Node*);
+
+    inline static int64_t specializations{0}, despecializations{0};
     SymbolTable &symbol_table;
-    std::shared_ptr<Value> error, algo_call_temp;
 };
 
 #endif
\ No newline at end of file
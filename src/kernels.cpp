@@ -0,0 +1,584 @@
+/// --------------------
+/// Kernels
+/// --------------------
+
+#include "kernels.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Ints are summed as unsigned, which wraps instead of overflowing.
+static int64_t sum_ints(const int64_t *a, size_t n) {
+    uint64_t sum{0};
+    for(size_t i{0}; i < n; ++i)
+        sum += static_cast<uint64_t>(a[i]);
+    return static_cast<int64_t>(sum);
+}
+
+// Element i goes to running sum i % 4, the rest after the sums are added.
+static double sum_floats(const double *a, size_t n) {
+    double lane[4]{0.0, 0.0, 0.0, 0.0};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        for(int j{0}; j < 4; ++j)
+            lane[j] += a[i + j];
+    }
+    double sum{(lane[0] + lane[1]) + (lane[2] + lane[3])};
+    for(; i < n; ++i)
+        sum += a[i];
+    return sum;
+}
+
+static int64_t min_ints(const int64_t *a, size_t n) {
+    int64_t min{a[0]};
+    for(size_t i{1}; i < n; ++i)
+        min = a[i] < min ? a[i] : min;
+    return min;
+}
+
+static int64_t max_ints(const int64_t *a, size_t n) {
+    int64_t max{a[0]};
+    for(size_t i{1}; i < n; ++i)
+        max = a[i] > max ? a[i] : max;
+    return max;
+}
+
+// An element only replaces the minimum when it compares less, so a NaN
+// first element stays and a later NaN is passed over, as in a plain loop.
+static double min_floats(const double *a, size_t n) {
+    double lane[4]{a[0], a[0], a[0], a[0]};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        for(int j{0}; j < 4; ++j)
+            lane[j] = a[i + j] < lane[j] ? a[i + j] : lane[j];
+    }
+    double min{lane[0]};
+    for(int j{1}; j < 4; ++j)
+        min = lane[j] < min ? lane[j] : min;
+    for(; i < n; ++i)
+        min = a[i] < min ? a[i] : min;
+    return min;
+}
+
+static double max_floats(const double *a, size_t n) {
+    double lane[4]{a[0], a[0], a[0], a[0]};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        for(int j{0}; j < 4; ++j)
+            lane[j] = a[i + j] > lane[j] ? a[i + j] : lane[j];
+    }
+    double max{lane[0]};
+    for(int j{1}; j < 4; ++j)
+        max = lane[j] > max ? lane[j] : max;
+    for(; i < n; ++i)
+        max = a[i] > max ? a[i] : max;
+    return max;
+}
+
+static size_t count_ints(const int64_t *a, size_t n, int64_t x) {
+    size_t count{0};
+    for(size_t i{0}; i < n; ++i)
+        count += a[i] == x;
+    return count;
+}
+
+static size_t count_floats(const double *a, size_t n, double x) {
+    size_t count{0};
+    for(size_t i{0}; i < n; ++i)
+        count += a[i] == x;
+    return count;
+}
+
+static size_t find_int(const int64_t *a, size_t n, int64_t x) {
+    for(size_t i{0}; i < n; ++i) {
+        if(a[i] == x) return i;
+    }
+    return n;
+}
+
+static size_t find_float(const double *a, size_t n, double x) {
+    for(size_t i{0}; i < n; ++i) {
+        if(a[i] == x) return i;
+    }
+    return n;
+}
+
+static int64_t dot_ints(const int64_t *a, const int64_t *b, size_t n) {
+    uint64_t sum{0};
+    for(size_t i{0}; i < n; ++i)
+        sum += static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(b[i]);
+    return static_cast<int64_t>(sum);
+}
+
+static double dot_floats(const double *a, const double *b, size_t n) {
+    double lane[4]{0.0, 0.0, 0.0, 0.0};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        for(int j{0}; j < 4; ++j)
+            lane[j] += a[i + j] * b[i + j];
+    }
+    double sum{(lane[0] + lane[1]) + (lane[2] + lane[3])};
+    for(; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+/// --------------------
+/// Elementwise
+/// --------------------
+
+static int64_t wrap(uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+struct Add {
+    static int64_t apply(int64_t a, int64_t b) { return wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));}
+    static double apply(double a, double b) { return a + b;}
+};
+
+struct Sub {
+    static int64_t apply(int64_t a, int64_t b) { return wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));}
+    static double apply(double a, double b) { return a - b;}
+};
+
+struct Mul {
+    static int64_t apply(int64_t a, int64_t b) { return wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));}
+    static double apply(double a, double b) { return a * b;}
+};
+
+struct Div {
+    static double apply(double a, double b) { return a / b;}
+};
+
+struct Equal {
+    template<typename T> static int64_t apply(T a, T b) { return a == b;}
+};
+
+struct Neq {
+    template<typename T> static int64_t apply(T a, T b) { return a != b;}
+};
+
+struct Less {
+    template<typename T> static int64_t apply(T a, T b) { return a < b;}
+};
+
+struct Greater {
+    template<typename T> static int64_t apply(T a, T b) { return a > b;}
+};
+
+struct Leq {
+    template<typename T> static int64_t apply(T a, T b) { return a <= b;}
+};
+
+struct Geq {
+    template<typename T> static int64_t apply(T a, T b) { return a >= b;}
+};
+
+template<typename Op, typename T, typename R>
+static void map_loop(const T *x, size_t x_step, const T *y, size_t y_step, R *out, size_t n) {
+    for(size_t i{0}; i < n; ++i)
+        out[i] = Op::apply(x[i * x_step], y[i * y_step]);
+}
+
+static void map_ints(MapOp op, const int64_t *x, size_t x_step, const int64_t *y, size_t y_step,
+    int64_t *out, size_t n) {
+    switch(op) {
+        case MapOp::Add: return map_loop<Add>(x, x_step, y, y_step, out, n);
+        case MapOp::Sub: return map_loop<Sub>(x, x_step, y, y_step, out, n);
+        case MapOp::Mul: return map_loop<Mul>(x, x_step, y, y_step, out, n);
+        case MapOp::Equal: return map_loop<Equal>(x, x_step, y, y_step, out, n);
+        case MapOp::Neq: return map_loop<Neq>(x, x_step, y, y_step, out, n);
+        case MapOp::Less: return map_loop<Less>(x, x_step, y, y_step, out, n);
+        case MapOp::Greater: return map_loop<Greater>(x, x_step, y, y_step, out, n);
+        case MapOp::Leq: return map_loop<Leq>(x, x_step, y, y_step, out, n);
+        case MapOp::Geq: return map_loop<Geq>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+static void map_floats(MapOp op, const double *x, size_t x_step, const double *y, size_t y_step,
+    double *out, size_t n) {
+    switch(op) {
+        case MapOp::Add: return map_loop<Add>(x, x_step, y, y_step, out, n);
+        case MapOp::Sub: return map_loop<Sub>(x, x_step, y, y_step, out, n);
+        case MapOp::Mul: return map_loop<Mul>(x, x_step, y, y_step, out, n);
+        case MapOp::Div: return map_loop<Div>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+static void compare_floats(MapOp op, const double *x, size_t x_step, const double *y, size_t y_step,
+    int64_t *out, size_t n) {
+    switch(op) {
+        case MapOp::Equal: return map_loop<Equal>(x, x_step, y, y_step, out, n);
+        case MapOp::Neq: return map_loop<Neq>(x, x_step, y, y_step, out, n);
+        case MapOp::Less: return map_loop<Less>(x, x_step, y, y_step, out, n);
+        case MapOp::Greater: return map_loop<Greater>(x, x_step, y, y_step, out, n);
+        case MapOp::Leq: return map_loop<Leq>(x, x_step, y, y_step, out, n);
+        case MapOp::Geq: return map_loop<Geq>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+static const Kernels PORTABLE_KERNELS{
+    "portable", sum_ints, sum_floats, min_ints, max_ints, min_floats, max_floats,
+    count_ints, count_floats, find_int, find_float, dot_ints, dot_floats,
+    map_ints, map_floats, compare_floats
+};
+
+#if defined(__x86_64__)
+
+/// --------------------
+/// AVX2
+/// --------------------
+
+// Four elements a step, the tail goes through the portable loops.
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static int64_t sum_lanes(__m256i v) {
+    alignas(32) int64_t lane[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane), v);
+    return static_cast<int64_t>(static_cast<uint64_t>(lane[0]) + static_cast<uint64_t>(lane[1])
+        + static_cast<uint64_t>(lane[2]) + static_cast<uint64_t>(lane[3]));
+}
+
+AVX2 static __m256i load(const int64_t *a) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+}
+
+AVX2 static int64_t avx2_sum_ints(const int64_t *a, size_t n) {
+    __m256i sum{_mm256_setzero_si256()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        sum = _mm256_add_epi64(sum, load(a + i));
+    return static_cast<int64_t>(static_cast<uint64_t>(sum_lanes(sum))
+        + static_cast<uint64_t>(sum_ints(a + i, n - i)));
+}
+
+AVX2 static double avx2_sum_floats(const double *a, size_t n) {
+    __m256d sum{_mm256_setzero_pd()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(a + i));
+    alignas(32) double lane[4];
+    _mm256_store_pd(lane, sum);
+    double total{(lane[0] + lane[1]) + (lane[2] + lane[3])};
+    for(; i < n; ++i)
+        total += a[i];
+    return total;
+}
+
+// AVX2 has no 64 bit min or max, a compare picks the lanes instead.
+AVX2 static int64_t avx2_min_ints(const int64_t *a, size_t n) {
+    __m256i min{_mm256_set1_epi64x(a[0])};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        __m256i x{load(a + i)};
+        min = _mm256_blendv_epi8(min, x, _mm256_cmpgt_epi64(min, x));
+    }
+    alignas(32) int64_t lane[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane), min);
+    int64_t result{min_ints(lane, 4)};
+    for(; i < n; ++i)
+        result = a[i] < result ? a[i] : result;
+    return result;
+}
+
+AVX2 static int64_t avx2_max_ints(const int64_t *a, size_t n) {
+    __m256i max{_mm256_set1_epi64x(a[0])};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        __m256i x{load(a + i)};
+        max = _mm256_blendv_epi8(max, x, _mm256_cmpgt_epi64(x, max));
+    }
+    alignas(32) int64_t lane[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane), max);
+    int64_t result{max_ints(lane, 4)};
+    for(; i < n; ++i)
+        result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+// _mm256_min_pd(x, m) is x < m ? x : m, lane by lane, as in min_floats.
+AVX2 static double avx2_min_floats(const double *a, size_t n) {
+    __m256d min{_mm256_set1_pd(a[0])};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        min = _mm256_min_pd(_mm256_loadu_pd(a + i), min);
+    alignas(32) double lane[4];
+    _mm256_store_pd(lane, min);
+    double result{lane[0]};
+    for(int j{1}; j < 4; ++j)
+        result = lane[j] < result ? lane[j] : result;
+    for(; i < n; ++i)
+        result = a[i] < result ? a[i] : result;
+    return result;
+}
+
+AVX2 static double avx2_max_floats(const double *a, size_t n) {
+    __m256d max{_mm256_set1_pd(a[0])};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        max = _mm256_max_pd(_mm256_loadu_pd(a + i), max);
+    alignas(32) double lane[4];
+    _mm256_store_pd(lane, max);
+    double result{lane[0]};
+    for(int j{1}; j < 4; ++j)
+        result = lane[j] > result ? lane[j] : result;
+    for(; i < n; ++i)
+        result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+// A lane that matches is all ones, -1, so subtracting it counts.
+AVX2 static size_t avx2_count_ints(const int64_t *a, size_t n, int64_t x) {
+    __m256i target{_mm256_set1_epi64x(x)}, count{_mm256_setzero_si256()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        count = _mm256_sub_epi64(count, _mm256_cmpeq_epi64(load(a + i), target));
+    return sum_lanes(count) + count_ints(a + i, n - i, x);
+}
+
+AVX2 static size_t avx2_count_floats(const double *a, size_t n, double x) {
+    __m256d target{_mm256_set1_pd(x)};
+    __m256i count{_mm256_setzero_si256()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        __m256d equal{_mm256_cmp_pd(_mm256_loadu_pd(a + i), target, _CMP_EQ_OQ)};
+        count = _mm256_sub_epi64(count, _mm256_castpd_si256(equal));
+    }
+    return sum_lanes(count) + count_floats(a + i, n - i, x);
+}
+
+AVX2 static size_t avx2_find_int(const int64_t *a, size_t n, int64_t x) {
+    __m256i target{_mm256_set1_epi64x(x)};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        int mask{_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(load(a + i), target)))};
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_int(a + i, n - i, x);
+}
+
+AVX2 static size_t avx2_find_float(const double *a, size_t n, double x) {
+    __m256d target{_mm256_set1_pd(x)};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        int mask{_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), target, _CMP_EQ_OQ))};
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_float(a + i, n - i, x);
+}
+
+// The low 64 bits of a product, from 32 bit halves: lo*lo plus the two
+// cross products moved up.
+AVX2 static __m256i multiply(__m256i a, __m256i b) {
+    __m256i low{_mm256_mul_epu32(a, b)};
+    __m256i cross{_mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+        _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)))};
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static int64_t avx2_dot_ints(const int64_t *a, const int64_t *b, size_t n) {
+    __m256i sum{_mm256_setzero_si256()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        sum = _mm256_add_epi64(sum, multiply(load(a + i), load(b + i)));
+    return static_cast<int64_t>(static_cast<uint64_t>(sum_lanes(sum))
+        + static_cast<uint64_t>(dot_ints(a + i, b + i, n - i)));
+}
+
+// Multiplied then added, not fused, to round as dot_floats does.
+AVX2 static double avx2_dot_floats(const double *a, const double *b, size_t n) {
+    __m256d sum{_mm256_setzero_pd()};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    alignas(32) double lane[4];
+    _mm256_store_pd(lane, sum);
+    double total{(lane[0] + lane[1]) + (lane[2] + lane[3])};
+    for(; i < n; ++i)
+        total += a[i] * b[i];
+    return total;
+}
+
+// A comparison mask of all ones becomes 1.
+AVX2 static __m256i ones(__m256i mask) {
+    return _mm256_srli_epi64(mask, 63);
+}
+
+AVX2 static __m256i flip(__m256i bits) {
+    return _mm256_xor_si256(bits, _mm256_set1_epi64x(1));
+}
+
+AVX2 static __m256i compare(__m256d a, __m256d b, int predicate) {
+    return ones(_mm256_castpd_si256(_mm256_cmp_pd(a, b, predicate)));
+}
+
+struct VecAdd: Add {
+    using Add::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return _mm256_add_epi64(a, b);}
+    AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b);}
+};
+
+struct VecSub: Sub {
+    using Sub::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return _mm256_sub_epi64(a, b);}
+    AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_sub_pd(a, b);}
+};
+
+struct VecMul: Mul {
+    using Mul::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return multiply(a, b);}
+    AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_mul_pd(a, b);}
+};
+
+struct VecDiv: Div {
+    using Div::apply;
+    AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_div_pd(a, b);}
+};
+
+// _mm256_cmp_pd predicates that are false on NaN, but for `!=`, as the
+// scalar operators are.
+struct VecEqual: Equal {
+    using Equal::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return ones(_mm256_cmpeq_epi64(a, b));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_EQ_OQ);}
+};
+
+struct VecNeq: Neq {
+    using Neq::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return flip(ones(_mm256_cmpeq_epi64(a, b)));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_NEQ_UQ);}
+};
+
+struct VecLess: Less {
+    using Less::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return ones(_mm256_cmpgt_epi64(b, a));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_LT_OQ);}
+};
+
+struct VecGreater: Greater {
+    using Greater::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return ones(_mm256_cmpgt_epi64(a, b));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_GT_OQ);}
+};
+
+struct VecLeq: Leq {
+    using Leq::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return flip(ones(_mm256_cmpgt_epi64(a, b)));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_LE_OQ);}
+};
+
+struct VecGeq: Geq {
+    using Geq::apply;
+    AVX2 static __m256i apply(__m256i a, __m256i b) { return flip(ones(_mm256_cmpgt_epi64(b, a)));}
+    AVX2 static __m256i apply(__m256d a, __m256d b) { return compare(a, b, _CMP_GE_OQ);}
+};
+
+AVX2 static __m256d load(const double *a) {
+    return _mm256_loadu_pd(a);
+}
+
+AVX2 static __m256i broadcast(int64_t a) {
+    return _mm256_set1_epi64x(a);
+}
+
+AVX2 static __m256d broadcast(double a) {
+    return _mm256_set1_pd(a);
+}
+
+AVX2 static void store(int64_t *out, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), v);
+}
+
+AVX2 static void store(double *out, __m256d v) {
+    _mm256_storeu_pd(out, v);
+}
+
+template<typename Op, typename T, typename R>
+AVX2 static void avx2_map_loop(const T *x, size_t x_step, const T *y, size_t y_step, R *out, size_t n) {
+    if(n == 0)
+        return;
+    auto repeated_x{broadcast(x[0])};
+    auto repeated_y{broadcast(y[0])};
+    size_t i{0};
+    for(; i + 4 <= n; i += 4)
+        store(out + i, Op::apply(x_step != 0 ? load(x + i) : repeated_x, y_step != 0 ? load(y + i) : repeated_y));
+    map_loop<Op>(x + i * x_step, x_step, y + i * y_step, y_step, out + i, n - i);
+}
+
+static void avx2_map_ints(MapOp op, const int64_t *x, size_t x_step, const int64_t *y, size_t y_step,
+    int64_t *out, size_t n) {
+    switch(op) {
+        case MapOp::Add: return avx2_map_loop<VecAdd>(x, x_step, y, y_step, out, n);
+        case MapOp::Sub: return avx2_map_loop<VecSub>(x, x_step, y, y_step, out, n);
+        case MapOp::Mul: return avx2_map_loop<VecMul>(x, x_step, y, y_step, out, n);
+        case MapOp::Equal: return avx2_map_loop<VecEqual>(x, x_step, y, y_step, out, n);
+        case MapOp::Neq: return avx2_map_loop<VecNeq>(x, x_step, y, y_step, out, n);
+        case MapOp::Less: return avx2_map_loop<VecLess>(x, x_step, y, y_step, out, n);
+        case MapOp::Greater: return avx2_map_loop<VecGreater>(x, x_step, y, y_step, out, n);
+        case MapOp::Leq: return avx2_map_loop<VecLeq>(x, x_step, y, y_step, out, n);
+        case MapOp::Geq: return avx2_map_loop<VecGeq>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+static void avx2_map_floats(MapOp op, const double *x, size_t x_step, const double *y, size_t y_step,
+    double *out, size_t n) {
+    switch(op) {
+        case MapOp::Add: return avx2_map_loop<VecAdd>(x, x_step, y, y_step, out, n);
+        case MapOp::Sub: return avx2_map_loop<VecSub>(x, x_step, y, y_step, out, n);
+        case MapOp::Mul: return avx2_map_loop<VecMul>(x, x_step, y, y_step, out, n);
+        case MapOp::Div: return avx2_map_loop<VecDiv>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+static void avx2_compare_floats(MapOp op, const double *x, size_t x_step, const double *y, size_t y_step,
+    int64_t *out, size_t n) {
+    switch(op) {
+        case MapOp::Equal: return avx2_map_loop<VecEqual>(x, x_step, y, y_step, out, n);
+        case MapOp::Neq: return avx2_map_loop<VecNeq>(x, x_step, y, y_step, out, n);
+        case MapOp::Less: return avx2_map_loop<VecLess>(x, x_step, y, y_step, out, n);
+        case MapOp::Greater: return avx2_map_loop<VecGreater>(x, x_step, y, y_step, out, n);
+        case MapOp::Leq: return avx2_map_loop<VecLeq>(x, x_step, y, y_step, out, n);
+        case MapOp::Geq: return avx2_map_loop<VecGeq>(x, x_step, y, y_step, out, n);
+        default: return;
+    }
+}
+
+#undef AVX2
+
+static const Kernels AVX2_KERNELS{
+    "avx2", avx2_sum_ints, avx2_sum_floats, avx2_min_ints, avx2_max_ints, avx2_min_floats,
+    avx2_max_floats, avx2_count_ints, avx2_count_floats, avx2_find_int, avx2_find_float,
+    avx2_dot_ints, avx2_dot_floats, avx2_map_ints, avx2_map_floats, avx2_compare_floats
+};
+
+#endif
+
+static const Kernels& choose_kernels() {
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2_KERNELS;
+#endif
+    return PORTABLE_KERNELS;
+}
+
+const Kernels& kernels() {
+    static const Kernels &chosen{choose_kernels()};
+    return chosen;
+}
+
+std::vector<const Kernels*> kernel_sets() {
+    std::vector<const Kernels*> sets{&PORTABLE_KERNELS};
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        sets.push_back(&AVX2_KERNELS);
+#endif
+    return sets;
+}
\ No newline at end of file
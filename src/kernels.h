@@ -0,0 +1,57 @@
+/// --------------------
+/// Kernels
+/// --------------------
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The operators arrays apply element by element. Mod and Pow have no
+// kernel, the operators do them one element at a time.
+enum class MapOp : uint8_t {
+    Add, Sub, Mul, Div, Mod, Pow, Equal, Neq, Less, Greater, Leq, Geq
+};
+
+/// Loops over the elements of packed arrays, behind the array builtins
+/// and operators.
+/// Each has a portable version and, on x86-64, an AVX2 one. The set to use
+/// is picked once, by what the CPU supports. Both give the same results:
+/// Ints wrap around, and Floats are added in the same four running sums.
+/// Floats are not rounded to six digits along the way as the operators
+/// round them, the caller rounds what comes out.
+struct Kernels {
+    const char *name;
+    int64_t (*sum_ints)(const int64_t*, size_t);
+    double (*sum_floats)(const double*, size_t);
+    // The array must not be empty.
+    int64_t (*min_ints)(const int64_t*, size_t);
+    int64_t (*max_ints)(const int64_t*, size_t);
+    double (*min_floats)(const double*, size_t);
+    double (*max_floats)(const double*, size_t);
+    size_t (*count_ints)(const int64_t*, size_t, int64_t);
+    size_t (*count_floats)(const double*, size_t, double);
+    // Where the first match is, or the size when there is none.
+    size_t (*find_int)(const int64_t*, size_t, int64_t);
+    size_t (*find_float)(const double*, size_t, double);
+    int64_t (*dot_ints)(const int64_t*, const int64_t*, size_t);
+    double (*dot_floats)(const double*, const double*, size_t);
+    // out[i] = x[i] op y[i]. A step of 0 repeats the first element, so a
+    // number can stand on either side. map_ints takes Add, Sub, Mul and the
+    // comparisons, map_floats Add to Div, and compare_floats the comparisons.
+    // A comparison gives 0 or 1.
+    void (*map_ints)(MapOp, const int64_t *x, size_t x_step, const int64_t *y, size_t y_step,
+        int64_t *out, size_t n);
+    void (*map_floats)(MapOp, const double *x, size_t x_step, const double *y, size_t y_step,
+        double *out, size_t n);
+    void (*compare_floats)(MapOp, const double *x, size_t x_step, const double *y, size_t y_step,
+        int64_t *out, size_t n);
+};
+
+const Kernels& kernels();
+// Every set this CPU can run, the portable one first.
+std::vector<const Kernels*> kernel_sets();
+
+#endif
\ No newline at end of file
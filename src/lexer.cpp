@@ -6,165 +6,136 @@
 #include "color.h"
 #include <string>
 
-void Lexer::advance() {
-    pos.advance(current_char);
-    if(pos.index >= text.size()) {
-        current_char = NONE;
-        return;
-    }
-    current_char = text[pos.index];
-}
-
-TokenList Lexer::make_tokens() {
-    TokenList tokens;
-    advance();
-    while(current_char != NONE) {
-        if(std::isdigit(current_char)) {
-            tokens.push_back(make_number());
+// Room for a token per two chars is reserved up front, more than scripts
+// use. Pages of it that are never written are never mapped, and the vector
+// does not have to be copied as it grows.
+TokenStream Lexer::lex() {
+    TokenStream stream(text, file);
+    stream.reserve(text.size() / 2);
+    size_t index{0};
+    while(index < text.size()) {
+        char current_char{text[index]};
+        TokenKind single_char_kind{SINGLE_CHAR_KINDS[static_cast<uint8_t>(current_char)]};
+        if(single_char_kind != TokenKind::None) {
+            stream.push(single_char_kind, index++, 1);
             continue;
         }
-        if(std::isalpha(current_char)) {
-            tokens.push_back(make_identifier());
+        if(is_char_class(current_char, CHAR_DIGIT)) {
+            lex_number(stream, index);
+            continue;
+        }
+        if(is_char_class(current_char, CHAR_ALPHA)) {
+            lex_identifier(stream, index);
             continue;
         }
         if(current_char == '\"') {
-            std::shared_ptr<Token> new_token = make_string();
-            if(new_token->get_type() == TOKEN_ERROR) {
-                tokens.clear();
-                tokens.push_back(new_token);
-                return tokens;
-            }
-            tokens.push_back(new_token);
+            if(!lex_string(stream, index))
+                return stream;
             continue;
         }
         if(current_char == '\n') {
-            tokens.push_back(std::make_shared<Token>(TO_TOKEN_TYPE.at(current_char), pos));
-            advance();
-            int space_num{0};
-            while(current_char == ' ') {
-                space_num++;
-                advance();
-            }
+            stream.push(TokenKind::Newline, index, 1);
+            stream.new_line(++index);
+            size_t line_start{index};
+            while(index < text.size() && text[index] == ' ')
+                index++;
+            size_t space_num{index - line_start};
             if(space_num % TAB_SIZE != 0) {
-                tokens.clear();
                 std::string error_msg = "Illegal tab size: ";
                 error_msg += std::to_string(space_num);
-                error_msg += ". At " + pos.get_pos() + RESET + "\n Tab Size should be 4n" + "\n";
-                tokens.push_back(std::make_shared<ErrorToken>(TOKEN_ERROR, pos, error_msg));
-                return tokens;
-            }
-            for(int i{0}; i < (space_num >> 2); ++i) {
-                tokens.push_back(std::make_shared<Token>(TOKEN_TAB, pos));
+                error_msg += ". At " + stream.position(index).get_pos() + RESET + "\n Tab Size should be 4n" + "\n";
+                stream.fail(index, error_msg);
+                return stream;
             }
+            for(size_t tab{line_start}; tab < index; tab += TAB_SIZE)
+                stream.push(TokenKind::Tab, tab, TAB_SIZE);
             continue;
         }
 
+        char next_char{index + 1 < text.size() ? text[index + 1] : '\0'};
         switch(current_char) {
-            case ' ': case '\t': 
-            advance(); break;
-            
-            case '+': case '-': case '*': case '/': case '%': case '^': case '(': case ')':
-            case '=': case ',': case ':': case '{': case '}': case '[': case ']': case ';':
-            tokens.push_back(std::make_shared<Token>(TO_TOKEN_TYPE.at(current_char), pos));
-            advance(); break;
+            case ' ': case '\t': index++; break;
             case '<':
-            advance();
-            if(current_char == '-') {
-                tokens.push_back(std::make_shared<Token>(TOKEN_ASSIGN, pos));
-                advance();
-            } else if(current_char == '=') {
-                tokens.push_back(std::make_shared<Token>(TOKEN_LEQ, pos));
-                advance();
+            if(next_char == '-') {
+                stream.push(TokenKind::Assign, index, 2);
+                index += 2;
+            } else if(next_char == '=') {
+                stream.push(TokenKind::Leq, index, 2);
+                index += 2;
             } else {
-                tokens.push_back(std::make_shared<Token>(TOKEN_LESS, pos));
+                stream.push(TokenKind::Less, index++, 1);
             } break;
 
             case '>':
-            advance();
-            if(current_char == '=') {
-                tokens.push_back(std::make_shared<Token>(TOKEN_GEQ, pos));
-                advance();
+            if(next_char == '=') {
+                stream.push(TokenKind::Geq, index, 2);
+                index += 2;
             } else {
-                tokens.push_back(std::make_shared<Token>(TOKEN_GREATER, pos));
+                stream.push(TokenKind::Greater, index++, 1);
             } break;
 
             case '!':
-            advance();
-            if(current_char == '=') {
-                tokens.push_back(std::make_shared<Token>(TOKEN_NEQ, pos));
-                advance();
+            if(next_char == '=') {
+                stream.push(TokenKind::Neq, index, 2);
+                index += 2;
                 break;
             }
 
             default:
-            tokens.clear();
             std::string error_msg = "Illegal char \'";
             error_msg += current_char;
-            error_msg += "\'. At " + pos.get_pos() + RESET + "\n";
-            tokens.push_back(std::make_shared<ErrorToken>(TOKEN_ERROR, pos, error_msg));
-            return tokens;
+            error_msg += "\'. At " + stream.position(index).get_pos() + RESET + "\n";
+            stream.fail(index, error_msg);
+            return stream;
         }
     }
-    return tokens;
+    return stream;
 }
 
-std::shared_ptr<Token> Lexer::make_number() {
-    std::string number_str;
-    int dot_count{0};
-
-    while(current_char != NONE && (std::isdigit(current_char) || current_char == '.')) {
-        if(current_char == '.') {
-            if(dot_count == 1) break;
-            dot_count++;
+// A second dot ends the number.
+void Lexer::lex_number(TokenStream &stream, size_t &index) {
+    size_t start{index};
+    bool has_dot{false};
+    while(index < text.size() && is_char_class(text[index], CHAR_NUMBER)) {
+        if(text[index] == '.') {
+            if(has_dot) break;
+            has_dot = true;
         }
-        number_str += current_char;
-        advance();
+        index++;
     }
-
-    if(dot_count == 0) 
-        return std::make_shared<TypedToken<int64_t>>(TOKEN_INT, pos, std::stoll(number_str));
-    else 
-        return std::make_shared<TypedToken<double>>(TOKEN_FLOAT, pos, std::stod(number_str));
+    stream.push(has_dot ? TokenKind::Float : TokenKind::Int, start, index - start);
 }
 
-std::shared_ptr<Token> Lexer::make_identifier() {
-    std::string id_str;
-    while(current_char != NONE && (std::isalnum(current_char) || current_char == '_')) {
-        id_str += current_char;
-        advance();
-    }
-    std::string type;
-    if(KEYWORDS.count(id_str))
-        type = TOKEN_KEYWORD;
-    else if(BUILTIN_CONST.count(id_str))
-        type = TOKEN_BUILTIN_CONST;
-    else if(BUILTIN_ALGO.count(id_str))
-        type = TOKEN_BUILTIN_ALGO;
-    else 
-        type = TOKEN_IDENTIFIER;
-    return std::make_shared<TypedToken<std::string>>(type, pos, id_str);
+void Lexer::lex_identifier(TokenStream &stream, size_t &index) {
+    size_t start{index};
+    while(index < text.size() && is_char_class(text[index], CHAR_WORD))
+        index++;
+    std::string_view id_str{text.substr(start, index - start)};
+    const ReservedWord *word{find_reserved_word(id_str)};
+    stream.push(word != nullptr ? word->kind : TokenKind::Identifier, start, index - start);
 }
 
-std::shared_ptr<Token> Lexer::make_string() {
-    advance();
-    std::string ret;
-    while(current_char != NONE && current_char != '\"') {
-        if(current_char == '\\') {
-            advance();
-            if(ESCAPE_CHAR.count(current_char))
-                ret += ESCAPE_CHAR.at(current_char);
-            else
-                return std::make_shared<ErrorToken>(
-                    TOKEN_ERROR, pos, Color(0xFF, 0x39, 0x6E).get() + "Unknown char after \'\\\'" RESET);
-            advance();
-            continue;
+// The lexeme keeps the quotes and escapes, TokenStream::to_token replaces
+// them once the string is needed.
+bool Lexer::lex_string(TokenStream &stream, size_t &index) {
+    size_t start{index++};
+    while(index < text.size() && text[index] != '\"') {
+        if(text[index] == '\\') {
+            index++;
+            if(index == text.size() || ESCAPE_CHARS[static_cast<uint8_t>(text[index])] == 0) {
+                stream.fail(index, Color(0xFF, 0x39, 0x6E).get() + "Unknown char after \'\\\'" RESET);
+                return false;
+            }
+        } else if(text[index] == '\n') {
+            stream.new_line(index + 1);
         }
-        ret += current_char;
-        advance();
+        index++;
+    }
+    if(index == text.size()) {
+        stream.fail(index, Color(0xFF, 0x39, 0x6E).get() + "Expected \'\"\'" RESET);
+        return false;
     }
-    if(current_char != '\"')
-        return std::make_shared<ErrorToken>(
-            TOKEN_ERROR, pos, Color(0xFF, 0x39, 0x6E).get() + "Expected \'\"\'" RESET);
-    advance();
-    return std::make_shared<TypedToken<std::string>>(TOKEN_STRING, pos, ret);
+    index++;
+    stream.push(TokenKind::String, start, index - start);
+    return true;
 }
\ No newline at end of file
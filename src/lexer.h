@@ -5,64 +5,153 @@
 #ifndef LEXER_H
 #define LEXER_H
 
-#include <map>
-#include <set>
+#include <array>
+#include <cstdint>
+#include <string_view>
 #include "token.h"
 
-#define NONE 0
 #define TAB_SIZE 4
 
-const std::map<char, std::string> TO_TOKEN_TYPE {
-    {'+', TOKEN_ADD}, {'-', TOKEN_SUB}, 
-    {'*', TOKEN_MUL}, {'/', TOKEN_DIV},
-    {'%', TOKEN_MOD}, {'(', TOKEN_LEFT_PAREN},
-    {')', TOKEN_RIGHT_PAREN}, {'^', TOKEN_POW},
-    {'=', TOKEN_EQUAL}, {',', TOKEN_COMMA},
-    {':', TOKEN_COLON}, {'{', TOKEN_LEFT_BRACE},
-    {'}', TOKEN_RIGHT_BRACE}, {'[', TOKEN_LEFT_SQUARE},
-    {']', TOKEN_RIGHT_SQUARE}, {'\n', TOKEN_NEWLINE},
-    {';', TOKEN_SEMICOLON}, {'.', TOKEN_DOT}
+// Character classes, a char may be in several.
+enum CharClass : uint8_t {
+    CHAR_DIGIT = 1, CHAR_ALPHA = 2, CHAR_WORD = 4, CHAR_NUMBER = 8
 };
 
-const std::set<std::string> KEYWORDS{
-    "and", "or", "not",
-    "for", "to", "step", "while", "do",
-    "repeat", "until",
-    "if", "then", "else", 
-    "Algorithm", "continue", "break"
-};
+constexpr std::array<uint8_t, 256> make_char_classes() {
+    std::array<uint8_t, 256> classes{};
+    for(int c{'0'}; c <= '9'; ++c)
+        classes[c] |= CHAR_DIGIT | CHAR_WORD | CHAR_NUMBER;
+    for(int c{'a'}; c <= 'z'; ++c)
+        classes[c] |= CHAR_ALPHA | CHAR_WORD;
+    for(int c{'A'}; c <= 'Z'; ++c)
+        classes[c] |= CHAR_ALPHA | CHAR_WORD;
+    classes['_'] |= CHAR_WORD;
+    classes['.'] |= CHAR_NUMBER;
+    return classes;
+}
 
-const std::map<std::string, int64_t> BUILTIN_CONST{
-    {"true", 1}, {"false", 0}, {"none", 0}
-};
+inline constexpr std::array<uint8_t, 256> CHAR_CLASSES{make_char_classes()};
+
+constexpr bool is_char_class(char c, uint8_t char_class) {
+    return CHAR_CLASSES[static_cast<uint8_t>(c)] & char_class;
+}
+
+// Kinds of the tokens that are a single char and never start a longer one,
+// None for every other char.
+constexpr std::array<TokenKind, 256> make_single_char_kinds() {
+    std::array<TokenKind, 256> kinds{};
+    kinds['+'] = TokenKind::Add;
+    kinds['-'] = TokenKind::Sub;
+    kinds['*'] = TokenKind::Mul;
+    kinds['/'] = TokenKind::Div;
+    kinds['%'] = TokenKind::Mod;
+    kinds['^'] = TokenKind::Pow;
+    kinds['('] = TokenKind::LeftParen;
+    kinds[')'] = TokenKind::RightParen;
+    kinds['='] = TokenKind::Equal;
+    kinds[','] = TokenKind::Comma;
+    kinds[':'] = TokenKind::Colon;
+    kinds['{'] = TokenKind::LeftBrace;
+    kinds['}'] = TokenKind::RightBrace;
+    kinds['['] = TokenKind::LeftSquare;
+    kinds[']'] = TokenKind::RightSquare;
+    kinds[';'] = TokenKind::Semicolon;
+    return kinds;
+}
 
-const std::set<std::string> BUILTIN_ALGO{
-    "print", "read", "read_line",
-    "open", "clear", "quit",
-    "int", "float", "string"
+inline constexpr std::array<TokenKind, 256> SINGLE_CHAR_KINDS{make_single_char_kinds()};
+
+// What the char after a '\' stands for, 0 when it cannot follow one.
+constexpr std::array<char, 256> make_escape_chars() {
+    std::array<char, 256> chars{};
+    chars['n'] = '\n';
+    chars['r'] = '\r';
+    chars['b'] = '\b';
+    chars['t'] = '\t';
+    chars['\"'] = '\"';
+    chars['\''] = '\'';
+    chars['\\'] = '\\';
+    return chars;
+}
+
+inline constexpr std::array<char, 256> ESCAPE_CHARS{make_escape_chars()};
+
+/// A keyword, builtin constant or builtin Algorithm name. Value is what a
+/// constant stands for.
+struct ReservedWord {
+    std::string_view text;
+    TokenKind kind;
+    int64_t value;
 };
 
-const std::map<char, char> ESCAPE_CHAR {
-    {'n', '\n'}, {'r', '\r'},
-    {'b', '\b'}, {'\"', '\"'},
-    {'\'', '\''}, {'\\', '\\'},
-    {'t', '\t'}, {'b', '\b'}
+inline constexpr ReservedWord RESERVED_WORD_LIST[]{
+    {"and", TokenKind::And, 0}, {"or", TokenKind::Or, 0}, {"not", TokenKind::Not, 0},
+    {"for", TokenKind::For, 0}, {"to", TokenKind::To, 0}, {"step", TokenKind::Step, 0},
+    {"while", TokenKind::While, 0}, {"do", TokenKind::Do, 0},
+    {"repeat", TokenKind::Repeat, 0}, {"until", TokenKind::Until, 0},
+    {"if", TokenKind::If, 0}, {"then", TokenKind::Then, 0}, {"else", TokenKind::Else, 0},
+    {"Algorithm", TokenKind::Algorithm, 0}, {"continue", TokenKind::Continue, 0},
+    {"break", TokenKind::Break, 0},
+
+    {"true", TokenKind::BuiltinConst, 1}, {"false", TokenKind::BuiltinConst, 0},
+    {"none", TokenKind::BuiltinConst, 0},
+
+    {"print", TokenKind::BuiltinAlgo, 0}, {"read", TokenKind::BuiltinAlgo, 0},
+    {"read_line", TokenKind::BuiltinAlgo, 0}, {"open", TokenKind::BuiltinAlgo, 0},
+    {"clear", TokenKind::BuiltinAlgo, 0}, {"quit", TokenKind::BuiltinAlgo, 0},
+    {"int", TokenKind::BuiltinAlgo, 0}, {"float", TokenKind::BuiltinAlgo, 0},
+    {"string", TokenKind::BuiltinAlgo, 0}
 };
 
+// Perfect for RESERVED_WORD_LIST: no two of its words share a slot, so a
+// lookup is one hash and one compare however many words there are.
+constexpr size_t RESERVED_WORD_SLOTS{64};
+
+constexpr size_t reserved_word_hash(std::string_view word) {
+    return (static_cast<uint8_t>(word.front()) + static_cast<uint8_t>(word.back()) * 57 + word.size() * 5)
+        & (RESERVED_WORD_SLOTS - 1);
+}
+
+constexpr std::array<ReservedWord, RESERVED_WORD_SLOTS> make_reserved_words() {
+    std::array<ReservedWord, RESERVED_WORD_SLOTS> words{};
+    for(const ReservedWord &word : RESERVED_WORD_LIST)
+        words[reserved_word_hash(word.text)] = word;
+    return words;
+}
+
+inline constexpr std::array<ReservedWord, RESERVED_WORD_SLOTS> RESERVED_WORDS{make_reserved_words()};
+
+constexpr bool reserved_words_collide() {
+    for(const ReservedWord &word : RESERVED_WORD_LIST) {
+        if(RESERVED_WORDS[reserved_word_hash(word.text)].text != word.text)
+            return true;
+    }
+    return false;
+}
+
+static_assert(!reserved_words_collide(), "reserved_word_hash has to be changed for RESERVED_WORD_LIST");
+
+// Null for any other word.
+constexpr const ReservedWord* find_reserved_word(std::string_view word) {
+    if(word.empty())
+        return nullptr;
+    const ReservedWord &slot{RESERVED_WORDS[reserved_word_hash(word)]};
+    return slot.text == word ? &slot : nullptr;
+}
+
+/// Splits a source into a TokenStream. The text is not copied, so it has to
+/// outlive the Lexer and the stream.
 class Lexer {
 public:
-    Lexer(const std::string& _file_name, const std::string& _text)
-        : file_name(_file_name), text(_text)
-        , pos(-1, 0, -1, _file_name), current_char(NONE) {}
-    void advance();
-    TokenList make_tokens();
-    std::shared_ptr<Token> make_number();
-    std::shared_ptr<Token> make_identifier();
-    std::shared_ptr<Token> make_string();
+    Lexer(const std::string& _file_name, std::string_view _text)
+        : file(register_file(_file_name)), text(_text) {}
+    TokenStream lex();
 protected:
-    std::string file_name, text;
-    Position pos;
-    char current_char;
+    void lex_number(TokenStream&, size_t &index);
+    void lex_identifier(TokenStream&, size_t &index);
+    bool lex_string(TokenStream&, size_t &index);
+    uint16_t file;
+    std::string_view text;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+/// --------------------
+/// MemoCache
+/// --------------------
+
+#include "memo.h"
+
+size_t MemoCache::default_capacity{1000000};
+
+static bool cacheable(const TaggedValue &value) {
+    ValueKind kind{value.get_kind()};
+    return kind == ValueKind::None || kind == ValueKind::Int
+        || kind == ValueKind::Float || kind == ValueKind::Str;
+}
+
+// Each argument is its kind followed by its payload, strings by their
+// length and text, so one Int argument fits a short string.
+bool MemoCache::make_key(ValueSpan args, std::string &key) {
+    key.clear();
+    for(size_t i{0}; i < args.size(); ++i) {
+        const TaggedValue &arg{args[i]};
+        if(!cacheable(arg))
+            return false;
+        key.push_back(char(arg.get_kind()));
+        if(arg.get_kind() == ValueKind::Str) {
+            const std::string &text{arg.as<StringValue>()->get_value()};
+            uint64_t length{text.size()};
+            key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            key += text;
+        } else if(arg.get_kind() == ValueKind::Float) {
+            double payload{arg.get_float()};
+            key.append(reinterpret_cast<const char*>(&payload), sizeof(payload));
+        } else {
+            int64_t payload{arg.get_int()};
+            key.append(reinterpret_cast<const char*>(&payload), sizeof(payload));
+        }
+    }
+    return true;
+}
+
+bool MemoCache::find(const std::string &key, TaggedValue &result) {
+    auto it = table.find(key);
+    if(it == table.end()) {
+        ++misses;
+        return false;
+    }
+    ++hits;
+    result = it->second;
+    return true;
+}
+
+void MemoCache::insert(const std::string &key, const TaggedValue &result) {
+    if(table.size() >= capacity || !cacheable(result))
+        return;
+    table.emplace(key, result);
+}
@@ -0,0 +1,36 @@
+/// --------------------
+/// MemoCache
+/// --------------------
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "value.h"
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+/// Results of a pure `memo` Algorithm keyed by its arguments. Calls are only
+/// cached when every argument and the result are numbers, strings or none,
+/// arrays could change behind the cache. Once full the cache keeps what it
+/// has and stops taking new entries.
+class MemoCache {
+public:
+    MemoCache()
+        : capacity(default_capacity) {}
+    // Fills key and returns false when the arguments cannot be cached.
+    static bool make_key(ValueSpan args, std::string &key);
+    bool find(const std::string &key, TaggedValue &result);
+    void insert(const std::string &key, const TaggedValue &result);
+
+    static size_t default_capacity;
+    static int64_t get_hits() { return hits;}
+    static int64_t get_misses() { return misses;}
+
+protected:
+    std::unordered_map<std::string, TaggedValue> table;
+    size_t capacity;
+    inline static int64_t hits{0}, misses{0};
+};
+
+#endif
@@ -7,6 +7,22 @@
 #include <iostream>
 #include <sstream>
 
+// A request larger than a block gets a block of its own.
+void* NodeArena::Blocks::allocate(size_t size, size_t align) {
+    if(size > BLOCK_SIZE) {
+        blocks.emplace_back(new char[size]);
+        return blocks.back().get();
+    }
+    size_t start{(used + align - 1) & ~(align - 1)};
+    if(start + size > BLOCK_SIZE) {
+        blocks.emplace_back(new char[BLOCK_SIZE]);
+        current = blocks.back().get();
+        start = 0;
+    }
+    used = start + size;
+    return current + start;
+}
+
 std::string ValueNode::get_node() {
     return tok->get_tok();
 }
@@ -17,31 +33,23 @@ std::string ErrorNode::get_node() {
 
 std::string BinOpNode::get_node() {
     std::stringstream ss;
-    ss << "(" << left_node->get_node() << ", " << op_tok->get_tok() << ", " << right_node->get_node() << ")";
+    ss << "(" << child[0]->get_node() << ", " << op_tok->get_tok() << ", " << child[1]->get_node() << ")";
     std::string ret;
     std::getline(ss, ret);
     return ret;
 }
 
-NodeList BinOpNode::get_child() {
-    return NodeList{left_node, right_node};
-}
-
 std::string UnaryOpNode::get_node() {
     std::stringstream ss;
-    ss << "(" << op_tok->get_tok() << ", " << node->get_node() << ")";
+    ss << "(" << op_tok->get_tok() << ", " << child[0]->get_node() << ")";
     std::string ret;
     std::getline(ss, ret);
     return ret;
 }
 
-NodeList UnaryOpNode::get_child() {
-    return NodeList{node};
-}
-
 std::string VarAssignNode::get_node() {
     std::stringstream ss;
-    ss << "(VAR " << name << " <- " << node->get_node() << ")";
+    ss << "(VAR " << name << " <- " << child[0]->get_node() << ")";
     std::string ret;
     std::getline(ss, ret);
     return ret;
@@ -53,11 +61,11 @@ std::string VarAccessNode::get_node() {
 
 std::string IfNode::get_node() {
     std::stringstream ss;
-    ss << "(IF " << condition_node->get_node() << " THEN ";
-    for(auto node : expr_node)
+    ss << "(IF " << get_condition()->get_node() << " THEN ";
+    for(auto &node : get_expr())
         ss << node->get_node() << "; ";
     ss << "\nELSE ";
-    for(auto node : else_node)
+    for(auto &node : get_else())
         ss << node->get_node() << "; ";
     ss << ")";
     std::string ret;
@@ -65,13 +73,20 @@ std::string IfNode::get_node() {
     return ret;
 }
 
+void IfNode::set_branches(const NodeList &expr, const NodeList &else_node) {
+    child.resize(1);
+    child.insert(child.end(), expr.begin(), expr.end());
+    else_start = child.size();
+    child.insert(child.end(), else_node.begin(), else_node.end());
+}
+
 std::string ForNode::get_node() {
     std::stringstream ss;
-    ss << "(FOR " << var_assign->get_node() << " TO " << end_value->get_node();
-    if(step_value != nullptr)
-        ss << " STEP " << step_value->get_node();
+    ss << "(FOR " << child[0]->get_node() << " TO " << child[1]->get_node();
+    if(child[2] != nullptr)
+        ss << " STEP " << child[2]->get_node();
     ss << " DO ";
-    for(auto node : body_node)
+    for(auto &node : get_body())
         ss << node->get_node() << "; ";
     ss << ")";
     std::string ret;
@@ -81,8 +96,8 @@ std::string ForNode::get_node() {
 
 std::string WhileNode::get_node() {
     std::stringstream ss;
-    ss << "(WHILE " << condition->get_node() << " DO ";
-    for(auto node : body_node)
+    ss << "(WHILE " << child[0]->get_node() << " DO ";
+    for(auto &node : get_body())
         ss << node->get_node() << "; ";
     ss << ")";
     std::string ret;
@@ -93,9 +108,9 @@ std::string WhileNode::get_node() {
 std::string RepeatNode::get_node() {
     std::stringstream ss;
     ss << "(REPEAT ";
-    for(auto node : body_node)
+    for(auto &node : get_body())
         ss << node->get_node() << "; ";
-    ss << " UNTIL " << condition->get_node() << ")";
+    ss << " UNTIL " << child[0]->get_node() << ")";
     std::string ret;
     std::getline(ss, ret);
     return ret;
@@ -103,15 +118,15 @@ std::string RepeatNode::get_node() {
 
 std::string AlgorithmDefNode::get_node() {
     std::stringstream ss;
-    ss << "ALGORITHM " << algo_name->get_tok() << "(";
+    ss << (memo ? "MEMO ALGORITHM " : "ALGORITHM ") << algo_name->get_tok() << "(";
     if(!args_name.empty()) {
         ss << args_name[0]->get_tok();
     }
-    for(int i{1}; i < args_name.size(); ++i) {
+    for(size_t i{1}; i < args_name.size(); ++i) {
         ss << ", " << args_name[i]->get_tok();
     }
     ss << "):\n";
-    for(auto exp : body_node) {
+    for(auto &exp : child) {
         ss << TAB << exp->get_node() << "\n";
     }
     std::string ret, line;
@@ -125,11 +140,11 @@ std::string AlgorithmDefNode::get_node() {
 std::string AlgorithmCallNode::get_node() {
     std::stringstream ss;
     ss << "(CALL ALGORITHM " << call_node->get_name() << "(";
-    if(!args.empty()) {
-        ss << args[0]->get_node();
+    if(!child.empty()) {
+        ss << child[0]->get_node();
     }
-    for(int i{1}; i < args.size(); ++i) {
-        ss << ", " << args[i]->get_node();
+    for(size_t i{1}; i < child.size(); ++i) {
+        ss << ", " << child[i]->get_node();
     }
     ss << "))";
     std::string ret;
@@ -140,11 +155,11 @@ std::string AlgorithmCallNode::get_node() {
 std::string ArrayNode::get_node() {
     std::stringstream ss;
     ss << "{";
-    if(!elements_node.empty()) {
-        ss << elements_node[0]->get_node();
+    if(!child.empty()) {
+        ss << child[0]->get_node();
     }
-    for(int i{1}; i < elements_node.size(); ++i) {
-        ss << ", " << elements_node[i]->get_node();
+    for(size_t i{1}; i < child.size(); ++i) {
+        ss << ", " << child[i]->get_node();
     }
     ss << "}";
     std::string ret;
@@ -154,7 +169,7 @@ std::string ArrayNode::get_node() {
 
 std::string ArrayAccessNode::get_node() {
     std::stringstream ss;
-    ss << arr->get_node() << "[" << index->get_node() << "]";
+    ss << child[0]->get_node() << "[" << child[1]->get_node() << "]";
     std::string ret;
     std::getline(ss, ret);
     return ret;
@@ -162,7 +177,7 @@ std::string ArrayAccessNode::get_node() {
 
 std::string ArrayAssignNode::get_node() {
     std::stringstream ss;
-    ss << arr->get_node() << " <- " << value->get_node();
+    ss << child[0]->get_node() << " <- " << child[1]->get_node();
     std::string ret;
     std::getline(ss, ret);
     return ret;
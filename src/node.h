@@ -5,10 +5,10 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <stdexcept>
 #include <string>
 #include <vector>
 #include <memory>
+#include <cstdint>
 #include "token.h"
 
 const std::string NODE_VALUE{"VALUE"};
@@ -26,25 +26,162 @@ const std::string NODE_ALGOCALL("CALL");
 const std::string NODE_ARRAY("ARRAY");
 const std::string NODE_ARRACCESS("ARRACCESS");
 const std::string NODE_ARRASSIGN("ARRASSIGN");
+const std::string NODE_CONST("CONST");
 const std::string TAB{"    "};
 
+class MemoCache;
+
+enum class NodeKind : uint8_t {
+    None, Value, BinOp, Error, UnaryOp, VarAssign, VarAccess,
+    If, For, While, Repeat, AlgoDef, AlgoCall, Array, ArrAccess, ArrAssign,
+    Const
+};
+
+// Where a variable lives, filled in by Resolver. Local is a slot of the
+// running Algorithm, Global an index into the global array, and Dynamic a
+// name the Algorithm never assigns, found through its callers at runtime.
+enum class VarScope : uint8_t {
+    Unresolved, Local, Global, Dynamic
+};
+
+// The form a node has specialized itself into, from the operands it saw
+// the first time the tree walker ran it. Generic is where a node ends up
+// when it cannot specialize, or when a guard of its specialized form fails.
+enum class Quickened : uint8_t {
+    Uninitialized, Generic,
+    // BinOp on two Ints, or on numbers one of which is a Float
+    Int, Float,
+    // VarAccess of a local or a global slot that held a value
+    Slot,
+    // ArrAccess of an array by an Int
+    IntIndex
+};
+
+/// Named slots of an Algorithm body, parameters first. Names are indices
+/// into the NameTable the body was resolved with.
+struct FrameLayout {
+    int param_count{0};
+    std::vector<int> slot_names;
+    // Slot of each name, -1 when the name is not local.
+    std::vector<int> name_slots;
+
+    int slot_count() const { return slot_names.size();}
+    int slot_of(int name) const {
+        return static_cast<size_t>(name) < name_slots.size() ? name_slots[name] : -1;
+    }
+};
+
+class Node;
+
+/// Memory the nodes of one parse, and their lists of children, are made
+/// in, one after another in large blocks. All that is made in it keeps the
+/// blocks alive, they are freed together once the last of it is gone.
+class NodeArena {
+    struct Blocks {
+        static constexpr size_t BLOCK_SIZE{64 * 1024};
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *current{nullptr};
+        size_t used{BLOCK_SIZE};
+        void* allocate(size_t size, size_t align);
+    };
+public:
+    // Takes memory from the arena active when it was made, or from the heap
+    // when there was none. Memory of an arena is never given back alone.
+    template<typename T>
+    struct Allocator {
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        std::shared_ptr<Blocks> blocks;
+        Allocator()
+            : blocks(active) {}
+        Allocator(std::shared_ptr<Blocks> _blocks)
+            : blocks(std::move(_blocks)) {}
+        template<typename U>
+        Allocator(const Allocator<U> &other)
+            : blocks(other.blocks) {}
+        T* allocate(size_t n) {
+            if(blocks == nullptr)
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            return static_cast<T*>(blocks->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T *p, size_t) {
+            if(blocks == nullptr)
+                ::operator delete(p);
+        }
+        template<typename U>
+        bool operator==(const Allocator<U> &other) const { return blocks == other.blocks;}
+        template<typename U>
+        bool operator!=(const Allocator<U> &other) const { return blocks != other.blocks;}
+    };
+
+    NodeArena()
+        : blocks(std::make_shared<Blocks>()) {}
+    template<typename T, typename... Args>
+    std::shared_ptr<T> make(Args&&... args) {
+        return std::allocate_shared<T>(Allocator<T>{blocks}, std::forward<Args>(args)...);
+    }
+    // NodeLists made from now until deactivate() are made in the arena.
+    void activate() { active = blocks;}
+    static void deactivate() { active = nullptr;}
+private:
+    inline static std::shared_ptr<Blocks> active;
+    std::shared_ptr<Blocks> blocks;
+};
+
+using NodeList = std::vector<std::shared_ptr<Node>, NodeArena::Allocator<std::shared_ptr<Node>>>;
+
+/// Part of a NodeList, such as the body of a loop, read where it is.
+struct NodeSpan {
+    NodeSpan(const NodeList &list, size_t from = 0)
+        : data(list.data() + from), count(list.size() - from) {}
+    NodeSpan(const NodeList &list, size_t from, size_t to)
+        : data(list.data() + from), count(to - from) {}
+    const std::shared_ptr<Node> *data;
+    size_t count;
+    size_t size() const { return count;}
+    bool empty() const { return count == 0;}
+    const std::shared_ptr<Node>& operator[](size_t i) const { return data[i];}
+    const std::shared_ptr<Node>& back() const { return data[count - 1];}
+    const std::shared_ptr<Node>* begin() const { return data;}
+    const std::shared_ptr<Node>* end() const { return data + count;}
+};
+
 class Node {
 public:
+    Node(NodeKind _kind = NodeKind::None, NodeList _child = {})
+        : kind(_kind), child(std::move(_child)) {}
+    NodeKind get_kind() const { return kind;}
     virtual std::string get_node() = 0;
     virtual ~Node() {};
-    virtual std::vector<std::shared_ptr<Node>> get_child() { return std::vector<std::shared_ptr<Node>>(0);}
+    // Every node keeps its children in this one list, a node with named
+    // children has them at fixed places in it.
+    const NodeList& get_child() const { return child;}
+    // Replaces the children, given in the order get_child returns them.
+    void set_child(const NodeList &_child) { child = _child;}
     virtual std::string get_type() {return "NONE";}
     virtual std::shared_ptr<Token> get_tok() { return nullptr;}
     virtual TokenList get_toks() { return TokenList(0);}
     virtual std::string get_name() {return "";}
+    // Cleared by Resolver on loops whose value nobody reads, so that they
+    // do not collect it.
+    bool is_value_used() const { return value_used;}
+    void set_value_used(bool used) { value_used = used;}
+    // Only the Interpreter reads and rewrites this.
+    Quickened get_quickened() const { return quickened;}
+    void set_quickened(Quickened state) { quickened = state;}
+protected:
+    NodeKind kind;
+    bool value_used{true};
+    Quickened quickened{Quickened::Uninitialized};
+    NodeList child;
 };
 
-using NodeList = std::vector<std::shared_ptr<Node>>;
-
 class ErrorNode: public Node {
 public:
     ErrorNode(std::shared_ptr<Token> _tok)
-        : tok(_tok) {}
+        : Node(NodeKind::Error), tok(_tok) {}
     std::string get_node() override;
     std::shared_ptr<Token> get_tok() override { return tok;}
     std::string get_type() override {return NODE_ERROR;}
@@ -55,7 +192,7 @@ protected:
 class ValueNode: public Node {
 public:
     ValueNode(std::shared_ptr<Token> _tok)
-        : tok(_tok) {}
+        : Node(NodeKind::Value), tok(_tok) {}
     std::string get_node() override;
     std::string get_type() override {return NODE_VALUE;}
     std::shared_ptr<Token> get_tok() override { return tok;}
@@ -63,200 +200,209 @@ protected:
     std::shared_ptr<Token> tok;
 };
 
+// Children: left, right.
 class BinOpNode: public Node {
 public:
     BinOpNode(std::shared_ptr<Node> left, std::shared_ptr<Node> right, std::shared_ptr<Token> tok)
-        : left_node(left), right_node(right), op_tok(tok) {}
+        : Node(NodeKind::BinOp, NodeList{std::move(left), std::move(right)}), op_tok(tok) {}
     std::string get_node() override;
-    NodeList get_child() override;
     std::string get_type() override {return NODE_BINOP;}
     std::shared_ptr<Token> get_tok() override { return op_tok;}
+    const std::shared_ptr<Node>& get_left() const { return child[0];}
+    const std::shared_ptr<Node>& get_right() const { return child[1];}
+    TokenKind get_op() const { return op_tok->get_kind();}
 protected:
-    std::shared_ptr<Node> left_node, right_node;
     std::shared_ptr<Token> op_tok;
 };
 
+// Children: operand.
 class UnaryOpNode: public Node {
 public:
     UnaryOpNode(std::shared_ptr<Node> _node, std::shared_ptr<Token> tok)
-        : node(_node), op_tok(tok) {}
+        : Node(NodeKind::UnaryOp, NodeList{std::move(_node)}), op_tok(tok) {}
     std::string get_node() override;
-    NodeList get_child() override;
     std::string get_type() override { return NODE_UNARYOP;}
     std::shared_ptr<Token> get_tok() override { return op_tok;}
 protected:
-    std::shared_ptr<Node> node;
     std::shared_ptr<Token> op_tok;
 };
 
+// Children: value.
 class VarAssignNode: public Node {
 public:
     VarAssignNode(std::string _name, std::shared_ptr<Node> _node)
-        : name(_name), node(_node) {}
+        : Node(NodeKind::VarAssign, NodeList{std::move(_node)}), name(_name) {}
     std::string get_node() override;
-    NodeList get_child() override { return NodeList{node};}
     std::string get_type() override { return NODE_VARASSIGN;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override {return name;}
+    void resolve(VarScope _scope, int _index) { scope = _scope; index = _index;}
+    VarScope get_scope() const { return scope;}
+    int get_index() const { return index;}
 protected:
     std::string name;
-    std::shared_ptr<Node> node;
+    VarScope scope{VarScope::Unresolved};
+    int index{0};
 };
 
 class VarAccessNode: public Node {
 public:
     VarAccessNode(std::shared_ptr<Token> _tok)
-        : tok(_tok) {}
+        : Node(NodeKind::VarAccess), tok(_tok) {}
     std::string get_node() override;
-    NodeList get_child() override { return NodeList(0);}
     std::string get_type() override{ return NODE_VARACCESS;}
     std::shared_ptr<Token> get_tok() override { return tok;}
     std::string get_name() override {return tok->get_value();}
+    void resolve(VarScope _scope, int _index) { scope = _scope; index = _index;}
+    VarScope get_scope() const { return scope;}
+    int get_index() const { return index;}
 protected:
     std::shared_ptr<Token> tok;
+    VarScope scope{VarScope::Unresolved};
+    int index{0};
 };
 
+// Children: condition, the statements of the branch taken when it holds,
+// then those of the other one.
 class IfNode: public Node {
 public:
-    IfNode(std::shared_ptr<Node> condition, NodeList expr, NodeList _else_node)
-        : condition_node(condition), expr_node(expr), else_node(_else_node) {}
+    IfNode(std::shared_ptr<Node> condition, const NodeList &expr, const NodeList &else_node)
+        : Node(NodeKind::If, NodeList{std::move(condition)}) { set_branches(expr, else_node);}
     std::string get_node() override;
-    NodeList get_child() override {
-        throw std::runtime_error("should not call get_child on if node");
-    }
-    const std::shared_ptr<Node>& get_condition() { return condition_node;}
-    const NodeList& get_expr() { return expr_node;}
-    const NodeList& get_else() { return else_node;}
+    const std::shared_ptr<Node>& get_condition() const { return child[0];}
+    NodeSpan get_expr() const { return NodeSpan(child, 1, else_start);}
+    NodeSpan get_else() const { return NodeSpan(child, else_start);}
+    void set_condition(std::shared_ptr<Node> condition) { child[0] = std::move(condition);}
+    void set_branches(const NodeList &expr, const NodeList &else_node);
     std::string get_type() override{ return NODE_IF;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return "";}
 protected:
-    std::shared_ptr<Node> condition_node; 
-    NodeList expr_node, else_node;
+    uint32_t else_start{1};
 };
 
+// Children: the assignment of the start value, end, step (null when not
+// given), then the body.
 class ForNode: public Node {
 public:
     ForNode(
         std::shared_ptr<Node> _var_assign, std::shared_ptr<Node> _end_value,
-        std::shared_ptr<Node> _step_value, NodeList _body_node
-    )   : var_assign(_var_assign), end_value(_end_value), step_value(_step_value), body_node(_body_node) {}
-    std::string get_node() override;
-    NodeList get_child() override {
-        NodeList child{var_assign, end_value, step_value};
-        for(auto node : body_node) child.push_back(node);
-        return child;
+        std::shared_ptr<Node> _step_value, const NodeList &_body_node
+    )   : Node(NodeKind::For, NodeList{std::move(_var_assign), std::move(_end_value), std::move(_step_value)}) {
+        child.insert(child.end(), _body_node.begin(), _body_node.end());
     }
+    std::string get_node() override;
+    NodeSpan get_body() const { return NodeSpan(child, 3);}
     std::string get_type() override { return NODE_FOR;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return "";}
-protected:
-    std::shared_ptr<Node> var_assign, end_value, step_value;
-    NodeList body_node;
 };
 
+// Children: condition, then the body.
 class WhileNode: public Node {
 public:
-    WhileNode(std::shared_ptr<Node> _condition, NodeList _body_node)
-        : condition(_condition), body_node(_body_node) {}
-    std::string get_node() override;
-    NodeList get_child() override {
-        NodeList child{condition};
-        for(auto node : body_node) child.push_back(node);
-        return child;
+    WhileNode(std::shared_ptr<Node> _condition, const NodeList &_body_node)
+        : Node(NodeKind::While, NodeList{std::move(_condition)}) {
+        child.insert(child.end(), _body_node.begin(), _body_node.end());
     }
+    std::string get_node() override;
+    NodeSpan get_body() const { return NodeSpan(child, 1);}
     std::string get_type() override { return NODE_WHILE;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return "";}
-protected:
-    std::shared_ptr<Node> condition;
-    NodeList body_node;
 };
 
+// Children: condition, then the body.
 class RepeatNode: public Node {
 public:
-    RepeatNode(NodeList _body_node, std::shared_ptr<Node> _condition)
-        : condition(_condition), body_node(_body_node) {}
-    std::string get_node() override;
-    NodeList get_child() override {
-        NodeList child{condition};
-        for(auto node : body_node) child.push_back(node);
-        return child;
+    RepeatNode(const NodeList &_body_node, std::shared_ptr<Node> _condition)
+        : Node(NodeKind::Repeat, NodeList{std::move(_condition)}) {
+        child.insert(child.end(), _body_node.begin(), _body_node.end());
     }
+    std::string get_node() override;
+    NodeSpan get_body() const { return NodeSpan(child, 1);}
     std::string get_type() override { return NODE_REPEAT;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return "";}
-protected:
-    std::shared_ptr<Node> condition;
-    NodeList body_node;
 };
 
+// Children: the body.
 class AlgorithmDefNode: public Node {
 public:
-    AlgorithmDefNode(std::shared_ptr<Token> _algo_name, const TokenList &_args_name, NodeList _body_node = {})
-        : algo_name(_algo_name), args_name(_args_name), body_node(_body_node) {}
+    AlgorithmDefNode(std::shared_ptr<Token> _algo_name, const TokenList &_args_name, NodeList _body_node = {}, bool _memo = false)
+        : Node(NodeKind::AlgoDef, std::move(_body_node)), algo_name(_algo_name), args_name(_args_name), memo(_memo) {}
     std::string get_node() override;
-    NodeList get_child() override { return body_node;}
     std::string get_type() override { return NODE_ALGODEF;}
     std::shared_ptr<Token> get_tok() override { return algo_name;}
     TokenList get_toks() override { return args_name;}
     std::string get_name() override { return algo_name->get_value();}
+    void resolve(VarScope _scope, int _index) { scope = _scope; index = _index;}
+    VarScope get_scope() const { return scope;}
+    int get_index() const { return index;}
+    std::shared_ptr<FrameLayout>& get_layout() { return layout;}
+    const NodeList& get_body() const { return child;}
+    bool is_memo() const { return memo;}
+    // Set by Resolver for a `memo` Algorithm it found pure, null otherwise.
+    MemoCache* get_memo_cache() const { return memo_cache.get();}
+    void set_memo_cache(std::shared_ptr<MemoCache> cache) { memo_cache = cache;}
 protected:
     std::shared_ptr<Token> algo_name;
     TokenList args_name;
-    NodeList body_node;
+    bool memo;
+    std::shared_ptr<MemoCache> memo_cache;
+    // Scope of the name the Algorithm is stored under, and its body's slots.
+    VarScope scope{VarScope::Unresolved};
+    int index{0};
+    std::shared_ptr<FrameLayout> layout;
 };
 
+// Children: the arguments. The callee is kept apart.
 class AlgorithmCallNode: public Node {
 public:
     AlgorithmCallNode(std::shared_ptr<Node> _call_node, const NodeList &_args)
-        : call_node(_call_node), args(_args) {}
+        : Node(NodeKind::AlgoCall, _args), call_node(_call_node) {}
     std::string get_node() override;
-    NodeList get_child() override { return args;}
     std::string get_type() override { return NODE_ALGOCALL;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return call_node->get_name();}
-    std::shared_ptr<Node> get_call() { return call_node;}
+    const std::shared_ptr<Node>& get_call() const { return call_node;}
+    void set_call(std::shared_ptr<Node> call) { call_node = call;}
+    const NodeList& get_args() const { return child;}
 protected:
     std::shared_ptr<Node> call_node;
-    NodeList args;
 };
 
+// Children: the elements.
 class ArrayNode: public Node {
 public:
     ArrayNode(const NodeList &_elements_node)
-        : elements_node(_elements_node) {}
+        : Node(NodeKind::Array, _elements_node) {}
     std::string get_node() override;
-    NodeList get_child() override { return elements_node;}
     std::string get_type() override { return NODE_ARRAY;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
     std::string get_name() override { return "";}
-protected:
-    NodeList elements_node;
 };
 
+// Children: array, index.
 class ArrayAccessNode: public Node {
 public:
     ArrayAccessNode(std::shared_ptr<Node> _arr, std::shared_ptr<Node> _index)
-        : arr(_arr), index(_index) {}
+        : Node(NodeKind::ArrAccess, NodeList{std::move(_arr), std::move(_index)}) {}
     std::string get_node() override;
-    NodeList get_child() override { return NodeList{arr, index};}
     std::string get_type() override { return NODE_ARRACCESS;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
-protected:
-    std::shared_ptr<Node> arr, index;
+    const std::shared_ptr<Node>& get_arr() const { return child[0];}
+    const std::shared_ptr<Node>& get_index() const { return child[1];}
 };
 
+// Children: the element assigned to, value.
 class ArrayAssignNode: public Node {
 public:
     ArrayAssignNode(std::shared_ptr<Node> _arr, std::shared_ptr<Node> _value)
-        : arr(_arr), value(_value) {}
+        : Node(NodeKind::ArrAssign, NodeList{std::move(_arr), std::move(_value)}) {}
     std::string get_node() override;
-    NodeList get_child() override { return NodeList{arr, value};}
     std::string get_type() override { return NODE_ARRASSIGN;}
     std::shared_ptr<Token> get_tok() override { return nullptr;}
-protected:
-    std::shared_ptr<Node> arr, value;
 };
 
 #endif
\ No newline at end of file
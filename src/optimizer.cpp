@@ -0,0 +1,113 @@
+/// --------------------
+/// Optimizer
+/// --------------------
+
+#include "optimizer.h"
+#include "interpreter.h"
+
+// Errors are left for the run to report, arrays are mutable so every
+// evaluation has to build its own.
+static bool foldable(const TaggedValue &value) {
+    ValueKind kind{value.get_kind()};
+    return kind == ValueKind::None || kind == ValueKind::Int
+        || kind == ValueKind::Float || kind == ValueKind::Str;
+}
+
+static const TaggedValue* const_value(const std::shared_ptr<Node> &node) {
+    if(node == nullptr || node->get_kind() != NodeKind::Const)
+        return nullptr;
+    return &static_cast<ConstNode*>(node.get())->get_value();
+}
+
+void Optimizer::optimize(NodeList &nodes) {
+    for(auto &node : nodes)
+        node = optimize(node);
+}
+
+std::shared_ptr<Node> Optimizer::optimize(std::shared_ptr<Node> node) {
+    if(node == nullptr)
+        return node;
+    switch(node->get_kind()) {
+        case NodeKind::Value: return optimize_value(node);
+        case NodeKind::BinOp: return optimize_bin_op(node);
+        case NodeKind::UnaryOp: return optimize_unary_op(node);
+        case NodeKind::If: return optimize_if(node);
+        case NodeKind::AlgoCall: {
+            AlgorithmCallNode *algo_call_node = static_cast<AlgorithmCallNode*>(node.get());
+            algo_call_node->set_call(optimize(algo_call_node->get_call()));
+            break;
+        }
+        default: break;
+    }
+    NodeList child{node->get_child()};
+    if(child.empty())
+        return node;
+    optimize(child);
+    node->set_child(child);
+    return node;
+}
+
+std::shared_ptr<Node> Optimizer::optimize_value(std::shared_ptr<Node> node) {
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Int: return std::make_shared<ConstNode>(make_int(std::stoll(node->get_tok()->get_value())));
+        case TokenKind::Float: return std::make_shared<ConstNode>(make_float(std::stod(node->get_tok()->get_value())));
+        case TokenKind::String: return std::make_shared<ConstNode>(make_string(node->get_tok()->get_value()));
+        default: return node;
+    }
+}
+
+std::shared_ptr<Node> Optimizer::optimize_bin_op(std::shared_ptr<Node> node) {
+    NodeList child{node->get_child()};
+    optimize(child);
+    node->set_child(child);
+    const TaggedValue *a{const_value(child[0])}, *b{const_value(child[1])};
+    if(a == nullptr || b == nullptr)
+        return node;
+    TaggedValue result{Interpreter::bin_op(*a, *b, node->get_tok())};
+    if(!foldable(result))
+        return node;
+    return std::make_shared<ConstNode>(std::move(result));
+}
+
+std::shared_ptr<Node> Optimizer::optimize_unary_op(std::shared_ptr<Node> node) {
+    NodeList child{node->get_child()};
+    optimize(child);
+    node->set_child(child);
+    const TaggedValue *a{const_value(child[0])};
+    if(a == nullptr)
+        return node;
+    TaggedValue result{Interpreter::unary_op(*a, node->get_tok())};
+    if(!foldable(result))
+        return node;
+    return std::make_shared<ConstNode>(std::move(result));
+}
+
+// A branch of a single statement replaces the whole if. A longer one keeps
+// the if around it, now with an empty other branch.
+std::shared_ptr<Node> Optimizer::optimize_if(std::shared_ptr<Node> node) {
+    IfNode* if_node = static_cast<IfNode*>(node.get());
+    if_node->set_condition(optimize(if_node->get_condition()));
+    NodeSpan expr_span{if_node->get_expr()}, else_span{if_node->get_else()};
+    NodeList expr(expr_span.begin(), expr_span.end()), else_node(else_span.begin(), else_span.end());
+    optimize(expr);
+    optimize(else_node);
+    if_node->set_branches(expr, else_node);
+
+    const TaggedValue *cond{const_value(if_node->get_condition())};
+    if(cond == nullptr || !foldable(*cond))
+        return node;
+    if(as_integer(*cond) == 1) {
+        if(expr.empty())
+            return std::make_shared<ConstNode>(TaggedValue());
+        if(expr.size() == 1)
+            return expr[0];
+        if_node->set_branches(expr, NodeList());
+        return node;
+    }
+    if(else_node.empty())
+        return std::make_shared<ConstNode>(make_int(0));
+    if(else_node.size() == 1)
+        return else_node[0];
+    if_node->set_branches(NodeList(), else_node);
+    return node;
+}
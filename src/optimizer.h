@@ -0,0 +1,43 @@
+/// --------------------
+/// Optimizer
+/// --------------------
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "node.h"
+#include "value.h"
+#include <memory>
+#include <string>
+
+/// A literal, or an expression computed ahead of time, holding its value.
+class ConstNode: public Node {
+public:
+    ConstNode(TaggedValue _value)
+        : Node(NodeKind::Const), value(std::move(_value)) {}
+    std::string get_node() override { return "CONST:" + value.repr();}
+    std::string get_type() override { return NODE_CONST;}
+    const TaggedValue& get_value() const { return value;}
+protected:
+    TaggedValue value;
+};
+
+/// Runs on the NodeList returned by Parser::parse(), before Resolver.
+/// Literals become ConstNodes, operators whose operands are constant are
+/// computed once, and an if with a constant condition keeps only the branch
+/// it takes.
+class Optimizer {
+public:
+    void optimize(NodeList&);
+    // Set by the shell to print the tree once optimized.
+    inline static bool dump{false};
+
+protected:
+    std::shared_ptr<Node> optimize(std::shared_ptr<Node>);
+    std::shared_ptr<Node> optimize_value(std::shared_ptr<Node>);
+    std::shared_ptr<Node> optimize_bin_op(std::shared_ptr<Node>);
+    std::shared_ptr<Node> optimize_unary_op(std::shared_ptr<Node>);
+    std::shared_ptr<Node> optimize_if(std::shared_ptr<Node>);
+};
+
+#endif
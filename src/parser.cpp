@@ -7,442 +7,409 @@
 #include "lexer.h"
 #include "node.h"
 #include "token.h"
-#include <iostream>
 #include <string>
-#include <algorithm>
 
-std::shared_ptr<Token> Parser::advance() {
-    tok_index++;
-    if(tok_index >= 0 && tok_index < tokens.size())
-        current_tok = tokens[tok_index];
-    else
-        current_tok = std::make_shared<Token>();
-    return current_tok;
+static bool is_error(const std::shared_ptr<Node> &node) {
+    return node->get_kind() == NodeKind::Error;
 }
 
-std::shared_ptr<Token> Parser::back() {
-    tok_index--;
-    if(tok_index >= 0 && tok_index < tokens.size())
-        current_tok = tokens[tok_index];
-    else
-        current_tok = std::make_shared<Token>();
-    return current_tok;
+// Operators on one level are left associative, 0 is any other token.
+static int binary_precedence(TokenKind kind) {
+    switch(kind) {
+        case TokenKind::And:
+        case TokenKind::Or:
+            return PREC_LOGICAL;
+        case TokenKind::Equal:
+        case TokenKind::Neq:
+        case TokenKind::Less:
+        case TokenKind::Greater:
+        case TokenKind::Leq:
+        case TokenKind::Geq:
+            return PREC_COMPARE;
+        case TokenKind::Add:
+        case TokenKind::Sub:
+            return PREC_SUM;
+        case TokenKind::Mul:
+        case TokenKind::Div:
+        case TokenKind::Mod:
+            return PREC_PRODUCT;
+        default:
+            return PREC_NONE;
+    }
+}
+
+// Past the last lexeme, everything reads as None.
+const Lexeme& Parser::peek(size_t ahead) const {
+    static const Lexeme end{TokenKind::None, 0, 0};
+    return index + ahead < lexemes.size() ? lexemes[index + ahead] : end;
+}
+
+// Tabs after the current newline.
+int Parser::indentation() const {
+    int tabs{0};
+    while(kind(tabs + 1) == TokenKind::Tab)
+        tabs++;
+    return tabs;
+}
+
+std::shared_ptr<Token> Parser::token() const {
+    if(index >= lexemes.size())
+        return std::make_shared<Token>();
+    return stream.to_token(lexemes[index]);
+}
+
+Position Parser::position() const {
+    if(index >= lexemes.size())
+        return Position();
+    return stream.position(lexemes[index].offset);
+}
+
+std::shared_ptr<Node> Parser::error(const std::string &message) {
+    return arena.make<ErrorNode>(std::make_shared<ErrorToken>(TOKEN_ERROR, position(), message));
 }
 
 std::shared_ptr<Node> Parser::atom(int tab_expect) {
-    std::shared_ptr<Token> tok = current_tok;
     std::string error_msg{"Not a atom, found \""};
-    if(tok->isnumber()) {
-        advance();
-        return std::make_shared<ValueNode>(tok);
-    } else if(tok->get_type() == TOKEN_STRING) {
-        advance();
-        return std::make_shared<ValueNode>(tok);
-    } else if(tok->get_type() == TOKEN_BUILTIN_CONST) {
-        advance();
-        std::shared_ptr<Token> ret{std::make_shared<TypedToken<int64_t>>(TOKEN_INT, tok->get_pos(), BUILTIN_CONST.at(tok->get_value()))};
-        return std::make_shared<ValueNode>(ret);
-    }  else if(tok->get_type() == TOKEN_BUILTIN_ALGO) {
-        advance();
-        return std::make_shared<VarAccessNode>(tok);
-    } else if(tok->get_type() == TOKEN_LEFT_PAREN) {
-        advance();
-        std::shared_ptr<Node> e{expr(tab_expect)};
-        if(current_tok->get_type() == TOKEN_RIGHT_PAREN) {
+    if((kind() == TokenKind::BuiltinConst || kind() == TokenKind::BuiltinAlgo) && kind(1) == TokenKind::Assign)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Cannot assign to \"" + std::string(stream.text(peek())) + "\"" RESET "\n");
+    switch(kind()) {
+        case TokenKind::Int:
+        case TokenKind::Float:
+        case TokenKind::String: {
+            std::shared_ptr<Node> ret{arena.make<ValueNode>(token())};
             advance();
-            return e;
+            return ret;
         }
-        error_msg += "Expected \')\'" RESET "\n";
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    } else if(tok->get_type() == TOKEN_IDENTIFIER) {
-        advance();
-        if(current_tok->get_type() == TOKEN_ASSIGN) {
+        case TokenKind::BuiltinConst: {
+            std::shared_ptr<Token> ret{std::make_shared<TypedToken<int64_t>>(
+                TokenKind::Int, position(), find_reserved_word(stream.text(peek()))->value)};
             advance();
-            std::shared_ptr<Node> ret = expr(tab_expect);
-            if(ret->get_type() == NODE_ERROR) return ret;
-            return std::make_shared<VarAssignNode>(tok->get_value(), ret);
+            return arena.make<ValueNode>(ret);
         }
-        return std::make_shared<VarAccessNode>(tok);
-    } else if(tok->get_type() == TOKEN_KEYWORD && tok->get_value() == "if") {
-        advance();
-        return if_expr(tab_expect);
-    } else if(tok->get_type() == TOKEN_KEYWORD && tok->get_value() == "for") {
-        advance();
-        return for_expr(tab_expect);
-    } else if(tok->get_type() == TOKEN_KEYWORD && tok->get_value() == "while") {
-        advance();
-        return while_expr(tab_expect);
-    } else if(tok->get_type() == TOKEN_KEYWORD && tok->get_value() == "repeat") {
-        advance();
-        return repeat_expr(tab_expect);
-    } else if(tok->get_type() == TOKEN_KEYWORD && tok->get_value() == "Algorithm") {
-        advance();
-        return algo_def(tab_expect);
-    } else if(tok->get_type() == TOKEN_LEFT_BRACE) {
-        advance();
-        return array_expr(tab_expect);
+        case TokenKind::BuiltinAlgo: {
+            std::shared_ptr<Node> ret{arena.make<VarAccessNode>(token())};
+            advance();
+            return ret;
+        }
+        case TokenKind::LeftParen: {
+            advance();
+            std::shared_ptr<Node> e{expr(tab_expect)};
+            if(kind() == TokenKind::RightParen) {
+                advance();
+                return e;
+            }
+            error_msg += "Expected \')\'" RESET "\n";
+            return error(error_msg);
+        }
+        case TokenKind::Identifier: {
+            std::shared_ptr<Token> tok{token()};
+            advance();
+            // memo only means something right before Algorithm, it stays a
+            // usable variable name.
+            if(tok->get_value() == "memo" && kind() == TokenKind::Algorithm) {
+                advance();
+                return algo_def(tab_expect, true);
+            }
+            if(kind() == TokenKind::Assign) {
+                advance();
+                std::shared_ptr<Node> ret = expr(tab_expect);
+                if(is_error(ret)) return ret;
+                return arena.make<VarAssignNode>(tok->get_value(), ret);
+            }
+            return arena.make<VarAccessNode>(tok);
+        }
+        case TokenKind::If:
+            advance();
+            return if_expr(tab_expect);
+        case TokenKind::For:
+            advance();
+            return for_expr(tab_expect);
+        case TokenKind::While:
+            advance();
+            return while_expr(tab_expect);
+        case TokenKind::Repeat:
+            advance();
+            return repeat_expr(tab_expect);
+        case TokenKind::Algorithm:
+            advance();
+            return algo_def(tab_expect);
+        case TokenKind::LeftBrace:
+            advance();
+            return array_expr(tab_expect);
+        default:
+            break;
     }
 
     error_msg += "\"" RESET "\n" ;
-    std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-    return std::make_shared<ErrorNode>(error_token);
+    return error(error_msg);
 }
 
 std::shared_ptr<Node> Parser::factor(int tab_expect) {
-    std::shared_ptr<Token> tok = current_tok;
-    if(tok->get_type() == TOKEN_ADD || tok->get_type() == TOKEN_SUB) {
+    if(kind() == TokenKind::Add || kind() == TokenKind::Sub) {
+        std::shared_ptr<Token> tok{token()};
         advance();
-        return std::make_shared<UnaryOpNode>(factor(tab_expect), tok);
+        return arena.make<UnaryOpNode>(factor(tab_expect), tok);
     }
     return pow(tab_expect);
 }
 
-std::shared_ptr<Node> Parser::term(int tab_expect) {
-    return bin_op(
-        tab_expect,
-        std::bind(&Parser::factor, this, tab_expect), 
-        {TOKEN_MUL, TOKEN_DIV, TOKEN_MOD}, 
-        std::bind(&Parser::factor, this, tab_expect));
-}
-
-std::shared_ptr<Node> Parser::expr(int tab_expect) {
-    return bin_op(
-        tab_expect,
-        std::bind(&Parser::comp_expr, this, tab_expect), 
-        {"and", "or"}, 
-        std::bind(&Parser::comp_expr, this, tab_expect));
-}
-
-std::shared_ptr<Node> Parser::comp_expr(int tab_expect) {
-    std::shared_ptr<Token> tok = current_tok;
-    if(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "not") {
+// Precedence climbing: the loop takes every operator that binds at least
+// as tight as min_precedence, and its right side only those binding
+// tighter, which keeps each level left associative.
+std::shared_ptr<Node> Parser::expr(int tab_expect, int min_precedence) {
+    std::shared_ptr<Node> left;
+    // `not` takes a whole comparison, so only operands of `and` and `or`
+    // may start with it.
+    if(kind() == TokenKind::Not && min_precedence <= PREC_COMPARE) {
+        std::shared_ptr<Token> tok{token()};
         advance();
-        std::shared_ptr<Node> ret = comp_expr(tab_expect);
-        if(ret->get_type() == NODE_ERROR) return ret;
-        return std::make_shared<UnaryOpNode>(ret, tok);
+        std::shared_ptr<Node> operand{expr(tab_expect, PREC_COMPARE)};
+        if(is_error(operand)) return operand;
+        left = arena.make<UnaryOpNode>(operand, tok);
+    } else {
+        left = factor(tab_expect);
+        if(is_error(left)) return left;
     }
-    return bin_op(
-        tab_expect,
-        std::bind(&Parser::arith_expr, this, tab_expect), 
-        {TOKEN_EQUAL, TOKEN_NEQ, TOKEN_LESS, TOKEN_GREATER, TOKEN_LEQ, TOKEN_GEQ}, 
-        std::bind(&Parser::arith_expr, this, tab_expect));
-}
-
-std::shared_ptr<Node> Parser::arith_expr(int tab_expect) {
-    return bin_op(
-        tab_expect,
-        std::bind(&Parser::term, this, tab_expect), 
-        {TOKEN_ADD, TOKEN_SUB}, 
-        std::bind(&Parser::term, this, tab_expect));
+    for(int precedence{binary_precedence(kind())}; precedence >= min_precedence;
+        precedence = binary_precedence(kind())) {
+        std::shared_ptr<Token> op_tok{token()};
+        advance();
+        std::shared_ptr<Node> right{expr(tab_expect, precedence + 1)};
+        if(is_error(right)) return right;
+        left = arena.make<BinOpNode>(left, right, op_tok);
+    }
+    return left;
 }
 
 std::shared_ptr<Node> Parser::array_expr(int tab_expect) {
     NodeList ret;
-    if(current_tok->get_type() == TOKEN_RIGHT_BRACE) {
+    if(kind() == TokenKind::RightBrace) {
         advance();
-        return std::make_shared<ArrayNode>(ret);
+        return arena.make<ArrayNode>(ret);
     }
     ret.push_back(expr(tab_expect));
-    if(ret.back()->get_type() == NODE_ERROR) return ret.back();
-    while(current_tok->get_type() == TOKEN_COMMA) {
+    if(is_error(ret.back())) return ret.back();
+    while(kind() == TokenKind::Comma) {
         advance();
         ret.push_back(expr(tab_expect));
-        if(ret.back()->get_type() == NODE_ERROR) return ret.back();
-    }
-    if(current_tok->get_type() != TOKEN_RIGHT_BRACE) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \"}\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
+        if(is_error(ret.back())) return ret.back();
     }
+    if(kind() != TokenKind::RightBrace)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \"}\"\n" RESET);
     advance();
-    return std::make_shared<ArrayNode>(ret);
+    return arena.make<ArrayNode>(ret);
 }
 
 std::shared_ptr<Node> Parser::if_expr(int tab_expect) {
     std::shared_ptr<Node> condition = expr(tab_expect);
-    if(condition->get_type() == NODE_ERROR) return condition;
-    if(!(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "then")) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"then\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(is_error(condition)) return condition;
+    if(kind() != TokenKind::Then)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"then\"\n" RESET);
     advance();
     NodeList exp;
-    if(current_tok->get_type() == TOKEN_NEWLINE)
+    if(kind() == TokenKind::Newline)
         exp = statement(tab_expect + 1);
     else
         exp = NodeList{expr(tab_expect)};
     for(auto node : exp)
-        if(node->get_type() == NODE_ERROR) return node;
+        if(is_error(node)) return node;
+    // An else on a line of its own lines up with its if, any other line is
+    // left to the enclosing statement list.
+    if(kind() == TokenKind::Newline && indentation() == tab_expect && kind(tab_expect + 1) == TokenKind::Else)
+        index += tab_expect + 1;
     NodeList els;
-    bool has_newline = false;
-    if(current_tok->get_type() == TOKEN_NEWLINE) {
+    if(kind() == TokenKind::Else) {
         advance();
-        for(int i{0}; i < tab_expect; ++i) {
-            advance();
-        }
-        has_newline = true;
-    }
-    if(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "else") {
-        advance();
-        if(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "if") {
+        if(kind() == TokenKind::If) {
             advance();
             els = NodeList{if_expr(tab_expect)};
         } else {
             els = statement(tab_expect + 1);
         }
-    } else if(has_newline) {
-        std::cout << "Before checking" << "\n";
-        while(current_tok->get_type() != TOKEN_NEWLINE) {
-            std::cout << current_tok->get_type() << "\n";
-            back();
-        }
     }
-    return std::make_shared<IfNode>(condition, exp, els);
+    return arena.make<IfNode>(condition, exp, els);
 }
 
 std::shared_ptr<Node> Parser::for_expr(int tab_expect) {
-    std::shared_ptr<Token> var_name = current_tok;
-    if(current_tok->get_type() != TOKEN_IDENTIFIER) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"an identifier\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(kind() != TokenKind::Identifier)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"an identifier\"\n" RESET);
+    std::string var_name{stream.text(peek())};
     advance();
-    if(current_tok->get_type() != TOKEN_ASSIGN) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"<-\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(kind() != TokenKind::Assign)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"<-\"\n" RESET);
     advance();
     std::shared_ptr<Node> start_value = expr(tab_expect);
-    if(start_value->get_type() == NODE_ERROR) return start_value;
-    std::shared_ptr<Node> var_assign = std::make_shared<VarAssignNode>(var_name->get_value(), start_value);
-    
-    if(!(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "to")) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"to\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(is_error(start_value)) return start_value;
+    std::shared_ptr<Node> var_assign = arena.make<VarAssignNode>(var_name, start_value);
+
+    if(kind() != TokenKind::To)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"to\"\n" RESET);
     advance();
     std::shared_ptr<Node> end_value = expr(tab_expect);
-    if(end_value->get_type() == NODE_ERROR) return end_value;
+    if(is_error(end_value)) return end_value;
 
     std::shared_ptr<Node> step_value = nullptr;
-    if(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "step") {
+    if(kind() == TokenKind::Step) {
         advance();
         step_value = expr(tab_expect);
-        if(step_value->get_type() == NODE_ERROR) return step_value;
-    }
-    if(!(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "do")) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"do\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
+        if(is_error(step_value)) return step_value;
     }
+    if(kind() != TokenKind::Do)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"do\"\n" RESET);
     advance();
     NodeList body_node = statement(tab_expect + 1);
     for(auto node : body_node)
-        if(node->get_type() == NODE_ERROR) return node;
-    return std::make_shared<ForNode>(var_assign, end_value, step_value, body_node);
+        if(is_error(node)) return node;
+    return arena.make<ForNode>(var_assign, end_value, step_value, body_node);
 }
 
 std::shared_ptr<Node> Parser::while_expr(int tab_expect) {
     std::shared_ptr<Node> condition = expr(tab_expect);
-    if(condition->get_type() == NODE_ERROR) return condition;
-    if(!(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "do")) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"do\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(is_error(condition)) return condition;
+    if(kind() != TokenKind::Do)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"do\"\n" RESET);
     advance();
     NodeList body_node = statement(tab_expect + 1);
     for(auto node : body_node)
-        if(node->get_type() == NODE_ERROR) return node;
-    return std::make_shared<WhileNode>(condition, body_node);
+        if(is_error(node)) return node;
+    return arena.make<WhileNode>(condition, body_node);
 }
 
 std::shared_ptr<Node> Parser::repeat_expr(int tab_expect) {
     NodeList body_node = statement(tab_expect + 1);
     for(auto node : body_node)
-        if(node->get_type() == NODE_ERROR) return node;
-    if(!(current_tok->get_type() == TOKEN_KEYWORD && current_tok->get_value() == "until")) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected \"until\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+        if(is_error(node)) return node;
+    if(kind() != TokenKind::Until)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected \"until\"\n" RESET);
     advance();
     std::shared_ptr<Node> condition = expr(tab_expect);
-    if(condition->get_type() == NODE_ERROR) return condition;
-    return std::make_shared<RepeatNode>(body_node, condition);
+    if(is_error(condition)) return condition;
+    return arena.make<RepeatNode>(body_node, condition);
 }
 
-std::shared_ptr<Node> Parser::algo_def(int tab_expect) {
-    std::shared_ptr<Token> algo_name = current_tok;
-    if(current_tok->get_type() == TOKEN_IDENTIFIER) {
+std::shared_ptr<Node> Parser::algo_def(int tab_expect, bool memo) {
+    std::shared_ptr<Token> algo_name;
+    if(kind() == TokenKind::Identifier) {
+        algo_name = token();
         advance();
-        if(current_tok->get_type() != TOKEN_LEFT_PAREN) {
-            std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \"(\"\n" RESET;
-            std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-            return std::make_shared<ErrorNode>(error_token);
-        }
-    } else if(current_tok->get_type() != TOKEN_LEFT_PAREN) {
-        algo_name = std::make_shared<TypedToken<std::string>>(TOKEN_IDENTIFIER, current_tok->get_pos(), "Anonymous");
+        if(kind() != TokenKind::LeftParen)
+            return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \"(\"\n" RESET);
+    } else if(kind() != TokenKind::LeftParen) {
+        algo_name = std::make_shared<TypedToken<std::string>>(TokenKind::Identifier, position(), "Anonymous");
     } else {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected an \"identifier\" or \"(\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected an \"identifier\" or \"(\"\n" RESET);
     }
     advance();
     TokenList args_name;
-    if(current_tok->get_type() == TOKEN_IDENTIFIER) {
-        args_name.push_back(current_tok);
+    if(kind() == TokenKind::Identifier) {
+        args_name.push_back(token());
         advance();
-        while(current_tok->get_type() == TOKEN_COMMA) {
+        while(kind() == TokenKind::Comma) {
             advance();
-            if(current_tok->get_type() != TOKEN_IDENTIFIER) {
-                std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected an \"identifier\" or a \"(\"\n" RESET;
-                std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-                return std::make_shared<ErrorNode>(error_token);
-            }
-            args_name.push_back(current_tok);
+            if(kind() != TokenKind::Identifier)
+                return error(Color(0xFF, 0x39, 0x6E).get() + "Expected an \"identifier\" or a \"(\"\n" RESET);
+            args_name.push_back(token());
             advance();
         }
     }
 
-    if(current_tok->get_type() != TOKEN_RIGHT_PAREN) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \")\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(kind() != TokenKind::RightParen)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \")\"\n" RESET);
     advance();
-    if(current_tok->get_type() != TOKEN_COLON) {
-        std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \":\"\n" RESET;
-        std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-        return std::make_shared<ErrorNode>(error_token);
-    }
+    if(kind() != TokenKind::Colon)
+        return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \":\"\n" RESET);
     advance();
     NodeList body_node = statement(tab_expect + 1);
     for(auto node : body_node)
-        if(node->get_type() == NODE_ERROR) return node;
-    return std::make_shared<AlgorithmDefNode>(algo_name, args_name, body_node);
+        if(is_error(node)) return node;
+    return arena.make<AlgorithmDefNode>(algo_name, args_name, body_node, memo);
 }
 
+// `^` binds tighter than a sign on its left, but takes one on its right.
 std::shared_ptr<Node> Parser::pow(int tab_expect) {
-    return bin_op(
-        tab_expect,
-        std::bind(&Parser::call, this, tab_expect), 
-        {TOKEN_POW}, std::bind(&Parser::factor, this, tab_expect));
+    std::shared_ptr<Node> left{call(tab_expect)};
+    if(is_error(left)) return left;
+    while(kind() == TokenKind::Pow) {
+        std::shared_ptr<Token> op_tok{token()};
+        advance();
+        std::shared_ptr<Node> right{factor(tab_expect)};
+        if(is_error(right)) return right;
+        left = arena.make<BinOpNode>(left, right, op_tok);
+    }
+    return left;
 }
 
 std::shared_ptr<Node> Parser::call(int tab_expect) {
     std::shared_ptr<Node> at{atom(tab_expect)};
-    if(at->get_type() == NODE_ERROR) return at;
-    if(current_tok->get_type() != TOKEN_LEFT_PAREN && current_tok->get_type() != TOKEN_LEFT_SQUARE) {
+    if(is_error(at)) return at;
+    if(kind() != TokenKind::LeftParen && kind() != TokenKind::LeftSquare)
         return at;
-    }
-    std::shared_ptr<Node> ret;
-    while(current_tok->get_type() == TOKEN_LEFT_PAREN || current_tok->get_type() == TOKEN_LEFT_SQUARE) {
-        while(current_tok->get_type() == TOKEN_LEFT_PAREN) {
+    while(kind() == TokenKind::LeftParen || kind() == TokenKind::LeftSquare) {
+        if(kind() == TokenKind::LeftParen) {
             advance();
             NodeList args;
-            if(current_tok->get_type() != TOKEN_RIGHT_PAREN)  {
+            if(kind() != TokenKind::RightParen) {
                 args.push_back(expr(tab_expect));
-                if(args.back()->get_type() == NODE_ERROR) return args.back();
-                while(current_tok->get_type() == TOKEN_COMMA) {
+                if(is_error(args.back())) return args.back();
+                while(kind() == TokenKind::Comma) {
                     advance();
                     args.push_back(expr(tab_expect));
-                    if(args.back()->get_type() == NODE_ERROR) return args.back();
-                }
-                if(current_tok->get_type() != TOKEN_RIGHT_PAREN) {
-                    std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \")\"\n" RESET;
-                    std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-                    return std::make_shared<ErrorNode>(error_token);
+                    if(is_error(args.back())) return args.back();
                 }
+                if(kind() != TokenKind::RightParen)
+                    return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \")\"\n" RESET);
             }
             advance();
-            ret = std::make_shared<AlgorithmCallNode>(at, args);
-            at = ret;
-        }
-        while(current_tok->get_type() == TOKEN_LEFT_SQUARE) {
+            at = arena.make<AlgorithmCallNode>(at, args);
+        } else {
             advance();
-            std::shared_ptr<Node> index{expr(tab_expect)};
-            if(index->get_type() == NODE_ERROR) return index;
-            if(current_tok->get_type() != TOKEN_RIGHT_SQUARE) {
-                std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected a \"]\"" RESET "\n";
-                std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, current_tok->get_pos(), error_msg);
-                return std::make_shared<ErrorNode>(error_token);
-            }
+            std::shared_ptr<Node> index_node{expr(tab_expect)};
+            if(is_error(index_node)) return index_node;
+            if(kind() != TokenKind::RightSquare)
+                return error(Color(0xFF, 0x39, 0x6E).get() + "Expected a \"]\"" RESET "\n");
             advance();
-            ret = std::make_shared<ArrayAccessNode>(at, index);
-            at = ret;
+            at = arena.make<ArrayAccessNode>(at, index_node);
         }
     }
-    if(current_tok->get_type() == TOKEN_ASSIGN) {
+    if(kind() == TokenKind::Assign) {
         advance();
         std::shared_ptr<Node> val = expr(tab_expect);
-        if(val->get_type() == NODE_ERROR) return val;
-        return std::make_shared<ArrayAssignNode>(ret, val);
-    }
-    return ret;
-}
-
-std::shared_ptr<Node> Parser::bin_op(
-    int tab_expect,
-    std::function<std::shared_ptr<Node>(int tab_expect)> lfunc, 
-    std::vector<std::string> allowed_types, 
-    std::function<std::shared_ptr<Node>(int tab_expect)> rfunc
-) {
-    std::shared_ptr<Node> left = lfunc(tab_expect);
-    if(left->get_type() == NODE_ERROR) 
-        return left;
-    while(
-        std::find(allowed_types.begin(), allowed_types.end(), current_tok->get_type()) != allowed_types.end() ||
-        std::find(allowed_types.begin(), allowed_types.end(), current_tok->get_value()) != allowed_types.end()
-    ) {
-        std::shared_ptr<Token> op_tok = current_tok;
-        advance();
-        std::shared_ptr<Node> right = rfunc(tab_expect);
-        if(right->get_type() == NODE_ERROR) 
-            return right;
-        left = std::make_shared<BinOpNode>(left, right, op_tok);
+        if(is_error(val)) return val;
+        return arena.make<ArrayAssignNode>(at, val);
     }
-    return left;
+    return at;
 }
 
+// A line indented less than tab_expect ends the list, its newline is left
+// for the enclosing one. The first node that fails ends it too.
 NodeList Parser::statement(int tab_expect) {
     NodeList ret;
     do {
-        while(current_tok->get_type() == TOKEN_NEWLINE) {
-            std::shared_ptr<Token> tok = current_tok;
-            advance();
-            for(int i{0}; i < tab_expect; ++i) {
-                if(current_tok->get_type() != TOKEN_TAB) {
-                    while(current_tok->get_type() != TOKEN_NEWLINE) {
-                        back();
-                    }
-                    return ret;
-                }
-                advance();
-            }
-                
-            if(current_tok->get_type() == TOKEN_TAB) {
+        while(kind() == TokenKind::Newline) {
+            int tabs{indentation()};
+            if(tabs < tab_expect)
+                return ret;
+            if(tabs > tab_expect) {
                 std::string error_msg = Color(0xFF, 0x39, 0x6E).get() + "Expected " + std::to_string(tab_expect) + " tabs" RESET "\n";
-                std::shared_ptr<Token> error_token = std::make_shared<ErrorToken>(TOKEN_ERROR, tok->get_pos(), error_msg);
                 ret.clear();
-                ret.push_back(std::make_shared<ErrorNode>(error_token));
+                ret.push_back(error(error_msg));
                 return ret;
             }
+            index += tabs + 1;
         }
-        while(current_tok->get_type() == TOKEN_SEMICOLON)
+        while(kind() == TokenKind::Semicolon)
             advance();
-        if(current_tok->get_type() != TOKEN_NONE)
+        if(kind() != TokenKind::None) {
             ret.push_back(expr(tab_expect));
-    } while(current_tok->get_type() == TOKEN_NEWLINE || current_tok->get_type() == TOKEN_SEMICOLON);
+            if(is_error(ret.back())) return ret;
+        }
+    } while(kind() == TokenKind::Newline || kind() == TokenKind::Semicolon);
     return ret;
 }
 
 NodeList Parser::parse() {
+    arena.activate();
     NodeList ret = statement(0);
+    NodeArena::deactivate();
     return ret;
 }
\ No newline at end of file
@@ -7,41 +7,50 @@
 
 #include <string>
 #include <memory>
-#include <functional>
 #include "node.h"
 #include "token.h"
 
+// Binding power of the binary operators, higher binds tighter. `^` is
+// parsed on its own, its right side is a signed factor.
+enum Precedence : int {
+    PREC_NONE, PREC_LOGICAL, PREC_COMPARE, PREC_SUM, PREC_PRODUCT
+};
+
+/// Builds the NodeList of a TokenStream, reading each lexeme once. Tokens
+/// are only made for the lexemes a node keeps. Blocks end, and an `else`
+/// is found, by looking at the indentation after a newline, never by going
+/// back. The nodes are made in the arena of the parse.
 class Parser {
 public:
-    Parser(const TokenList& _tokens)
-        : tokens(_tokens), tok_index(-1) { advance();}
-    std::shared_ptr<Token> advance();
-    std::shared_ptr<Token> back();
+    Parser(const TokenStream &_stream)
+        : stream(_stream), lexemes(_stream.get_lexemes()), index(0) {}
+    NodeList parse();
+protected:
+    std::shared_ptr<Node> expr(int tab_expect, int min_precedence = PREC_LOGICAL);
     std::shared_ptr<Node> factor(int tab_expect);
-    std::shared_ptr<Node> term(int tab_expect);
-    std::shared_ptr<Node> expr(int tab_expect);
-    std::shared_ptr<Node> arith_expr(int tab_expect);
-    std::shared_ptr<Node> comp_expr(int tab_expect);
+    std::shared_ptr<Node> pow(int tab_expect);
+    std::shared_ptr<Node> call(int tab_expect);
+    std::shared_ptr<Node> atom(int tab_expect);
     std::shared_ptr<Node> array_expr(int tab_expect);
     std::shared_ptr<Node> if_expr(int tab_expect);
     std::shared_ptr<Node> for_expr(int tab_expect);
     std::shared_ptr<Node> while_expr(int tab_expect);
     std::shared_ptr<Node> repeat_expr(int tab_expect);
-    std::shared_ptr<Node> pow(int tab_expect);
-    std::shared_ptr<Node> atom(int tab_expect);
-    std::shared_ptr<Node> call(int tab_expect);
-    std::shared_ptr<Node> algo_def(int tab_expect);
+    std::shared_ptr<Node> algo_def(int tab_expect, bool memo = false);
     NodeList statement(int tab_expect);
-    
-    std::shared_ptr<Node> bin_op(
-        int tab_expect,
-        std::function<std::shared_ptr<Node>(int)>, 
-        std::vector<std::string>, std::function<std::shared_ptr<Node>(int)>);
-    NodeList parse();
-protected:
-    TokenList tokens;
-    std::shared_ptr<Token> current_tok;
-    int64_t tok_index;
+
+    const Lexeme& peek(size_t ahead = 0) const;
+    TokenKind kind(size_t ahead = 0) const { return peek(ahead).kind;}
+    void advance() { index++;}
+    int indentation() const;
+    std::shared_ptr<Token> token() const;
+    Position position() const;
+    std::shared_ptr<Node> error(const std::string &message);
+
+    const TokenStream &stream;
+    const std::vector<Lexeme> &lexemes;
+    size_t index;
+    NodeArena arena;
 };
 
 #endif
\ No newline at end of file
@@ -6,14 +6,32 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-void Position::advance(char current_char) {
-    index++;
-    column++;
-    if(current_char == '\n') {
-        line++;
-        column = 0;
-    }
+static std::vector<std::string>& file_names() {
+    static std::vector<std::string> names{""};
+    return names;
+}
+
+// The same name always gets the same index, so the shell, which lexes each
+// line on its own, does not grow the table.
+uint16_t register_file(const std::string &file_name) {
+    static std::unordered_map<std::string, uint16_t> indices;
+    auto it = indices.find(file_name);
+    if(it != indices.end())
+        return it->second;
+    // Past the last index, further files share the unnamed one.
+    if(indices.size() + 1 > UINT16_MAX)
+        return 0;
+    uint16_t file(indices.size() + 1);
+    indices.emplace(file_name, file);
+    file_names().push_back(file_name);
+    return file;
+}
+
+const std::string& file_name_of(uint16_t file) {
+    return file_names()[file];
 }
 
 std::string Position::get_pos() {
@@ -25,6 +43,6 @@ std::string Position::get_pos() {
 }
 
 std::ostream& operator<<(std::ostream &out, Position &pos) {
-    out << "File: " << pos.file_name << ", Line: " << pos.line << ", Column: " << pos.column;
+    out << "File: " << file_name_of(pos.file) << ", Line: " << pos.line << ", Column: " << pos.column;
     return out;
 }
\ No newline at end of file
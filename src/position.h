@@ -5,14 +5,19 @@
 #ifndef POSITION_H
 #define POSITION_H
 
+#include <cstdint>
 #include <string>
 
+// Names of the lexed files. Positions keep only the index of theirs, 0 is
+// the unnamed file of positions made without a source.
+uint16_t register_file(const std::string &file_name);
+const std::string& file_name_of(uint16_t file);
+
 struct Position {
     int index, line, column;
-    std::string file_name;
-    Position(int idx = 0, int ln = 0, int col = 0, const std::string& _file_name = "")
-        : index(idx), line(ln), column(col), file_name(_file_name) {}
-    void advance(char);
+    uint16_t file;
+    Position(int idx = 0, int ln = 0, int col = 0, uint16_t _file = 0)
+        : index(idx), line(ln), column(col), file(_file) {}
     std::string get_pos();
     friend std::ostream& operator<<(std::ostream &out, Position &pos);
 };
@@ -2,20 +2,131 @@
 #include "pseudo.h"
 #include "node.h"
 #include "color.h"
+#include "memo.h"
+#include "kernels.h"
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <cmath>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <functional>
 
 /// --------------------
 /// Value
 /// --------------------
 
+// Compares against literals rather than the VALUE_* constants, those may not
+// be constructed yet when the builtin table is initialized.
+ValueKind to_value_kind(const std::string &type) {
+    if(type == "Int") return ValueKind::Int;
+    if(type == "Float") return ValueKind::Float;
+    if(type == "Str") return ValueKind::Str;
+    if(type == "Array") return ValueKind::Array;
+    if(type == "Map") return ValueKind::Map;
+    if(type == "Set") return ValueKind::Set;
+    if(type == "Heap") return ValueKind::Heap;
+    if(type == "Deque") return ValueKind::Deque;
+    if(type == "Algo") return ValueKind::Algo;
+    if(type == "ERROR") return ValueKind::Error;
+    return ValueKind::None;
+}
+
+const std::string& value_type_name(ValueKind kind) {
+    switch(kind) {
+        case ValueKind::Int: return VALUE_INT;
+        case ValueKind::Float: return VALUE_FLOAT;
+        case ValueKind::Algo: return VALUE_ALGO;
+        case ValueKind::Str: return VALUE_STRING;
+        case ValueKind::Error: return VALUE_ERROR;
+        case ValueKind::Array: return VALUE_ARRAY;
+        case ValueKind::Map: return VALUE_MAP;
+        case ValueKind::Set: return VALUE_SET;
+        case ValueKind::Heap: return VALUE_HEAP;
+        case ValueKind::Deque: return VALUE_DEQUE;
+        default: return VALUE_NONE;
+    }
+}
+
+// Powers of ten up to 10^22 are exact as doubles, and so as long doubles.
+static constexpr double POWERS_OF_TEN[]{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Whether scaled is magnitude times 10^k with no rounding.
+static bool exact_scaling(long double magnitude, long double scaled, int k) {
+    if(k >= 0)
+        return std::fma(magnitude, static_cast<long double>(POWERS_OF_TEN[k]), -scaled) == 0;
+    return std::fma(scaled, static_cast<long double>(POWERS_OF_TEN[-k]), -magnitude) == 0;
+}
+
+// The six digits are x scaled by 10^k and rounded, in long double, which
+// is off by less than 10^6 * 2^-64. Unless that lands closer to a tie and
+// is not exact, so that the error could flip it, the digits are the
+// printed ones, and one exact power of ten takes them back to the double
+// the text reads as. Anything else goes through the text.
+double six_digits(double x) {
+    if(x == 0 || !std::isfinite(x))
+        return x;
+    long double magnitude{std::fabs(x)};
+    // 2^e <= |x| < 2^(e + 1), so the first guess is at most one short.
+    int k{5 - static_cast<int>(std::floor(std::ilogb(x) * 0.30102999566398120))};
+    for(int tries{0}; tries < 3 && k >= -22 && k <= 22; ++tries) {
+        long double scaled{k >= 0 ? magnitude * POWERS_OF_TEN[k] : magnitude / POWERS_OF_TEN[-k]};
+        if(scaled >= 1e6L) {
+            --k;
+            continue;
+        }
+        if(scaled < 1e5L) {
+            ++k;
+            continue;
+        }
+        long double fraction{scaled - std::floor(scaled)};
+        if(std::fabs(fraction - 0.5L) < 1e-13L && !exact_scaling(magnitude, scaled, k))
+            break;
+        double digits{static_cast<double>(std::rint(scaled))};
+        return std::copysign(k >= 0 ? digits / POWERS_OF_TEN[k] : digits * POWERS_OF_TEN[-k], x);
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%g", x);
+    return std::strtod(text, nullptr);
+}
+
 std::ostream& operator<<(std::ostream &out, Value &number) {
     out << number.get_num();
     return out;
 }
 
+std::string TaggedValue::get_num() const {
+    switch(kind) {
+        case ValueKind::Undefined:
+        case ValueKind::None: return VALUE_NONE;
+        case ValueKind::Int: return std::to_string(int_value);
+        case ValueKind::Float: {
+            std::stringstream ss;
+            ss << float_value;
+            return ss.str();
+        }
+        default: return object->get_num();
+    }
+}
+
+std::string TaggedValue::repr() const {
+    if(is_boxed()) return object->repr();
+    return get_num();
+}
+
+TaggedValue TaggedValue::execute(const NodeList &args, SymbolTable *parent) const {
+    if(!is_boxed()) return TaggedValue();
+    return object->execute(args, parent);
+}
+
 template<typename T>
 std::string TypedValue<T>::get_num() {
     std::stringstream ss;
@@ -54,12 +165,45 @@ std::string TypedValue<T>::repr() {
     return ret;
 }
 
+// An empty array starts packed as Ints, its first element picks the layout.
+ArrayValue::ArrayValue(ValueList _value)
+    : Value(VALUE_ARRAY), layout(ArrayLayout::Int) {
+    ValueKind kind{_value.empty() ? ValueKind::Int : _value[0].get_kind()};
+    for(auto &element : _value) {
+        if(element.get_kind() != kind) {
+            kind = ValueKind::None;
+            break;
+        }
+    }
+    if(kind == ValueKind::Int) {
+        ints.reserve(_value.size());
+        for(auto &element : _value)
+            ints.push_back(element.get_int());
+    } else if(kind == ValueKind::Float) {
+        layout = ArrayLayout::Float;
+        floats.reserve(_value.size());
+        for(auto &element : _value)
+            floats.push_back(element.get_float());
+    } else {
+        layout = ArrayLayout::Boxed;
+        value = std::move(_value);
+    }
+}
+
+ArrayValue::ArrayValue(std::vector<int64_t> _ints)
+    : Value(VALUE_ARRAY), layout(ArrayLayout::Int), ints(std::move(_ints)) {}
+
+// An empty array keeps the Int layout, as it does everywhere else.
+ArrayValue::ArrayValue(std::vector<double> _floats)
+    : Value(VALUE_ARRAY), layout(_floats.empty() ? ArrayLayout::Int : ArrayLayout::Float),
+    floats(std::move(_floats)) {}
+
 std::string ArrayValue::get_num() {
     std::stringstream ss;
     ss << "{";
-    if(!value.empty()) ss << value[0]->repr();
-    for(int i{1}; i < value.size(); ++i) {
-        ss << ", " << value[i]->repr();
+    for(size_t i{1}; i <= size(); ++i) {
+        if(i > 1) ss << ", ";
+        ss << get(i).repr();
     }
     ss << "}";
     std::string ret;
@@ -67,350 +211,1823 @@ std::string ArrayValue::get_num() {
     return ret;
 }
 
-void ArrayValue::push_back(std::shared_ptr<Value> new_value) {
-    value.push_back(new_value);
+void ArrayValue::push_back(TaggedValue new_value) {
+    if(size() == 0 && layout != ArrayLayout::Boxed) {
+        if(new_value.get_kind() == ValueKind::Int)
+            layout = ArrayLayout::Int;
+        else if(new_value.get_kind() == ValueKind::Float)
+            layout = ArrayLayout::Float;
+    }
+    if(layout == ArrayLayout::Int && new_value.get_kind() == ValueKind::Int) {
+        ints.push_back(new_value.get_int());
+    } else if(layout == ArrayLayout::Float && new_value.get_kind() == ValueKind::Float) {
+        floats.push_back(new_value.get_float());
+    } else {
+        box();
+        value.push_back(std::move(new_value));
+    }
+}
+
+void ArrayValue::fill(const TaggedValue &element, size_t count) {
+    if(count == 0)
+        return;
+    if(size() == 0 && layout != ArrayLayout::Boxed) {
+        if(element.get_kind() == ValueKind::Int)
+            layout = ArrayLayout::Int;
+        else if(element.get_kind() == ValueKind::Float)
+            layout = ArrayLayout::Float;
+    }
+    if(layout == ArrayLayout::Int && element.get_kind() == ValueKind::Int) {
+        ints.insert(ints.end(), count, element.get_int());
+    } else if(layout == ArrayLayout::Float && element.get_kind() == ValueKind::Float) {
+        floats.insert(floats.end(), count, element.get_float());
+    } else {
+        box();
+        value.insert(value.end(), count, element);
+    }
+}
+
+TaggedValue ArrayValue::copy() const {
+    TaggedValue ret{make_boxed<ArrayValue>(ValueList())};
+    ArrayValue *array{ret.as<ArrayValue>()};
+    array->layout = layout;
+    array->ints = ints;
+    array->floats = floats;
+    array->value = value;
+    return ret;
+}
+
+TaggedValue ArrayValue::pop_back() {
+    if(size() == 0)
+        return make_error("Pop a empty array");
+    TaggedValue ret{back()};
+    switch(layout) {
+        case ArrayLayout::Int: ints.pop_back(); break;
+        case ArrayLayout::Float: floats.pop_back(); break;
+        default: value.pop_back(); break;
+    }
+    return ret;
+}
+
+// Bottom up merge sort through a buffer, with runs of 16 insertion sorted
+// first. Every loop is bounded by positions, never by what less answers,
+// so a less that is not a strict order, or changes its mind, only gives a
+// strange order.
+template<typename T, typename Less>
+static void merge_sort(std::vector<T> &elements, Less less) {
+    const size_t RUN{16};
+    size_t n{elements.size()};
+    for(size_t start{0}; start < n; start += RUN) {
+        size_t end{std::min(start + RUN, n)};
+        for(size_t i{start + 1}; i < end; ++i) {
+            for(size_t j{i}; j > start && less(elements[j], elements[j - 1]); --j)
+                std::swap(elements[j], elements[j - 1]);
+        }
+    }
+    std::vector<T> buffer(n);
+    for(size_t width{RUN}; width < n; width *= 2) {
+        for(size_t left{0}; left < n; left += 2 * width) {
+            size_t middle{std::min(left + width, n)}, right{std::min(left + 2 * width, n)};
+            size_t i{left}, j{middle}, k{left};
+            while(i < middle && j < right)
+                buffer[k++] = less(elements[j], elements[i]) ? std::move(elements[j++]) : std::move(elements[i++]);
+            while(i < middle)
+                buffer[k++] = std::move(elements[i++]);
+            while(j < right)
+                buffer[k++] = std::move(elements[j++]);
+        }
+        elements.swap(buffer);
+    }
+}
+
+// Elements are ordered by kind first: numbers, then strings, then arrays,
+// then anything else. Only numbers meet numbers and strings meet strings
+// in the operators, which would otherwise read a string as a number.
+static int kind_rank(const TaggedValue &a) {
+    switch(a.get_kind()) {
+        case ValueKind::Int:
+        case ValueKind::Float:
+            return 0;
+        case ValueKind::Str:
+            return 1;
+        case ValueKind::Array:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+// `<` and `=` between elements, an error counts as false. Arrays are
+// compared element by element, the first pair that differs decides and
+// a shorter array goes first.
+static bool is_less(const TaggedValue &a, const TaggedValue &b) {
+    int a_rank{kind_rank(a)}, b_rank{kind_rank(b)};
+    if(a_rank != b_rank)
+        return a_rank < b_rank;
+    if(a_rank == 2) {
+        const ArrayValue *x{a.as<ArrayValue>()}, *y{b.as<ArrayValue>()};
+        for(int64_t p{1}; p <= static_cast<int64_t>(x->size()) && p <= static_cast<int64_t>(y->size()); ++p) {
+            TaggedValue x_element{x->get(p)}, y_element{y->get(p)};
+            if(is_less(x_element, y_element))
+                return true;
+            if(is_less(y_element, x_element))
+                return false;
+        }
+        return x->size() < y->size();
+    }
+    if(a_rank == 3)
+        return false;
+    TaggedValue less{a < b};
+    return !less.is_error() && is_truthy(less);
+}
+
+static bool is_equal(const TaggedValue &a, const TaggedValue &b) {
+    if(kind_rank(a) != kind_rank(b))
+        return false;
+    TaggedValue equal{a == b};
+    return !equal.is_error() && is_truthy(equal);
+}
+
+// NaN is not less than anything, sort() puts it after every other element.
+static bool is_nan(const TaggedValue &a) {
+    return a.get_kind() == ValueKind::Float && std::isnan(a.get_float());
+}
+
+void ArrayValue::sort() {
+    switch(layout) {
+        case ArrayLayout::Int:
+            std::sort(ints.begin(), ints.end());
+            break;
+        case ArrayLayout::Float: {
+            auto numbers_end{std::partition(floats.begin(), floats.end(), [](double x) { return !std::isnan(x);})};
+            std::sort(floats.begin(), numbers_end);
+            break;
+        }
+        default:
+            merge_sort(value, [](const TaggedValue &a, const TaggedValue &b) {
+                return !is_nan(a) && (is_nan(b) || is_less(a, b));
+            });
+            break;
+    }
+}
+
+// The elements are sorted in a copy, the Algorithm may read or change the
+// array meanwhile. The pair of arguments is reused for every call.
+TaggedValue ArrayValue::sort(BaseAlgoValue *before, SymbolTable *parent) {
+    TaggedValue error, args[2];
+    auto goes_before = [&](const TaggedValue &a, const TaggedValue &b) {
+        if(error.is_error())
+            return false;
+        args[0] = a;
+        args[1] = b;
+        TaggedValue result{before->call(ValueSpan{args, 2}, parent)};
+        if(result.get_kind() == ValueKind::Int)
+            return result.get_int() != 0;
+        if(result.get_kind() == ValueKind::Float)
+            return result.get_float() != 0;
+        error = result.is_error() ? result
+            : make_error("sort expects the Algorithm to give a number, find " + result.get_type() + "\n");
+        return false;
+    };
+    ArrayLayout sorted_layout{layout};
+    std::vector<int64_t> sorted_ints;
+    std::vector<double> sorted_floats;
+    ValueList sorted_value;
+    switch(layout) {
+        case ArrayLayout::Int:
+            sorted_ints = ints;
+            merge_sort(sorted_ints, [&](int64_t a, int64_t b) { return goes_before(make_int(a), make_int(b));});
+            break;
+        case ArrayLayout::Float:
+            sorted_floats = floats;
+            merge_sort(sorted_floats, [&](double a, double b) { return goes_before(make_float(a), make_float(b));});
+            break;
+        default:
+            sorted_value = value;
+            merge_sort(sorted_value, goes_before);
+            break;
+    }
+    if(error.is_error())
+        return error;
+    layout = sorted_layout;
+    ints = std::move(sorted_ints);
+    floats = std::move(sorted_floats);
+    value = std::move(sorted_value);
+    return TaggedValue();
+}
+
+void ArrayValue::reverse() {
+    switch(layout) {
+        case ArrayLayout::Int: std::reverse(ints.begin(), ints.end()); break;
+        case ArrayLayout::Float: std::reverse(floats.begin(), floats.end()); break;
+        default: std::reverse(value.begin(), value.end()); break;
+    }
+}
+
+void ArrayValue::unique() {
+    switch(layout) {
+        case ArrayLayout::Int:
+            ints.erase(std::unique(ints.begin(), ints.end()), ints.end());
+            break;
+        case ArrayLayout::Float:
+            floats.erase(std::unique(floats.begin(), floats.end()), floats.end());
+            break;
+        default:
+            value.erase(std::unique(value.begin(), value.end(), is_equal), value.end());
+            break;
+    }
+}
+
+// A packed array against a number compares as the operators do, an Int
+// with a Float as two doubles.
+template<typename T, typename X>
+static int64_t packed_bound(const std::vector<T> &elements, X x, bool upper) {
+    auto found{upper
+        ? std::upper_bound(elements.begin(), elements.end(), x, [](X a, T b) { return a < b;})
+        : std::lower_bound(elements.begin(), elements.end(), x, [](T a, X b) { return a < b;})};
+    return found - elements.begin() + 1;
+}
+
+int64_t ArrayValue::lower_bound(const TaggedValue &x) const {
+    if(layout != ArrayLayout::Boxed && x.get_kind() == ValueKind::Int)
+        return layout == ArrayLayout::Int ? packed_bound(ints, x.get_int(), false) : packed_bound(floats, x.get_int(), false);
+    if(layout != ArrayLayout::Boxed && x.get_kind() == ValueKind::Float)
+        return layout == ArrayLayout::Int ? packed_bound(ints, x.get_float(), false) : packed_bound(floats, x.get_float(), false);
+    int64_t low{1}, high{static_cast<int64_t>(size()) + 1};
+    while(low < high) {
+        int64_t middle{low + (high - low) / 2};
+        if(is_less(get(middle), x))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int64_t ArrayValue::upper_bound(const TaggedValue &x) const {
+    if(layout != ArrayLayout::Boxed && x.get_kind() == ValueKind::Int)
+        return layout == ArrayLayout::Int ? packed_bound(ints, x.get_int(), true) : packed_bound(floats, x.get_int(), true);
+    if(layout != ArrayLayout::Boxed && x.get_kind() == ValueKind::Float)
+        return layout == ArrayLayout::Int ? packed_bound(ints, x.get_float(), true) : packed_bound(floats, x.get_float(), true);
+    int64_t low{1}, high{static_cast<int64_t>(size()) + 1};
+    while(low < high) {
+        int64_t middle{low + (high - low) / 2};
+        if(is_less(x, get(middle)))
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+TaggedValue ArrayValue::out_of_range(int64_t p) const {
+    return make_error(
+        "Index out of range, size: " + std::to_string(size()) + ", position: " + std::to_string(p));
+}
+
+void ArrayValue::box() {
+    if(layout == ArrayLayout::Boxed)
+        return;
+    value.reserve(size());
+    for(int64_t element : ints)
+        value.push_back(make_int(element));
+    for(double element : floats)
+        value.push_back(make_float(element));
+    ints = std::vector<int64_t>();
+    floats = std::vector<double>();
+    layout = ArrayLayout::Boxed;
+}
+
+// splitmix64's finalizer, so that keys next to each other spread over the
+// slots.
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Whether a Float is a whole number in the range of Ints, and which.
+static bool whole_float(double x, int64_t &whole) {
+    if(!(x >= -9223372036854775808.0 && x < 9223372036854775808.0) || x != std::trunc(x))
+        return false;
+    whole = static_cast<int64_t>(x);
+    return true;
+}
+
+bool HashTable::is_key(const TaggedValue &key) {
+    ValueKind kind{key.get_kind()};
+    return kind == ValueKind::Int || kind == ValueKind::Float || kind == ValueKind::Str;
+}
+
+// A whole Float hashes as the Int it is equal to, and every NaN as one.
+uint64_t HashTable::hash_of(const TaggedValue &key) {
+    switch(key.get_kind()) {
+        case ValueKind::Int: return mix(key.get_int());
+        case ValueKind::Float: {
+            double x{key.get_float()};
+            int64_t whole;
+            if(whole_float(x, whole))
+                return mix(whole);
+            if(std::isnan(x))
+                x = std::numeric_limits<double>::quiet_NaN();
+            uint64_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            return mix(bits);
+        }
+        default: return mix(std::hash<std::string>()(key.as<StringValue>()->get_value()));
+    }
+}
+
+// Numbers are the same key when they are `=`, and NaN is NaN.
+bool HashTable::same_key(const TaggedValue &a, const TaggedValue &b) {
+    bool a_str{a.get_kind() == ValueKind::Str}, b_str{b.get_kind() == ValueKind::Str};
+    if(a_str || b_str)
+        return a_str && b_str && a.as<StringValue>()->get_value() == b.as<StringValue>()->get_value();
+    if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int)
+        return a.get_int() == b.get_int();
+    if(a.get_kind() == ValueKind::Float && b.get_kind() == ValueKind::Float)
+        return a.get_float() == b.get_float() || (std::isnan(a.get_float()) && std::isnan(b.get_float()));
+    const TaggedValue &whole{a.get_kind() == ValueKind::Int ? a : b}, &x{a.get_kind() == ValueKind::Int ? b : a};
+    int64_t as_int;
+    return whole_float(x.get_float(), as_int) && as_int == whole.get_int();
+}
+
+// At most half of the slots are held, so a probe always reaches an empty
+// one.
+size_t HashTable::probe(const TaggedValue &key, uint64_t hash) const {
+    size_t mask{slots.size() - 1};
+    for(size_t slot{hash & mask};; slot = (slot + 1) & mask) {
+        int32_t at{slots[slot]};
+        if(at == EMPTY)
+            return slot;
+        if(at != REMOVED && entries[at].hash == hash && same_key(entries[at].key, key))
+            return slot;
+    }
+}
+
+TaggedValue* HashTable::find(const TaggedValue &key) {
+    if(count == 0 || !is_key(key))
+        return nullptr;
+    int32_t at{slots[probe(key, hash_of(key))]};
+    return at == EMPTY ? nullptr : &entries[at].value;
+}
+
+// Every entry, removed or not, holds a slot until the next rebuild.
+bool HashTable::insert(const TaggedValue &key, TaggedValue value) {
+    uint64_t hash{hash_of(key)};
+    if(!slots.empty()) {
+        int32_t at{slots[probe(key, hash)]};
+        if(at != EMPTY) {
+            entries[at].value = std::move(value);
+            return false;
+        }
+    }
+    if(2 * (entries.size() + 1) > slots.size())
+        rebuild();
+    slots[probe(key, hash)] = entries.size();
+    entries.push_back(Entry{key, std::move(value), hash});
+    ++count;
+    return true;
+}
+
+bool HashTable::remove(const TaggedValue &key) {
+    if(count == 0 || !is_key(key))
+        return false;
+    size_t slot{probe(key, hash_of(key))};
+    if(slots[slot] == EMPTY)
+        return false;
+    Entry &entry{entries[slots[slot]]};
+    entry.key = TaggedValue::undefined();
+    entry.value = TaggedValue();
+    slots[slot] = REMOVED;
+    --count;
+    return true;
+}
+
+// With four slots per entry, a quarter of the slots are taken by new
+// entries before the next rebuild, however many were removed.
+void HashTable::rebuild() {
+    std::vector<Entry> kept;
+    kept.reserve(count + 1);
+    for(Entry &entry : entries) {
+        if(!entry.key.is_undefined())
+            kept.push_back(std::move(entry));
+    }
+    entries = std::move(kept);
+    size_t capacity{8};
+    while(capacity < 4 * (count + 1))
+        capacity *= 2;
+    slots.assign(capacity, EMPTY);
+    size_t mask{capacity - 1};
+    for(size_t i{0}; i < entries.size(); ++i) {
+        size_t slot{entries[i].hash & mask};
+        while(slots[slot] != EMPTY)
+            slot = (slot + 1) & mask;
+        slots[slot] = i;
+    }
+}
+
+// Map keys and Set elements are hashed, so they must be numbers or Strs.
+static TaggedValue key_error(const std::string &what, const TaggedValue &key) {
+    if(key.is_error())
+        return key;
+    return make_error(what + " should be an Int, Float or Str, find " + key.get_type() + "\n");
+}
+
+std::string MapValue::get_num() {
+    std::string ret{type + "{"};
+    table.for_each([&ret](const TaggedValue &key, const TaggedValue &value) {
+        if(ret.back() != '{') ret += ", ";
+        ret += key.repr() + ": " + value.repr();
+    });
+    return ret + "}";
+}
+
+TaggedValue MapValue::get(const TaggedValue &key) {
+    if(key.is_error())
+        return key;
+    TaggedValue *value{table.find(key)};
+    if(value == nullptr)
+        return make_error("Key " + key.repr() + " is not in the Map\n");
+    return *value;
+}
+
+TaggedValue MapValue::set(const TaggedValue &key, const TaggedValue &value) {
+    if(!HashTable::is_key(key))
+        return key_error("Map keys", key);
+    table.insert(key, value);
+    return value;
+}
+
+std::string SetValue::get_num() {
+    std::string ret{type + "{"};
+    table.for_each([&ret](const TaggedValue &key, const TaggedValue&) {
+        if(ret.back() != '{') ret += ", ";
+        ret += key.repr();
+    });
+    return ret + "}";
+}
+
+// An error from `<` counts as not less, as it does in sort.
+bool HeapValue::after(const Entry &a, const Entry &b) {
+    if(is_less(b.priority, a.priority))
+        return true;
+    if(is_less(a.priority, b.priority))
+        return false;
+    return a.order > b.order;
+}
+
+// The elements in the order they would be popped.
+std::string HeapValue::get_num() {
+    std::vector<Entry> sorted{entries};
+    std::sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) { return after(b, a);});
+    std::string ret{type + "{"};
+    for(const Entry &entry : sorted) {
+        if(ret.back() != '{') ret += ", ";
+        ret += entry.value.repr();
+    }
+    return ret + "}";
+}
+
+void HeapValue::push(TaggedValue value, TaggedValue priority) {
+    entries.push_back(Entry{std::move(value), std::move(priority), pushed++});
+    std::push_heap(entries.begin(), entries.end(), after);
+}
+
+TaggedValue HeapValue::pop() {
+    std::pop_heap(entries.begin(), entries.end(), after);
+    TaggedValue ret{std::move(entries.back().value)};
+    entries.pop_back();
+    return ret;
+}
+
+std::string DequeValue::get_num() {
+    std::string ret{type + "{"};
+    for(const TaggedValue &element : value) {
+        if(ret.back() != '{') ret += ", ";
+        ret += element.repr();
+    }
+    return ret + "}";
 }
 
-std::shared_ptr<Value> ArrayValue::pop_back() {
-    if(value.empty())
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Pop a empty array");
-    value.pop_back();
-    return value.back();
+TaggedValue DequeValue::get(int64_t p) const {
+    if(p < 1 || p > static_cast<int64_t>(value.size()))
+        return make_error(
+            "Index out of range, size: " + std::to_string(value.size()) + ", position: " + std::to_string(p));
+    return value[p - 1];
 }
 
-std::shared_ptr<Value>& ArrayValue::operator[](int p) {
-    if(1 <= p && p <= value.size())
-        return value[p - 1];
-    error = std::make_shared<ErrorValue>(
-        VALUE_ERROR, "Index out of range, size: " + std::to_string(value.size()) + ", position: " + std::to_string(p));
-    return error;
+TaggedValue index_get(const TaggedValue &container, const TaggedValue &index) {
+    switch(container.get_kind()) {
+        case ValueKind::Array: return container.as<ArrayValue>()->get(as_integer(index));
+        case ValueKind::Deque: return container.as<DequeValue>()->get(as_integer(index));
+        case ValueKind::Map: return container.as<MapValue>()->get(index);
+        case ValueKind::Set:
+            if(index.is_error())
+                return index;
+            return make_int(container.as<SetValue>()->get_table().find(index) != nullptr);
+        default:
+            return make_error("Access can only apply on array, map, set or deque, find " + container.get_type() + "\n");
+    }
 }
 
-std::shared_ptr<Value> BaseAlgoValue::set_args(NodeList &args, SymbolTable &sym, Interpreter &interpreter) {
-    if(args.size() < value->get_toks().size()) {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Too few arguments" RESET);
-    } else if(args.size() > value->get_toks().size()) {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Too many arguments" RESET);
+TaggedValue index_set(const TaggedValue &container, const TaggedValue &index, const TaggedValue &value) {
+    switch(container.get_kind()) {
+        case ValueKind::Array:
+            container.as<ArrayValue>()->set(as_integer(index), value);
+            break;
+        case ValueKind::Deque:
+            container.as<DequeValue>()->set(as_integer(index), value);
+            break;
+        case ValueKind::Map: return container.as<MapValue>()->set(index, value);
+        case ValueKind::Set: {
+            if(value.is_error())
+                return value;
+            HashTable &table{container.as<SetValue>()->get_table()};
+            if(!is_truthy(value))
+                table.remove(index);
+            else if(HashTable::is_key(index))
+                table.insert(index, TaggedValue());
+            else
+                return key_error("Set elements", index);
+            break;
+        }
+        default: break;
     }
+    return value;
+}
 
-    TokenList args_name = value->get_toks();
-    for(int i = 0; i < args.size(); ++i) {
-        std::shared_ptr<Value> v = interpreter.visit(args[i]);
-        sym.set(args_name[i]->get_value(), v);
+TaggedValue BaseAlgoValue::check_arity(size_t args_count) {
+    if(args_count < min_arity) {
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Too few arguments" RESET);
+    } else if(args_count > arity) {
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Too many arguments" RESET);
     }
-    return std::make_shared<Value>();
+    return TaggedValue();
 }
 
-std::shared_ptr<Value> AlgoValue::execute(NodeList args, SymbolTable *parent) {
-    SymbolTable sym(parent);
-    Interpreter interpreter(sym);
-    std::shared_ptr<Value> ret{set_args(args, sym, interpreter)};
-    if(ret->get_type() == VALUE_ERROR)
+// Arguments are evaluated in the caller's scope straight into the slots of
+// a pooled frame, before any of them is bound.
+TaggedValue AlgoValue::execute(const NodeList &args, SymbolTable *parent) {
+    Interpreter interpreter(*parent);
+    if(args.size() != arity) {
+        for(auto &arg : args)
+            interpreter.visit(arg);
+        return check_arity(args.size());
+    }
+    SymbolTable &frame{parent->push_frame(static_cast<AlgorithmDefNode*>(value.get())->get_layout().get())};
+    for(size_t i{0}; i < args.size(); ++i) {
+        frame.set_local(i, interpreter.visit(args[i]));
+    }
+    if(MemoCache *memo{get_memo_cache()})
+        return run_memo(memo, parent, frame);
+    return run_body(parent, &frame);
+}
+
+TaggedValue AlgoValue::call(ValueSpan args, SymbolTable *parent) {
+    TaggedValue ret{check_arity(args.size())};
+    if(ret.is_error())
         return ret;
+    SymbolTable &frame{parent->push_frame(static_cast<AlgorithmDefNode*>(value.get())->get_layout().get())};
+    for(size_t i{0}; i < args.size(); ++i) {
+        frame.set_local(i, args[i]);
+    }
+    if(MemoCache *memo{get_memo_cache()})
+        return run_memo(memo, parent, frame);
+    return run_body(parent, &frame);
+}
 
-    NodeList algo_body = value->get_child();
-    
-    for(int i = 0; i < algo_body.size(); ++i) {
-        ret = interpreter.visit(algo_body[i]);
+// The key is taken before the body runs, it may assign its parameters.
+TaggedValue AlgoValue::run_memo(MemoCache *memo, SymbolTable *parent, SymbolTable &frame) {
+    std::string key;
+    if(!MemoCache::make_key(frame.get_slots(arity), key))
+        return run_body(parent, &frame);
+    TaggedValue ret;
+    if(memo->find(key, ret)) {
+        parent->pop_frame();
+        return ret;
     }
+    ret = run_body(parent, &frame);
+    memo->insert(key, ret);
     return ret;
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute(NodeList args, SymbolTable *parent) {
-    SymbolTable sym(parent);
-    Interpreter interpreter(sym);
-    std::shared_ptr<Value> ret{set_args(args, sym, interpreter)};
-    if(ret->get_type() == VALUE_ERROR)
+// Runs the body in frame and releases it. A tail call the body ends with
+// then runs here in a fresh frame, instead of one level deeper.
+TaggedValue AlgoValue::run_body(SymbolTable *parent, SymbolTable *frame) {
+    AlgorithmDefNode *def{static_cast<AlgorithmDefNode*>(value.get())};
+    // Keeps the Algorithm of a tail call alive while its body runs.
+    TaggedValue running;
+    TailCall tail;
+    while(true) {
+        Interpreter interpreter(*frame);
+        const NodeList &body{def->get_body()};
+        TaggedValue ret;
+        for(size_t i{0}; i < body.size(); ++i) {
+            if(i + 1 < body.size())
+                ret = interpreter.visit(body[i]);
+            else
+                ret = interpreter.visit_tail(body[i], tail);
+        }
+        parent->pop_frame();
+        if(tail.algo.get_kind() != ValueKind::Algo)
+            return ret;
+
+        running = std::move(tail.algo);
+        def = static_cast<AlgorithmDefNode*>(running.as<BaseAlgoValue>()->get_def().get());
+        frame = &parent->push_frame(def->get_layout().get());
+        for(size_t i{0}; i < tail.args.size(); ++i) {
+            frame->set_local(i, std::move(tail.args[i]));
+        }
+    }
+}
+
+Builtin builtin_of(const std::string &name) {
+    static const std::map<std::string, Builtin> BUILTINS{
+        {"print", Builtin::Print}, {"read", Builtin::Read}, {"read_line", Builtin::ReadLine},
+        {"open", Builtin::Open}, {"clear", Builtin::Clear}, {"quit", Builtin::Quit},
+        {"int", Builtin::Int}, {"float", Builtin::Float}, {"string", Builtin::String},
+        {"array", Builtin::Array}, {"sum", Builtin::Sum}, {"min_of", Builtin::MinOf},
+        {"max_of", Builtin::MaxOf}, {"count", Builtin::Count}, {"index_of", Builtin::IndexOf},
+        {"dot", Builtin::Dot}, {"sort", Builtin::Sort}, {"reverse", Builtin::Reverse},
+        {"lower_bound", Builtin::LowerBound}, {"upper_bound", Builtin::UpperBound},
+        {"unique", Builtin::Unique}, {"map", Builtin::Map}, {"set", Builtin::Set},
+        {"heap", Builtin::Heap}, {"deque", Builtin::Deque}, {"size", Builtin::Size},
+        {"has", Builtin::Has}, {"insert", Builtin::Insert}, {"remove", Builtin::Remove},
+        {"keys", Builtin::Keys}, {"values", Builtin::Values}, {"push", Builtin::Push},
+        {"top", Builtin::Top}, {"pop", Builtin::Pop}, {"push_front", Builtin::PushFront},
+        {"push_back", Builtin::PushBack}, {"front", Builtin::Front}, {"back", Builtin::Back},
+        {"pop_front", Builtin::PopFront}, {"pop_back", Builtin::PopBack}
+    };
+    auto found{BUILTINS.find(name)};
+    return found == BUILTINS.end() ? Builtin::Unknown : found->second;
+}
+
+// All arguments are evaluated, call() checks the count before it reads
+// the span.
+TaggedValue BuiltinAlgoValue::execute(const NodeList &args, SymbolTable *parent) {
+    Interpreter interpreter(*parent);
+    ValueList values;
+    values.reserve(args.size());
+    for(size_t i{0}; i < args.size(); ++i)
+        values.push_back(interpreter.visit(args[i]));
+    return call(ValueSpan{values.data(), values.size()}, parent);
+}
+
+TaggedValue BuiltinAlgoValue::call(ValueSpan args, SymbolTable *parent) {
+    TaggedValue ret{check_arity(args.size())};
+    if(ret.is_error())
         return ret;
-    TokenList args_name = value->get_toks();
-    if(algo_name == "print") {
-        return execute_print(sym.get(args_name[0]->get_value())->get_num());
-    } else if(algo_name == "read") {
-        return execute_read();
-    } else if(algo_name == "read_line") {
-        return execute_read_line();
-    } else if(algo_name == "open") {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Not found!");
-    } else if(algo_name == "clear") {
-        return execute_clear();
-    } else if(algo_name == "quit") {
-        exit(0);
-    } else if(algo_name == "int") {
-        return execute_int(sym.get(args_name[0]->get_value())->get_num());
-    } else if(algo_name == "float") {
-        return execute_float(sym.get(args_name[0]->get_value())->get_num());
-    } else if(algo_name == "string") {
-        return execute_string(sym.get(args_name[0]->get_value())->get_num());
+    switch(builtin) {
+        case Builtin::Print:
+            return execute_print(args[0].get_num());
+        case Builtin::Read:
+            return execute_read();
+        case Builtin::ReadLine:
+            return execute_read_line();
+        case Builtin::Open:
+            return make_error("Not found!");
+        case Builtin::Clear:
+            return execute_clear();
+        case Builtin::Quit:
+            exit(0);
+        case Builtin::Int:
+            return execute_int(args[0].get_num());
+        case Builtin::Float:
+            return execute_float(args[0].get_num());
+        case Builtin::String:
+            return execute_string(args[0].get_num());
+        case Builtin::Array:
+            return execute_array(args[0], args[1]);
+        case Builtin::Sum:
+            return execute_sum(args[0]);
+        case Builtin::MinOf:
+            return execute_min_of(args[0]);
+        case Builtin::MaxOf:
+            return execute_max_of(args[0]);
+        case Builtin::Count:
+            return execute_count(args[0], args[1]);
+        case Builtin::IndexOf:
+            return execute_index_of(args[0], args[1]);
+        case Builtin::Dot:
+            return execute_dot(args[0], args[1]);
+        case Builtin::Sort:
+            return execute_sort(args[0], args.size() > 1 ? args[1] : TaggedValue(), parent);
+        case Builtin::Reverse:
+            return execute_reverse(args[0]);
+        case Builtin::LowerBound:
+            return execute_bound(args[0], args[1], false);
+        case Builtin::UpperBound:
+            return execute_bound(args[0], args[1], true);
+        case Builtin::Unique:
+            return execute_unique(args[0]);
+        case Builtin::Map:
+            return execute_map();
+        case Builtin::Set:
+            return execute_set(args.size() > 0 ? args[0] : TaggedValue());
+        case Builtin::Heap:
+            return execute_heap(args.size() > 0 ? args[0] : TaggedValue());
+        case Builtin::Deque:
+            return execute_deque(args.size() > 0 ? args[0] : TaggedValue());
+        case Builtin::Size:
+            return execute_size(args[0]);
+        case Builtin::Has:
+            return execute_has(args[0], args[1]);
+        case Builtin::Insert:
+            return execute_insert(args[0], args[1]);
+        case Builtin::Remove:
+            return execute_remove(args[0], args[1]);
+        case Builtin::Keys:
+            return execute_keys(args[0], false);
+        case Builtin::Values:
+            return execute_keys(args[0], true);
+        case Builtin::Push:
+            return execute_push(args[0], args[1], args.size() > 2 ? args[2] : TaggedValue());
+        case Builtin::Top:
+            return execute_top(args[0], false);
+        case Builtin::Pop:
+            return execute_top(args[0], true);
+        case Builtin::PushFront:
+            return execute_push_end(args[0], args[1], true);
+        case Builtin::PushBack:
+            return execute_push_end(args[0], args[1], false);
+        case Builtin::Front:
+            return execute_end(args[0], true, false);
+        case Builtin::Back:
+            return execute_end(args[0], false, false);
+        case Builtin::PopFront:
+            return execute_end(args[0], true, true);
+        case Builtin::PopBack:
+            return execute_end(args[0], false, true);
+        case Builtin::Unknown:
+            break;
     }
     return ret;
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_print(const std::string &str) {
+TaggedValue BuiltinAlgoValue::execute_print(const std::string &str) {
     std::cout << str << "\n";
-    return std::make_shared<Value>();
+    return TaggedValue();
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_read() {
+TaggedValue BuiltinAlgoValue::execute_read() {
     std::string ret;
     std::cin >> ret;
     std::cin.ignore();
-    return std::make_shared<TypedValue<std::string>>(VALUE_STRING, ret);
+    return make_string(ret);
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_read_line() {
+TaggedValue BuiltinAlgoValue::execute_read_line() {
     std::string ret;
     std::getline(std::cin, ret);
-    return std::make_shared<TypedValue<std::string>>(VALUE_STRING, ret);
+    return make_string(ret);
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_clear() {
+TaggedValue BuiltinAlgoValue::execute_clear() {
     std::system("clear");
-    return std::make_shared<Value>();
+    return TaggedValue();
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_int(const std::string &str) {
+TaggedValue BuiltinAlgoValue::execute_int(const std::string &str) {
     if(str[0] != '-' && !std::isdigit(str[0])) {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Cannot convert \"" + str + "\" to an int");
+        return make_error("Cannot convert \"" + str + "\" to an int");
     }
-    for(int i{1}; i < str.size(); ++i) 
-        if(!std::isdigit(str[0])) 
-            return std::make_shared<ErrorValue>(VALUE_ERROR, "Cannot convert \"" + str + "\" to an int");
-    return std::make_shared<TypedValue<int64_t>>(VALUE_INT, std::stoll(str));
+    for(size_t i{1}; i < str.size(); ++i)
+        if(!std::isdigit(str[0]))
+            return make_error("Cannot convert \"" + str + "\" to an int");
+    return make_int(std::stoll(str));
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_float(const std::string &str) {
+TaggedValue BuiltinAlgoValue::execute_float(const std::string &str) {
     int point{0};
     if(str[0] != '-' && !std::isdigit(str[0])) {
-        return std::make_shared<ErrorValue>(VALUE_ERROR, "Cannot convert \"" + str + "\" to an int");
+        return make_error("Cannot convert \"" + str + "\" to an int");
     }
-    for(int i{1}; i < str.size(); ++i) {
+    for(size_t i{1}; i < str.size(); ++i) {
         if(!std::isdigit(str[0]) && (str[0] != '.' || point == 1)) {
-            return std::make_shared<ErrorValue>(VALUE_ERROR, "Cannot convert \"" + str + "\" to an int");
+            return make_error("Cannot convert \"" + str + "\" to an int");
         }
         if(str[0] == '.') point++;
     }
-    return std::make_shared<TypedValue<double>>(VALUE_FLOAT, std::stod(str));
+    return make_float(std::stod(str));
+}
+
+TaggedValue BuiltinAlgoValue::execute_string(const std::string &str) {
+    return make_string(str);
+}
+
+// Past this, array() gives an error rather than asking for the memory.
+static constexpr int64_t MAX_ARRAY_SIZE{int64_t(1) << 28};
+
+// An Array fill is copied into every element, so that they can be changed
+// apart. Numbers make a packed array.
+TaggedValue BuiltinAlgoValue::execute_array(const TaggedValue &size, const TaggedValue &fill) {
+    if(size.is_error())
+        return size;
+    if(fill.is_error())
+        return fill;
+    if(size.get_kind() != ValueKind::Int)
+        return make_error("Array size should be an Int, find " + size.get_type() + "\n");
+    if(size.get_int() < 0)
+        return make_error("Array size should not be negative, find " + std::to_string(size.get_int()) + "\n");
+    if(size.get_int() > MAX_ARRAY_SIZE)
+        return make_error("Array size should be at most " + std::to_string(MAX_ARRAY_SIZE) + ", find "
+            + std::to_string(size.get_int()) + "\n");
+    TaggedValue ret{make_boxed<ArrayValue>(ValueList())};
+    ArrayValue *array{ret.as<ArrayValue>()};
+    try {
+        if(fill.get_kind() != ValueKind::Array) {
+            array->fill(fill, size.get_int());
+            return ret;
+        }
+        for(int64_t i{0}; i < size.get_int(); ++i)
+            array->push_back(fill.as<ArrayValue>()->copy());
+    } catch(const std::bad_alloc&) {
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: not enough memory for an Array of "
+            + std::to_string(size.get_int()) + " elements\n" RESET);
+    }
+    return ret;
+}
+
+// The builtins over an array pass an error argument on, and fail on
+// anything else that is not an Array.
+static TaggedValue check_array(const std::string &algo_name, const TaggedValue &arg) {
+    if(arg.is_error())
+        return arg;
+    if(arg.get_kind() != ValueKind::Array)
+        return make_error(algo_name + " expects an Array, find " + arg.get_type() + "\n");
+    return TaggedValue();
+}
+
+// Packed arrays go through the kernels. Other arrays are added left to
+// right with `+`, as a loop would, so strings are joined. An empty array
+// sums to 0.
+TaggedValue BuiltinAlgoValue::execute_sum(const TaggedValue &arr) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    const ArrayValue *array{arr.as<ArrayValue>()};
+    switch(array->get_layout()) {
+        case ArrayLayout::Int: {
+            const std::vector<int64_t> &ints{array->get_ints()};
+            return make_int(kernels().sum_ints(ints.data(), ints.size()));
+        }
+        case ArrayLayout::Float: {
+            // Added at full precision, only the total is rounded by make_float.
+            const std::vector<double> &floats{array->get_floats()};
+            return make_float(kernels().sum_floats(floats.data(), floats.size()));
+        }
+        default: break;
+    }
+    if(array->size() == 0)
+        return make_int(0);
+    ret = array->get(1);
+    for(int64_t p{2}; p <= static_cast<int64_t>(array->size()) && !ret.is_error(); ++p)
+        ret = ret + array->get(p);
+    return ret;
+}
+
+// The first of the least, or greatest, elements by `<`.
+static TaggedValue extreme_of(const std::string &algo_name, const TaggedValue &arr, bool greatest) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    const ArrayValue *array{arr.as<ArrayValue>()};
+    if(array->size() == 0)
+        return make_error(algo_name + " expects a non empty Array\n");
+    const Kernels &kernel{kernels()};
+    switch(array->get_layout()) {
+        case ArrayLayout::Int: {
+            const std::vector<int64_t> &ints{array->get_ints()};
+            return make_int(greatest ? kernel.max_ints(ints.data(), ints.size())
+                : kernel.min_ints(ints.data(), ints.size()));
+        }
+        case ArrayLayout::Float: {
+            const std::vector<double> &floats{array->get_floats()};
+            return make_float(greatest ? kernel.max_floats(floats.data(), floats.size())
+                : kernel.min_floats(floats.data(), floats.size()));
+        }
+        default: break;
+    }
+    ret = array->get(1);
+    for(int64_t p{2}; p <= static_cast<int64_t>(array->size()); ++p) {
+        TaggedValue element{array->get(p)};
+        if(greatest ? is_less(ret, element) : is_less(element, ret))
+            ret = std::move(element);
+    }
+    return ret;
+}
+
+TaggedValue BuiltinAlgoValue::execute_min_of(const TaggedValue &arr) {
+    return extreme_of(algo_name, arr, false);
+}
+
+TaggedValue BuiltinAlgoValue::execute_max_of(const TaggedValue &arr) {
+    return extreme_of(algo_name, arr, true);
+}
+
+// Where x is, from 1, or 0 when it is not there. Matches are found by
+// `==`; the kernels only take an x of the kind the array packs.
+static int64_t position_of(const ArrayValue *array, const TaggedValue &x) {
+    if(array->get_layout() == ArrayLayout::Int && x.get_kind() == ValueKind::Int) {
+        const std::vector<int64_t> &ints{array->get_ints()};
+        size_t found{kernels().find_int(ints.data(), ints.size(), x.get_int())};
+        return found == ints.size() ? 0 : found + 1;
+    }
+    if(array->get_layout() == ArrayLayout::Float && x.get_kind() == ValueKind::Float) {
+        const std::vector<double> &floats{array->get_floats()};
+        size_t found{kernels().find_float(floats.data(), floats.size(), x.get_float())};
+        return found == floats.size() ? 0 : found + 1;
+    }
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p) {
+        if(is_equal(array->get(p), x))
+            return p;
+    }
+    return 0;
+}
+
+TaggedValue BuiltinAlgoValue::execute_count(const TaggedValue &arr, const TaggedValue &x) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    if(x.is_error())
+        return x;
+    const ArrayValue *array{arr.as<ArrayValue>()};
+    if(array->get_layout() == ArrayLayout::Int && x.get_kind() == ValueKind::Int) {
+        const std::vector<int64_t> &ints{array->get_ints()};
+        return make_int(kernels().count_ints(ints.data(), ints.size(), x.get_int()));
+    }
+    if(array->get_layout() == ArrayLayout::Float && x.get_kind() == ValueKind::Float) {
+        const std::vector<double> &floats{array->get_floats()};
+        return make_int(kernels().count_floats(floats.data(), floats.size(), x.get_float()));
+    }
+    int64_t count{0};
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p)
+        count += is_equal(array->get(p), x);
+    return make_int(count);
+}
+
+TaggedValue BuiltinAlgoValue::execute_index_of(const TaggedValue &arr, const TaggedValue &x) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    if(x.is_error())
+        return x;
+    return make_int(position_of(arr.as<ArrayValue>(), x));
+}
+
+// Ints give an Int that wraps around, a Float on either side gives a
+// Float. Other arrays are multiplied and added with the operators.
+TaggedValue BuiltinAlgoValue::execute_dot(const TaggedValue &a, const TaggedValue &b) {
+    TaggedValue ret{check_array(algo_name, a)};
+    if(ret.is_error())
+        return ret;
+    ret = check_array(algo_name, b);
+    if(ret.is_error())
+        return ret;
+    const ArrayValue *left{a.as<ArrayValue>()}, *right{b.as<ArrayValue>()};
+    if(left->size() != right->size())
+        return make_error("dot expects Arrays of the same size, find " + std::to_string(left->size())
+            + " and " + std::to_string(right->size()) + "\n");
+    ArrayLayout left_layout{left->get_layout()}, right_layout{right->get_layout()};
+    if(left_layout == ArrayLayout::Int && right_layout == ArrayLayout::Int) {
+        const std::vector<int64_t> &x{left->get_ints()}, &y{right->get_ints()};
+        return make_int(kernels().dot_ints(x.data(), y.data(), x.size()));
+    }
+    if(left_layout == ArrayLayout::Float && right_layout == ArrayLayout::Float) {
+        const std::vector<double> &x{left->get_floats()}, &y{right->get_floats()};
+        return make_float(kernels().dot_floats(x.data(), y.data(), x.size()));
+    }
+    if(left_layout != ArrayLayout::Boxed && right_layout != ArrayLayout::Boxed) {
+        const ArrayValue *ints{left_layout == ArrayLayout::Int ? left : right};
+        const ArrayValue *floats{left_layout == ArrayLayout::Int ? right : left};
+        std::vector<double> converted(ints->get_ints().begin(), ints->get_ints().end());
+        return make_float(kernels().dot_floats(converted.data(), floats->get_floats().data(), converted.size()));
+    }
+    ret = make_int(0);
+    for(int64_t p{1}; p <= static_cast<int64_t>(left->size()) && !ret.is_error(); ++p)
+        ret = ret + left->get(p) * right->get(p);
+    return ret;
+}
+
+// sort, reverse and unique change the array they are given and return it.
+// The arguments are copies, so a comparator that rebinds their variables
+// cannot free them.
+TaggedValue BuiltinAlgoValue::execute_sort(TaggedValue arr, TaggedValue before, SymbolTable *parent) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    if(before.is_error())
+        return before;
+    if(before.get_kind() == ValueKind::None) {
+        arr.as<ArrayValue>()->sort();
+        return arr;
+    }
+    if(before.get_kind() != ValueKind::Algo)
+        return make_error("sort expects an Algorithm to compare with, find " + before.get_type() + "\n");
+    ret = arr.as<ArrayValue>()->sort(before.as<BaseAlgoValue>(), parent);
+    return ret.is_error() ? ret : arr;
+}
+
+TaggedValue BuiltinAlgoValue::execute_reverse(const TaggedValue &arr) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    arr.as<ArrayValue>()->reverse();
+    return arr;
+}
+
+// Positions in an array sorted by `<`, found by binary search.
+TaggedValue BuiltinAlgoValue::execute_bound(const TaggedValue &arr, const TaggedValue &x, bool upper) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    if(x.is_error())
+        return x;
+    const ArrayValue *array{arr.as<ArrayValue>()};
+    return make_int(upper ? array->upper_bound(x) : array->lower_bound(x));
+}
+
+TaggedValue BuiltinAlgoValue::execute_unique(const TaggedValue &arr) {
+    TaggedValue ret{check_array(algo_name, arr)};
+    if(ret.is_error())
+        return ret;
+    arr.as<ArrayValue>()->unique();
+    return arr;
+}
+
+TaggedValue BuiltinAlgoValue::execute_map() {
+    return make_boxed<MapValue>();
+}
+
+// set, heap and deque start empty, or with the elements of an Array.
+static TaggedValue check_from(const std::string &algo_name, const TaggedValue &from) {
+    if(from.get_kind() == ValueKind::None)
+        return TaggedValue();
+    return check_array(algo_name, from);
+}
+
+TaggedValue BuiltinAlgoValue::execute_set(const TaggedValue &from) {
+    TaggedValue ret{check_from(algo_name, from)};
+    if(ret.is_error())
+        return ret;
+    ret = make_boxed<SetValue>();
+    if(from.get_kind() != ValueKind::Array)
+        return ret;
+    const ArrayValue *array{from.as<ArrayValue>()};
+    HashTable &table{ret.as<SetValue>()->get_table()};
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p) {
+        TaggedValue element{array->get(p)};
+        if(!HashTable::is_key(element))
+            return key_error("Set elements", element);
+        table.insert(element, TaggedValue());
+    }
+    return ret;
+}
+
+// Each element is its own priority.
+TaggedValue BuiltinAlgoValue::execute_heap(const TaggedValue &from) {
+    TaggedValue ret{check_from(algo_name, from)};
+    if(ret.is_error())
+        return ret;
+    ret = make_boxed<HeapValue>();
+    if(from.get_kind() != ValueKind::Array)
+        return ret;
+    const ArrayValue *array{from.as<ArrayValue>()};
+    HeapValue *heap{ret.as<HeapValue>()};
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p) {
+        TaggedValue element{array->get(p)};
+        heap->push(element, element);
+    }
+    return ret;
+}
+
+TaggedValue BuiltinAlgoValue::execute_deque(const TaggedValue &from) {
+    TaggedValue ret{check_from(algo_name, from)};
+    if(ret.is_error())
+        return ret;
+    ret = make_boxed<DequeValue>();
+    if(from.get_kind() != ValueKind::Array)
+        return ret;
+    const ArrayValue *array{from.as<ArrayValue>()};
+    std::deque<TaggedValue> &elements{ret.as<DequeValue>()->get_elements()};
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p)
+        elements.push_back(array->get(p));
+    return ret;
+}
+
+TaggedValue BuiltinAlgoValue::execute_size(const TaggedValue &container) {
+    switch(container.get_kind()) {
+        case ValueKind::Error: return container;
+        case ValueKind::Str: return make_int(container.as<StringValue>()->get_value().size());
+        case ValueKind::Array: return make_int(container.as<ArrayValue>()->size());
+        case ValueKind::Map: return make_int(container.as<MapValue>()->get_table().size());
+        case ValueKind::Set: return make_int(container.as<SetValue>()->get_table().size());
+        case ValueKind::Heap: return make_int(container.as<HeapValue>()->size());
+        case ValueKind::Deque: return make_int(container.as<DequeValue>()->get_elements().size());
+        default:
+            return make_error(algo_name + " expects a Str, Array, Map, Set, Heap or Deque, find "
+                + container.get_type() + "\n");
+    }
+}
+
+// The table of a Map, or of a Set, for the builtins that take either.
+static HashTable* table_of(const TaggedValue &container) {
+    if(container.get_kind() == ValueKind::Map)
+        return &container.as<MapValue>()->get_table();
+    if(container.get_kind() == ValueKind::Set)
+        return &container.as<SetValue>()->get_table();
+    return nullptr;
+}
+
+// Whether a Map has the key, or a Set the element.
+TaggedValue BuiltinAlgoValue::execute_has(const TaggedValue &container, const TaggedValue &key) {
+    if(container.is_error())
+        return container;
+    if(key.is_error())
+        return key;
+    HashTable *table{table_of(container)};
+    if(table == nullptr)
+        return make_error(algo_name + " expects a Map or Set, find " + container.get_type() + "\n");
+    return make_int(table->find(key) != nullptr);
+}
+
+// 1 when x was not in the Set yet.
+TaggedValue BuiltinAlgoValue::execute_insert(const TaggedValue &set, const TaggedValue &x) {
+    if(set.is_error())
+        return set;
+    if(set.get_kind() != ValueKind::Set)
+        return make_error(algo_name + " expects a Set, find " + set.get_type() + "\n");
+    if(!HashTable::is_key(x))
+        return key_error("Set elements", x);
+    return make_int(set.as<SetValue>()->get_table().insert(x, TaggedValue()));
+}
+
+// 1 when the key, or element, was there.
+TaggedValue BuiltinAlgoValue::execute_remove(const TaggedValue &container, const TaggedValue &key) {
+    if(container.is_error())
+        return container;
+    if(key.is_error())
+        return key;
+    HashTable *table{table_of(container)};
+    if(table == nullptr)
+        return make_error(algo_name + " expects a Map or Set, find " + container.get_type() + "\n");
+    return make_int(table->remove(key));
+}
+
+// The keys of a Map or the elements of a Set, or the values of a Map, as
+// an Array in the order they were added. A for loop over it walks the
+// container.
+TaggedValue BuiltinAlgoValue::execute_keys(const TaggedValue &container, bool values) {
+    if(container.is_error())
+        return container;
+    HashTable *table{table_of(container)};
+    if(table == nullptr || (values && container.get_kind() != ValueKind::Map))
+        return make_error(algo_name + (values ? " expects a Map, find " : " expects a Map or Set, find ")
+            + container.get_type() + "\n");
+    TaggedValue ret{make_boxed<ArrayValue>(ValueList())};
+    ArrayValue *array{ret.as<ArrayValue>()};
+    table->for_each([array, values](const TaggedValue &key, const TaggedValue &value) {
+        array->push_back(values ? value : key);
+    });
+    return ret;
+}
+
+// A priority left out is the value itself. Gives the Heap.
+TaggedValue BuiltinAlgoValue::execute_push(const TaggedValue &heap, const TaggedValue &x, const TaggedValue &priority) {
+    if(heap.is_error())
+        return heap;
+    if(heap.get_kind() != ValueKind::Heap)
+        return make_error(algo_name + " expects a Heap, find " + heap.get_type() + "\n");
+    if(x.is_error())
+        return x;
+    if(priority.is_error())
+        return priority;
+    heap.as<HeapValue>()->push(x, priority.get_kind() == ValueKind::None ? x : priority);
+    return heap;
+}
+
+// The value of least priority, taken out of the Heap by pop.
+TaggedValue BuiltinAlgoValue::execute_top(const TaggedValue &heap, bool pop) {
+    if(heap.is_error())
+        return heap;
+    if(heap.get_kind() != ValueKind::Heap)
+        return make_error(algo_name + " expects a Heap, find " + heap.get_type() + "\n");
+    HeapValue *values{heap.as<HeapValue>()};
+    if(values->size() == 0)
+        return make_error(algo_name + " expects a non empty Heap\n");
+    return pop ? values->pop() : values->top();
+}
+
+// push_front takes a Deque, push_back an Array too. Gives the container.
+TaggedValue BuiltinAlgoValue::execute_push_end(const TaggedValue &container, const TaggedValue &x, bool front) {
+    if(container.is_error())
+        return container;
+    if(x.is_error())
+        return x;
+    if(container.get_kind() == ValueKind::Deque) {
+        std::deque<TaggedValue> &elements{container.as<DequeValue>()->get_elements()};
+        if(front)
+            elements.push_front(x);
+        else
+            elements.push_back(x);
+        return container;
+    }
+    if(front || container.get_kind() != ValueKind::Array)
+        return make_error(algo_name + (front ? " expects a Deque, find " : " expects an Array or Deque, find ")
+            + container.get_type() + "\n");
+    container.as<ArrayValue>()->push_back(x);
+    return container;
+}
+
+// front and back read an end, pop_front and pop_back take it out. Those at
+// the front take a Deque, those at the back an Array too.
+TaggedValue BuiltinAlgoValue::execute_end(const TaggedValue &container, bool front, bool pop) {
+    if(container.is_error())
+        return container;
+    size_t size;
+    if(container.get_kind() == ValueKind::Deque)
+        size = container.as<DequeValue>()->get_elements().size();
+    else if(!front && container.get_kind() == ValueKind::Array)
+        size = container.as<ArrayValue>()->size();
+    else
+        return make_error(algo_name + (front ? " expects a Deque, find " : " expects an Array or Deque, find ")
+            + container.get_type() + "\n");
+    if(size == 0)
+        return make_error(algo_name + " expects a non empty " + container.get_type() + "\n");
+    if(container.get_kind() == ValueKind::Array)
+        return pop ? container.as<ArrayValue>()->pop_back() : container.as<ArrayValue>()->back();
+    std::deque<TaggedValue> &elements{container.as<DequeValue>()->get_elements()};
+    TaggedValue ret{front ? elements.front() : elements.back()};
+    if(pop && front)
+        elements.pop_front();
+    else if(pop)
+        elements.pop_back();
+    return ret;
+}
+
+/// --------------------
+/// Operation
+/// --------------------
+
+// An Array reads as 1 when is_truthy holds for it, so that a comparison
+// of arrays can be a condition.
+int64_t as_integer(const TaggedValue &value) {
+    if(value.get_kind() == ValueKind::Int)
+        return value.get_int();
+    if(value.get_kind() == ValueKind::Array)
+        return is_truthy(value);
+    return std::stoll(value.get_num());
+}
+
+// An Array is true when every element is, so `a < b` holds when every
+// element of a is less.
+bool is_truthy(const TaggedValue &value) {
+    switch(value.get_kind()) {
+        case ValueKind::Int: return value.get_int() != 0;
+        case ValueKind::Float: return value.get_float() != 0;
+        case ValueKind::Array: {
+            const ArrayValue *array{value.as<ArrayValue>()};
+            if(array->get_layout() == ArrayLayout::Int)
+                return kernels().count_ints(array->get_ints().data(), array->size(), 0) == 0;
+            if(array->get_layout() == ArrayLayout::Float)
+                return kernels().count_floats(array->get_floats().data(), array->size(), 0.0) == 0;
+            for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p) {
+                if(!is_truthy(array->get(p)))
+                    return false;
+            }
+            return true;
+        }
+        default: return std::stoll(value.get_num()) != 0;
+    }
+}
+
+// How a pair of operands is combined by the arithmetic and comparison
+// operators. Int op Int stays Int, any other pair of numbers is promoted to
+// Float, an Array on either side is taken element by element, everything
+// else goes through the string based path.
+enum class OperandPair {
+    INT, FLOAT, ARRAY, OTHER
+};
+
+constexpr int VALUE_KIND_COUNT{static_cast<int>(ValueKind::Deque) + 1};
+
+constexpr OperandPair make_operand_pair(ValueKind a, ValueKind b) {
+    if(a == ValueKind::Int && b == ValueKind::Int)
+        return OperandPair::INT;
+    if((a == ValueKind::Int || a == ValueKind::Float) && (b == ValueKind::Int || b == ValueKind::Float))
+        return OperandPair::FLOAT;
+    if(a == ValueKind::Array || b == ValueKind::Array)
+        return OperandPair::ARRAY;
+    return OperandPair::OTHER;
+}
+
+template<size_t... I>
+constexpr std::array<OperandPair, sizeof...(I)> make_operand_table(std::index_sequence<I...>) {
+    return {make_operand_pair(
+        static_cast<ValueKind>(I / VALUE_KIND_COUNT), static_cast<ValueKind>(I % VALUE_KIND_COUNT))...};
+}
+
+constexpr std::array<OperandPair, VALUE_KIND_COUNT * VALUE_KIND_COUNT> OPERAND_TABLE{
+    make_operand_table(std::make_index_sequence<VALUE_KIND_COUNT * VALUE_KIND_COUNT>())};
+
+static inline OperandPair operand_pair(const TaggedValue &a, const TaggedValue &b) {
+    return OPERAND_TABLE[static_cast<int>(a.get_kind()) * VALUE_KIND_COUNT + static_cast<int>(b.get_kind())];
+}
+
+static inline bool is_float(const TaggedValue &a) {
+    return a.get_kind() == ValueKind::Float;
+}
+
+static TaggedValue apply(MapOp op, const TaggedValue &a, const TaggedValue &b) {
+    switch(op) {
+        case MapOp::Add: return a + b;
+        case MapOp::Sub: return a - b;
+        case MapOp::Mul: return a * b;
+        case MapOp::Div: return a / b;
+        case MapOp::Mod: return a % b;
+        case MapOp::Pow: return pow(a, b);
+        case MapOp::Equal: return a == b;
+        case MapOp::Neq: return a != b;
+        case MapOp::Less: return a < b;
+        case MapOp::Greater: return a > b;
+        case MapOp::Leq: return a <= b;
+        case MapOp::Geq: return a >= b;
+    }
+    return TaggedValue();
+}
+
+// What kind of number an operand is made of, None when it is not packed.
+static ValueKind packed_kind(const TaggedValue &value) {
+    if(value.get_kind() != ValueKind::Array)
+        return value.get_kind();
+    switch(value.as<ArrayValue>()->get_layout()) {
+        case ArrayLayout::Int: return ValueKind::Int;
+        case ArrayLayout::Float: return ValueKind::Float;
+        default: return ValueKind::None;
+    }
+}
+
+// The elements of an Int operand for a kernel, a number has a step of 0.
+static const int64_t* int_operand(const TaggedValue &value, int64_t &number, size_t &step) {
+    step = value.get_kind() == ValueKind::Array;
+    if(step != 0)
+        return value.as<ArrayValue>()->get_ints().data();
+    number = value.get_int();
+    return &number;
+}
+
+// The elements of an operand as Floats. Those of an Int array are
+// converted into converted.
+static const double* float_operand(const TaggedValue &value, double &number, size_t &step,
+    std::vector<double> &converted) {
+    step = value.get_kind() == ValueKind::Array;
+    if(step == 0) {
+        number = value.get_float();
+        return &number;
+    }
+    const ArrayValue *array{value.as<ArrayValue>()};
+    if(array->get_layout() == ArrayLayout::Float)
+        return array->get_floats().data();
+    converted.assign(array->get_ints().begin(), array->get_ints().end());
+    return converted.data();
 }
 
-std::shared_ptr<Value> BuiltinAlgoValue::execute_string(const std::string &str) {
-    return std::make_shared<TypedValue<std::string>>(VALUE_STRING, str);
+// Packed operands of n elements through a kernel, with the kinds the
+// operators would give: Ints stay Ints, a Float on either side makes every
+// element a Float. Undefined when there is no kernel for them: Int
+// division, `%` and `^`, or a division by 0, which the operators report.
+static TaggedValue map_packed(MapOp op, const TaggedValue &a, const TaggedValue &b, size_t n) {
+    ValueKind a_kind{packed_kind(a)}, b_kind{packed_kind(b)};
+    bool is_number_a{a_kind == ValueKind::Int || a_kind == ValueKind::Float};
+    bool is_number_b{b_kind == ValueKind::Int || b_kind == ValueKind::Float};
+    if(!is_number_a || !is_number_b || op == MapOp::Mod || op == MapOp::Pow)
+        return TaggedValue::undefined();
+    bool comparison{op >= MapOp::Equal};
+    const Kernels &kernel{kernels()};
+    if(a_kind == ValueKind::Int && b_kind == ValueKind::Int) {
+        if(op == MapOp::Div)
+            return TaggedValue::undefined();
+        int64_t x_number, y_number;
+        size_t x_step, y_step;
+        const int64_t *x{int_operand(a, x_number, x_step)}, *y{int_operand(b, y_number, y_step)};
+        std::vector<int64_t> out(n);
+        kernel.map_ints(op, x, x_step, y, y_step, out.data(), n);
+        return make_boxed<ArrayValue>(std::move(out));
+    }
+    double x_number, y_number;
+    size_t x_step, y_step;
+    std::vector<double> x_converted, y_converted;
+    const double *x{float_operand(a, x_number, x_step, x_converted)};
+    const double *y{float_operand(b, y_number, y_step, y_converted)};
+    if(op == MapOp::Div && (y_step == 0 ? y_number == 0.0 : kernel.count_floats(y, n, 0.0) != 0))
+        return TaggedValue::undefined();
+    if(comparison) {
+        std::vector<int64_t> out(n);
+        kernel.compare_floats(op, x, x_step, y, y_step, out.data(), n);
+        return make_boxed<ArrayValue>(std::move(out));
+    }
+    std::vector<double> out(n);
+    kernel.map_floats(op, x, x_step, y, y_step, out.data(), n);
+    // Packed Floats are kept as make_float would have made them.
+    for(double &element : out)
+        element = six_digits(element);
+    return make_boxed<ArrayValue>(std::move(out));
+}
+
+// An Array operand is taken element by element, anything else on the
+// other side is used for every element. Two arrays must be of one size.
+// The first element that fails fails the whole operation.
+static TaggedValue elementwise(MapOp op, const TaggedValue &a, const TaggedValue &b) {
+    const ArrayValue *x{a.get_kind() == ValueKind::Array ? a.as<ArrayValue>() : nullptr};
+    const ArrayValue *y{b.get_kind() == ValueKind::Array ? b.as<ArrayValue>() : nullptr};
+    if(x != nullptr && y != nullptr && x->size() != y->size())
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: Arrays of sizes "
+            + std::to_string(x->size()) + " and " + std::to_string(y->size()) + " cannot be combined element by element\n" RESET);
+    size_t n{x != nullptr ? x->size() : y->size()};
+    TaggedValue result{map_packed(op, a, b, n)};
+    if(!result.is_undefined())
+        return result;
+    result = make_boxed<ArrayValue>(ValueList());
+    ArrayValue *out{result.as<ArrayValue>()};
+    for(size_t p{1}; p <= n; ++p) {
+        TaggedValue element{apply(op, x != nullptr ? x->get(p) : a, y != nullptr ? y->get(p) : b)};
+        if(element.is_error())
+            return element;
+        out->push_back(std::move(element));
+    }
+    return result;
 }
 
-std::shared_ptr<Value> operator+(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(
-            VALUE_FLOAT, std::stod(a->get_num()) + std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) + std::stoll(b->get_num()));
-    else if(a->get_type() == VALUE_STRING && b->get_type() == VALUE_STRING)
-        return std::make_shared<TypedValue<std::string>>(
-            VALUE_STRING, a->get_num() + b->get_num());
+TaggedValue operator+(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() + b.get_int());
+        case OperandPair::FLOAT: return make_float(a.get_float() + b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Add, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_float(std::stod(a.get_num()) + std::stod(b.get_num()));
+    else if(a.get_kind() == ValueKind::Str && b.get_kind() == ValueKind::Str)
+        return make_string(a.get_num() + b.get_num());
     else
-        return std::make_shared<ErrorValue>(
-            VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: ADD operation can only apply on number or two string\n" RESET);
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: ADD operation can only apply on number or two string\n" RESET);
 }
 
-std::shared_ptr<Value> operator-(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(
-            VALUE_FLOAT, std::stod(a->get_num()) - std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) - std::stoll(b->get_num()));
+TaggedValue operator-(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() - b.get_int());
+        case OperandPair::FLOAT: return make_float(a.get_float() - b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Sub, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_float(std::stod(a.get_num()) - std::stod(b.get_num()));
     else
-        return std::make_shared<ErrorValue>(
-            VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: SUB operation can only apply on number\n" RESET);
-}
-
-std::shared_ptr<Value> operator*(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(
-            VALUE_FLOAT, std::stod(a->get_num()) * std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) * std::stoll(b->get_num()));
-    else if(a->get_type() == VALUE_STRING && b->get_type() == VALUE_INT) {
-        std::string ret, str_a{a->get_num()};
-        int64_t times{stoll(b->get_num())};
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: SUB operation can only apply on number\n" RESET);
+}
+
+TaggedValue operator*(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() * b.get_int());
+        case OperandPair::FLOAT: return make_float(a.get_float() * b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Mul, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_float(std::stod(a.get_num()) * std::stod(b.get_num()));
+    else if(a.get_kind() == ValueKind::Str && b.get_kind() == ValueKind::Int) {
+        std::string ret, str_a{a.get_num()};
+        int64_t times{b.get_int()};
         for(int i{0}; i < times; ++i)
             ret += str_a;
-        return std::make_shared<TypedValue<std::string>>(
-            VALUE_STRING, ret);
+        return make_string(ret);
     } else
-        return std::make_shared<ErrorValue>(
-            VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: MUL operation can only apply on number or string and int\n" RESET);
-}
-
-std::shared_ptr<Value> operator/(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(std::stod(b->get_num()) == 0.0) 
-        return std::make_shared<ErrorValue>(VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: DIV by 0\n" RESET);
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(
-            VALUE_FLOAT, std::stod(a->get_num()) / std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) / std::stoll(b->get_num()));
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: MUL operation can only apply on number or string and int\n" RESET);
+}
+
+TaggedValue operator/(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT:
+            if(b.get_int() == 0) break;
+            // The one quotient that does not fit wraps around like a sum.
+            if(b.get_int() == -1)
+                return make_int(static_cast<int64_t>(uint64_t(0) - static_cast<uint64_t>(a.get_int())));
+            return make_int(a.get_int() / b.get_int());
+        case OperandPair::FLOAT:
+            if(b.get_float() == 0.0) break;
+            return make_float(a.get_float() / b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Div, a, b);
+        default: break;
+    }
+    if(std::stod(b.get_num()) == 0.0)
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: DIV by 0\n" RESET);
+    if(is_float(a) || is_float(b))
+        return make_float(std::stod(a.get_num()) / std::stod(b.get_num()));
     else
-        return std::make_shared<ErrorValue>(
-            VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: DIV operation can only apply on number\n" RESET);
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: DIV operation can only apply on number\n" RESET);
 }
 
-std::shared_ptr<Value> operator%(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() != VALUE_INT || b->get_type() != VALUE_INT) 
-        return std::make_shared<ErrorValue>(VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Cannot apply \"%\" operation on float\n" RESET);
-    return std::make_shared<TypedValue<int64_t>>(
-        VALUE_INT, std::stoll(a->get_num()) % std::stoll(b->get_num()));
+TaggedValue operator%(const TaggedValue &a, const TaggedValue &b) {
+    if(operand_pair(a, b) == OperandPair::ARRAY)
+        return elementwise(MapOp::Mod, a, b);
+    if(operand_pair(a, b) != OperandPair::INT)
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Cannot apply \"%\" operation on float\n" RESET);
+    if(b.get_int() == 0)
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: MOD by 0\n" RESET);
+    if(b.get_int() == -1)
+        return make_int(0);
+    return make_int(a.get_int() % b.get_int());
 }
 
-std::shared_ptr<Value> operator==(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) == std::stod(b->get_num()));
-    else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() == b->get_num());
+// `=` and `!=` compare arrays as a whole: two arrays are equal when they
+// have one size and their elements are equal in order. An array is never
+// equal to anything else.
+static bool arrays_equal(const TaggedValue &a, const TaggedValue &b) {
+    if(a.get_kind() != ValueKind::Array || b.get_kind() != ValueKind::Array)
+        return false;
+    const ArrayValue *x{a.as<ArrayValue>()}, *y{b.as<ArrayValue>()};
+    if(x->size() != y->size())
+        return false;
+    if(x->get_layout() == ArrayLayout::Int && y->get_layout() == ArrayLayout::Int)
+        return x->get_ints() == y->get_ints();
+    if(x->get_layout() == ArrayLayout::Float && y->get_layout() == ArrayLayout::Float)
+        return x->get_floats() == y->get_floats();
+    for(int64_t p{1}; p <= static_cast<int64_t>(x->size()); ++p) {
+        if(!is_equal(x->get(p), y->get(p)))
+            return false;
+    }
+    return true;
 }
 
-std::shared_ptr<Value> operator!=(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) != std::stod(b->get_num()));
+TaggedValue operator==(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() == b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() == b.get_float());
+        case OperandPair::ARRAY: return make_int(arrays_equal(a, b));
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) == std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() != b->get_num());
+        return make_int(a.get_num() == b.get_num());
 }
 
-std::shared_ptr<Value> operator<(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) < std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) < std::stoll(b->get_num()));
+TaggedValue operator!=(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() != b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() != b.get_float());
+        case OperandPair::ARRAY: return make_int(!arrays_equal(a, b));
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) != std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() < b->get_num());
+        return make_int(a.get_num() != b.get_num());
 }
 
-std::shared_ptr<Value> operator>(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) > std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) > std::stoll(b->get_num()));
+TaggedValue operator<(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() < b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() < b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Less, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) < std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() > b->get_num());
+        return make_int(a.get_num() < b.get_num());
 }
 
-std::shared_ptr<Value> operator<=(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) <= std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) <= std::stoll(b->get_num()));
+TaggedValue operator>(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() > b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() > b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Greater, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) > std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() <= b->get_num());
+        return make_int(a.get_num() > b.get_num());
 }
 
-std::shared_ptr<Value> operator>=(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) >= std::stod(b->get_num()));
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) >= std::stoll(b->get_num()));
+TaggedValue operator<=(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() <= b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() <= b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Leq, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) <= std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, a->get_num() >= b->get_num());
+        return make_int(a.get_num() <= b.get_num());
 }
 
-std::shared_ptr<Value> operator&&(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) != 0 && std::stod(b->get_num()) != 0);
-    else if(a->get_type() == VALUE_INT && b->get_type() == VALUE_INT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) != 0 && std::stoll(b->get_num()) != 0);
+TaggedValue operator>=(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() >= b.get_int());
+        case OperandPair::FLOAT: return make_int(a.get_float() >= b.get_float());
+        case OperandPair::ARRAY: return elementwise(MapOp::Geq, a, b);
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) >= std::stod(b.get_num()));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) && std::stoll(b->get_num()));
+        return make_int(a.get_num() >= b.get_num());
 }
 
-std::shared_ptr<Value> operator||(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stod(a->get_num()) != 0 || std::stod(b->get_num()) != 0);
+TaggedValue operator&&(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() != 0 && b.get_int() != 0);
+        case OperandPair::FLOAT: return make_int(a.get_float() != 0 && b.get_float() != 0);
+        case OperandPair::ARRAY: return make_int(is_truthy(a) && is_truthy(b));
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) != 0 && std::stod(b.get_num()) != 0);
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::stoll(a->get_num()) || std::stoll(b->get_num()));
+        return make_int(std::stoll(a.get_num()) && std::stoll(b.get_num()));
 }
 
-std::shared_ptr<Value> operator-(std::shared_ptr<Value> a) {
-    if(a->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(VALUE_FLOAT, 0 - stod(a->get_num()));
+TaggedValue operator||(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT: return make_int(a.get_int() != 0 || b.get_int() != 0);
+        case OperandPair::FLOAT: return make_int(a.get_float() != 0 || b.get_float() != 0);
+        case OperandPair::ARRAY: return make_int(is_truthy(a) || is_truthy(b));
+        default: break;
+    }
+    if(is_float(a) || is_float(b))
+        return make_int(std::stod(a.get_num()) != 0 || std::stod(b.get_num()) != 0);
     else
-        return std::make_shared<TypedValue<int64_t>>(VALUE_INT, 0 - stoll(a->get_num()));
+        return make_int(std::stoll(a.get_num()) || std::stoll(b.get_num()));
 }
 
-std::shared_ptr<Value> operator!(std::shared_ptr<Value> a) {
-    if(a->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(VALUE_FLOAT, stod(a->get_num()) == 0);
-    else
-        return std::make_shared<TypedValue<int64_t>>(VALUE_INT, stoll(a->get_num()) == 0);
+// `not` of each element. A Float stays a Float, so only Int arrays go
+// through a kernel.
+static TaggedValue not_elements(const TaggedValue &a) {
+    const ArrayValue *array{a.as<ArrayValue>()};
+    if(array->get_layout() == ArrayLayout::Int)
+        return elementwise(MapOp::Equal, a, make_int(0));
+    TaggedValue result{make_boxed<ArrayValue>(ValueList())};
+    ArrayValue *out{result.as<ArrayValue>()};
+    for(int64_t p{1}; p <= static_cast<int64_t>(array->size()); ++p) {
+        TaggedValue element{!array->get(p)};
+        if(element.is_error())
+            return element;
+        out->push_back(std::move(element));
+    }
+    return result;
 }
 
-std::shared_ptr<Value> pow(std::shared_ptr<Value> a, std::shared_ptr<Value> b) {
-    if(std::stod(a->get_num()) == 0.0 && std::stod(b->get_num()) == 0.0) 
-        return std::make_shared<ErrorValue>(VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: 0 to the 0\n" RESET);
-    if(a->get_type() == VALUE_FLOAT || b->get_type() == VALUE_FLOAT)
-        return std::make_shared<TypedValue<double>>(
-            VALUE_FLOAT, std::pow(std::stod(a->get_num()), std::stod(b->get_num())));
+TaggedValue operator-(const TaggedValue &a) {
+    if(a.get_kind() == ValueKind::Int)
+        return make_int(0 - a.get_int());
+    if(a.get_kind() == ValueKind::Float)
+        return make_float(0 - a.get_float());
+    if(a.get_kind() == ValueKind::Array)
+        return elementwise(MapOp::Sub, make_int(0), a);
+    return make_int(0 - std::stoll(a.get_num()));
+}
+
+TaggedValue operator!(const TaggedValue &a) {
+    if(a.get_kind() == ValueKind::Int)
+        return make_int(a.get_int() == 0);
+    if(a.get_kind() == ValueKind::Float)
+        return make_float(a.get_float() == 0);
+    if(a.get_kind() == ValueKind::Array)
+        return not_elements(a);
+    return make_int(std::stoll(a.get_num()) == 0);
+}
+
+TaggedValue pow(const TaggedValue &a, const TaggedValue &b) {
+    switch(operand_pair(a, b)) {
+        case OperandPair::INT:
+            if(a.get_int() == 0 && b.get_int() == 0) break;
+            return make_int(std::pow(a.get_int(), b.get_int()));
+        case OperandPair::FLOAT:
+            if(a.get_float() == 0.0 && b.get_float() == 0.0) break;
+            return make_float(std::pow(a.get_float(), b.get_float()));
+        case OperandPair::ARRAY: return elementwise(MapOp::Pow, a, b);
+        default: break;
+    }
+    if(std::stod(a.get_num()) == 0.0 && std::stod(b.get_num()) == 0.0)
+        return make_error(Color(0xFF, 0x39, 0x6E).get() + "Runtime ERROR: 0 to the 0\n" RESET);
+    if(is_float(a) || is_float(b))
+        return make_float(std::pow(std::stod(a.get_num()), std::stod(b.get_num())));
     else
-        return std::make_shared<TypedValue<int64_t>>(
-            VALUE_INT, std::pow(std::stoll(a->get_num()), std::stoll(b->get_num())));
+        return make_int(std::pow(std::stoll(a.get_num()), std::stoll(b.get_num())));
 }
 
 /// --------------------
 /// Run
 /// --------------------
 
-std::string Run(std::string file_name, std::string text, SymbolTable &global_symbol_table) {
-    Lexer lexer(file_name, text);
-    TokenList tokens = lexer.make_tokens();
-    if(tokens.empty()) return "";
-    if(tokens[0]->get_type() == TOKEN_ERROR)
+// Lexes and parses text. Problems are printed and leave aborted set.
+static NodeList parse_program(const std::string &file_name, const std::string &text, bool &aborted) {
+    TokenStream stream{Lexer(file_name, text).lex()};
+    if(stream.get_lexemes().empty()) return NodeList();
+    if(stream.failed()) {
+        TokenList tokens{stream.to_token_list()};
         std::cout << "Tokens: " << tokens << "\n";
+    }
 
-    Parser parser(tokens);
+    Parser parser(stream);
     NodeList ast = parser.parse();
-    
+
     for(auto node : ast) {
         if(node->get_type() == NODE_ERROR)
             std::cout << "Nodes: " << node->get_node() << "\n";
-        if(node->get_type() == NODE_ERROR) return "ABORT";
+        if(node->get_type() == NODE_ERROR) {
+            aborted = true;
+            return NodeList();
+        }
+    }
+    Optimizer().optimize(ast);
+    if(Optimizer::dump) {
+        for(auto node : ast)
+            std::cout << "Optimized: " << node->get_node() << "\n";
+    }
+    return ast;
+}
+
+static void print_result(const std::string &file_name, ArrayValue *ret) {
+    while(ret->back().get_kind() == ValueKind::Array) {
+        ret = ret->back().as<ArrayValue>();
     }
 
+    if(file_name == "stdin" && ret->get(1).get_kind() != ValueKind::None) {
+        std::cout << ret->get_num() << "\n";
+    }
+}
+
+std::string Run(std::string file_name, std::string text, SymbolTable &global_symbol_table) {
+    bool aborted{false};
+    NodeList ast{parse_program(file_name, text, aborted)};
+    if(aborted) return "ABORT";
+    if(ast.empty()) return "";
+
+    Resolver resolver(global_symbol_table.get_names());
+    resolver.resolve(ast);
+    resolver.find_pure(ast);
+    resolver.mark_unused(ast, file_name == "stdin");
     Interpreter interpreter(global_symbol_table);
-    ArrayValue *ret{new ArrayValue(ValueList(0))};
+    TaggedValue result{make_boxed<ArrayValue>(ValueList(0))};
+    ArrayValue *ret{result.as<ArrayValue>()};
     for(auto node : ast) {
         ret->push_back(interpreter.visit(node));
-        if(ret->back()->get_type() == VALUE_ERROR) {
-            std::cout << ret->back()->get_num() << "\n";
+        if(ret->back().is_error()) {
+            std::cout << ret->back().get_num() << "\n";
             return "ABORT";
         }
     }
+    print_result(file_name, ret);
+    return "";
+}
 
-    while(ret->get_type() == VALUE_ARRAY && ret->back()->get_type() == VALUE_ARRAY) {
-        ret = dynamic_cast<ArrayValue*>(ret->back().get());
-    }
-    
-    if(file_name == "stdin" && ret->operator[](0)->get_type() != VALUE_NONE) {
-        std::cout << ret->get_num() << "\n";
+std::string Run(std::string file_name, std::string text, VM &vm) {
+    bool aborted{false};
+    NodeList ast{parse_program(file_name, text, aborted)};
+    if(aborted) return "ABORT";
+    if(ast.empty()) return "";
+
+    Resolver resolver(vm.get_names());
+    resolver.resolve(ast);
+    resolver.find_pure(ast);
+    resolver.mark_unused(ast, file_name == "stdin");
+    Compiler compiler;
+    TaggedValue result{make_boxed<ArrayValue>(ValueList(0))};
+    ArrayValue *ret{result.as<ArrayValue>()};
+    for(auto node : ast) {
+        std::shared_ptr<FunctionProto> proto{compiler.compile_top_level(node)};
+        ret->push_back(vm.run(*proto));
+        if(ret->back().is_error()) {
+            std::cout << ret->back().get_num() << "\n";
+            return "ABORT";
+        }
     }
+    print_result(file_name, ret);
     return "";
 }
+
+// Resolved the same way the interpreters do, so the generated code sees
+// the same scopes. Returns an empty string when the script does not parse.
+std::string Transpile(std::string file_name, std::string text) {
+    bool aborted{false};
+    NodeList ast{parse_program(file_name, text, aborted)};
+    if(aborted) return "";
+
+    NameTable names;
+    Resolver resolver(names);
+    resolver.resolve(ast);
+    resolver.find_pure(ast);
+    resolver.mark_unused(ast, false);
+    return Transpiler(names).transpile(ast);
+}
\ No newline at end of file
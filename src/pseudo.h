@@ -14,12 +14,19 @@
 #include "parser.h"
 #include "lexer.h"
 #include "symboltable.h"
+#include "resolver.h"
+#include "optimizer.h"
 #include "interpreter.h"
+#include "compiler.h"
+#include "vm.h"
+#include "transpiler.h"
 
 /// --------------------
 /// Run
 /// --------------------
 
 std::string Run(std::string, std::string, SymbolTable&);
+std::string Run(std::string, std::string, VM&);
+std::string Transpile(std::string, std::string);
 
 #endif
\ No newline at end of file
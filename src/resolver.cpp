@@ -0,0 +1,274 @@
+/// --------------------
+/// Resolver
+/// --------------------
+
+#include "resolver.h"
+#include "node.h"
+#include "memo.h"
+
+void Resolver::resolve(NodeSpan nodes) {
+    for(auto &node : nodes) {
+        if(node != nullptr)
+            resolve(node);
+    }
+}
+
+void Resolver::resolve(std::shared_ptr<Node> node) {
+    int index{0};
+    switch(node->get_kind()) {
+        case NodeKind::VarAccess: {
+            VarScope scope{scope_of(node->get_name(), index)};
+            static_cast<VarAccessNode*>(node.get())->resolve(scope, index);
+            // Locals other than parameters may be read before they are
+            // assigned, and then come from the callers too.
+            if(scope == VarScope::Dynamic)
+                names.mark_read_by_callees(index);
+            else if(scope == VarScope::Local && index >= layout->param_count)
+                names.mark_read_by_callees(layout->slot_names[index]);
+            return;
+        }
+        case NodeKind::VarAssign: {
+            VarScope scope{scope_of(node->get_name(), index)};
+            static_cast<VarAssignNode*>(node.get())->resolve(scope, index);
+            break;
+        }
+        case NodeKind::AlgoDef:
+            return resolve_algo_def(node);
+        case NodeKind::If: {
+            IfNode* if_node = static_cast<IfNode*>(node.get());
+            resolve(if_node->get_condition());
+            resolve(if_node->get_expr());
+            resolve(if_node->get_else());
+            return;
+        }
+        case NodeKind::AlgoCall:
+            resolve(static_cast<AlgorithmCallNode*>(node.get())->get_call());
+            break;
+        default: break;
+    }
+    resolve(node->get_child());
+}
+
+void Resolver::resolve_algo_def(std::shared_ptr<Node> node) {
+    AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+    int index{0};
+    VarScope scope{scope_of(node->get_name(), index)};
+    algo_def->resolve(scope, index);
+
+    FrameLayout *outer_layout{layout};
+    algo_def->get_layout() = std::make_shared<FrameLayout>();
+    layout = algo_def->get_layout().get();
+    TokenList args_name{node->get_toks()};
+    layout->param_count = args_name.size();
+    for(auto &arg : args_name) {
+        int name{names.intern(arg->get_value())};
+        names.mark_bound(name);
+        if(static_cast<size_t>(name) >= layout->name_slots.size())
+            layout->name_slots.resize(name + 1, -1);
+        // A repeated parameter name is bound by the last argument.
+        layout->name_slots[name] = layout->slot_count();
+        layout->slot_names.push_back(name);
+    }
+    const NodeList &body{node->get_child()};
+    declare_locals(body);
+    resolve(body);
+    layout = outer_layout;
+}
+
+// Names assigned anywhere in an Algorithm body are its locals, those of
+// nested Algorithms belong to them.
+void Resolver::declare_locals(NodeSpan body) {
+    for(auto &node : body) {
+        if(node == nullptr) continue;
+        switch(node->get_kind()) {
+            case NodeKind::VarAssign:
+                declare_local(node->get_name());
+                break;
+            case NodeKind::AlgoDef:
+                declare_local(node->get_name());
+                continue;
+            case NodeKind::If: {
+                IfNode* if_node = static_cast<IfNode*>(node.get());
+                declare_locals(NodeList{if_node->get_condition()});
+                declare_locals(if_node->get_expr());
+                declare_locals(if_node->get_else());
+                continue;
+            }
+            case NodeKind::AlgoCall:
+                declare_locals(NodeList{static_cast<AlgorithmCallNode*>(node.get())->get_call()});
+                break;
+            default: break;
+        }
+        declare_locals(node->get_child());
+    }
+}
+
+int Resolver::declare_local(const std::string &var_name) {
+    int name{names.intern(var_name)};
+    if(layout->slot_of(name) >= 0)
+        return layout->slot_of(name);
+    names.mark_bound(name);
+    if(static_cast<size_t>(name) >= layout->name_slots.size())
+        layout->name_slots.resize(name + 1, -1);
+    layout->name_slots[name] = layout->slot_count();
+    layout->slot_names.push_back(name);
+    return layout->slot_count() - 1;
+}
+
+VarScope Resolver::scope_of(const std::string &var_name, int &index) {
+    int name{names.intern(var_name)};
+    if(layout == nullptr) {
+        index = name;
+        return VarScope::Global;
+    }
+    index = layout->slot_of(name);
+    if(index >= 0)
+        return VarScope::Local;
+    index = name;
+    return VarScope::Dynamic;
+}
+
+// A `memo` Algorithm gets a cache when its result can only depend on its
+// arguments. Top level Algorithms start out pure and lose it until nothing
+// changes, so recursion between them is fine.
+void Resolver::find_pure(const NodeList &program) {
+    algos.clear();
+    impure.clear();
+    for(auto &node : program) {
+        if(node == nullptr) continue;
+        if(node->get_kind() == NodeKind::AlgoDef) {
+            AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+            // A name bound twice may call either definition.
+            if(algos.count(algo_def->get_index()))
+                impure.insert(algo_def->get_index());
+            algos[algo_def->get_index()] = algo_def;
+        } else if(node->get_kind() == NodeKind::VarAssign) {
+            impure.insert(static_cast<VarAssignNode*>(node.get())->get_index());
+        }
+    }
+    bool changed{true};
+    while(changed) {
+        changed = false;
+        for(auto &[name, algo_def] : algos) {
+            if(impure.count(name)) continue;
+            for(auto &stmt : algo_def->get_body()) {
+                if(!is_pure(stmt)) {
+                    impure.insert(name);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    for(auto &[name, algo_def] : algos) {
+        if(algo_def->is_memo() && !impure.count(name))
+            algo_def->set_memo_cache(std::make_shared<MemoCache>());
+    }
+}
+
+// No printing or reading, no array writes, no nested Algorithms, and only
+// calls to value conversions or to pure top level Algorithms. Variables read
+// from the callers must name such an Algorithm, and one no caller can bind.
+bool Resolver::is_pure(std::shared_ptr<Node> node) {
+    switch(node->get_kind()) {
+        case NodeKind::VarAccess: {
+            VarAccessNode *var = static_cast<VarAccessNode*>(node.get());
+            if(node->get_tok()->get_kind() == TokenKind::BuiltinAlgo) {
+                const std::string &name{var->get_name()};
+                return name == "int" || name == "float" || name == "string";
+            }
+            if(var->get_scope() == VarScope::Local)
+                return true;
+            // A parameter or local of some caller would hide the global.
+            if(names.is_bound(var->get_index()))
+                return false;
+            // array is not reserved, so it is the builtin unless assigned.
+            if(var->get_name() == "array")
+                return !impure.count(var->get_index());
+            return algos.count(var->get_index()) && !impure.count(var->get_index());
+        }
+        case NodeKind::VarAssign:
+            if(static_cast<VarAssignNode*>(node.get())->get_scope() != VarScope::Local)
+                return false;
+            break;
+        case NodeKind::ArrAssign:
+        case NodeKind::AlgoDef:
+            return false;
+        case NodeKind::If: {
+            IfNode* if_node = static_cast<IfNode*>(node.get());
+            if(!is_pure(if_node->get_condition()))
+                return false;
+            for(auto &stmt : if_node->get_expr())
+                if(!is_pure(stmt)) return false;
+            for(auto &stmt : if_node->get_else())
+                if(!is_pure(stmt)) return false;
+            return true;
+        }
+        case NodeKind::AlgoCall: {
+            std::shared_ptr<Node> call{static_cast<AlgorithmCallNode*>(node.get())->get_call()};
+            // A callee held in a local could be anything.
+            if(call->get_kind() != NodeKind::VarAccess || !is_pure(call)
+                || static_cast<VarAccessNode*>(call.get())->get_scope() == VarScope::Local)
+                return false;
+            break;
+        }
+        default: break;
+    }
+    for(auto &child : node->get_child()) {
+        if(child != nullptr && !is_pure(child))
+            return false;
+    }
+    return true;
+}
+
+// Top level values are only shown by the shell, and only the last one.
+void Resolver::mark_unused(const NodeList &program, bool keep_last) {
+    mark_unused_body(program, keep_last);
+}
+
+void Resolver::mark_unused_body(NodeSpan body, bool last_used) {
+    for(size_t i{0}; i < body.size(); ++i) {
+        if(body[i] != nullptr)
+            mark_unused(body[i], i + 1 == body.size() && last_used);
+    }
+}
+
+// A loop collects its body's value only when the body is one statement,
+// an if and an Algorithm give the value of their last statement.
+void Resolver::mark_unused(std::shared_ptr<Node> node, bool used) {
+    switch(node->get_kind()) {
+        case NodeKind::For:
+        case NodeKind::While:
+        case NodeKind::Repeat: {
+            node->set_value_used(used);
+            const NodeList &child{node->get_child()};
+            size_t body_start{node->get_kind() == NodeKind::For ? 3u : 1u};
+            for(size_t i{0}; i < child.size(); ++i) {
+                if(child[i] == nullptr) continue;
+                if(i < body_start)
+                    mark_unused(child[i], true);
+                else
+                    mark_unused(child[i], used && child.size() == body_start + 1);
+            }
+            return;
+        }
+        case NodeKind::If: {
+            IfNode* if_node = static_cast<IfNode*>(node.get());
+            mark_unused(if_node->get_condition(), true);
+            mark_unused_body(if_node->get_expr(), used);
+            mark_unused_body(if_node->get_else(), used);
+            return;
+        }
+        case NodeKind::AlgoDef:
+            mark_unused_body(node->get_child(), true);
+            return;
+        case NodeKind::AlgoCall:
+            mark_unused(static_cast<AlgorithmCallNode*>(node.get())->get_call(), true);
+            break;
+        default: break;
+    }
+    for(auto &child : node->get_child()) {
+        if(child != nullptr)
+            mark_unused(child, true);
+    }
+}
\ No newline at end of file
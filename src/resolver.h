@@ -0,0 +1,87 @@
+/// --------------------
+/// Resolver
+/// --------------------
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "node.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+/// Every identifier a program uses gets one index. It persists with the
+/// global scope, so a shell session keeps its indices between inputs.
+struct NameTable {
+    std::map<std::string, int> index;
+    std::vector<std::string> names;
+
+    int intern(const std::string &name) {
+        auto it = index.find(name);
+        if(it != index.end()) return it->second;
+        names.push_back(name);
+        return index[name] = names.size() - 1;
+    }
+
+    // Names some Algorithm may read from the scopes of its callers.
+    std::vector<bool> read_by_callees;
+
+    void mark_read_by_callees(int name) {
+        if(static_cast<size_t>(name) >= read_by_callees.size())
+            read_by_callees.resize(name + 1, false);
+        read_by_callees[name] = true;
+    }
+    // Names some Algorithm has a slot for. No calling scope can hold any
+    // other name, so it is read from the globals straight away.
+    std::vector<bool> bound_in_frames;
+
+    void mark_bound(int name) {
+        if(static_cast<size_t>(name) >= bound_in_frames.size())
+            bound_in_frames.resize(name + 1, false);
+        bound_in_frames[name] = true;
+    }
+    bool is_bound(int name) const {
+        return static_cast<size_t>(name) < bound_in_frames.size() && bound_in_frames[name];
+    }
+    // Whether a call scope can be dropped before the call it ends with,
+    // that is no callee could read any of its variables.
+    bool hides(const FrameLayout &layout) const {
+        for(int name : layout.slot_names) {
+            if(static_cast<size_t>(name) < read_by_callees.size() && read_by_callees[name])
+                return false;
+        }
+        return true;
+    }
+};
+
+/// Runs between Parser::parse() and execution. Names assigned anywhere in
+/// an Algorithm body become its slots, top level names become globals, and
+/// every VarAccessNode, VarAssignNode and AlgorithmDefNode is told which.
+class Resolver {
+public:
+    Resolver(NameTable &_names)
+        : names(_names), layout(nullptr) {}
+    void resolve(NodeSpan);
+    void find_pure(const NodeList &program);
+    void mark_unused(const NodeList &program, bool keep_last);
+
+protected:
+    void resolve(std::shared_ptr<Node>);
+    bool is_pure(std::shared_ptr<Node>);
+    void mark_unused(std::shared_ptr<Node>, bool used);
+    void mark_unused_body(NodeSpan, bool last_used);
+    void resolve_algo_def(std::shared_ptr<Node>);
+    void declare_locals(NodeSpan);
+    int declare_local(const std::string&);
+    VarScope scope_of(const std::string&, int &index);
+
+    NameTable &names;
+    FrameLayout *layout;
+    // Top level Algorithms by name, with those not known to be pure.
+    std::map<int, AlgorithmDefNode*> algos;
+    std::set<int> impure;
+};
+
+#endif
\ No newline at end of file
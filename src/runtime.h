@@ -0,0 +1,173 @@
+/// --------------------
+/// Runtime
+/// --------------------
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+// Included by the C++ that Transpiler writes, which links against the
+// interpreter's library for the value operators and the builtins, so a
+// compiled script behaves like the interpreted one.
+
+#include "value.h"
+#include "node.h"
+#include "symboltable.h"
+#include "memo.h"
+#include "vm.h"
+#include "color.h"
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+
+/// Call scope of a transpiled Algorithm. Slots follow the FrameLayout
+/// Resolver gave the definition, caller links the scopes for dynamic lookup.
+struct NativeFrame {
+    const FrameLayout *layout;
+    NativeFrame *caller;
+    TaggedValue *slots;
+};
+
+using NativeFunction = TaggedValue (*)(NativeFrame *caller, ValueSpan args);
+
+/// An Algorithm turned into a C++ function.
+class NativeAlgoValue: public BaseAlgoValue {
+public:
+    NativeAlgoValue(const std::string &_algo_name, size_t _arity, NativeFunction _function)
+        : BaseAlgoValue(_algo_name, std::make_shared<AlgorithmDefNode>(
+            std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), _algo_name),
+            TokenList(_arity, std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arg")))),
+          function(_function) {}
+    TaggedValue call(ValueSpan args, SymbolTable*) override { return call_from(nullptr, args);}
+    TaggedValue call_from(NativeFrame *caller, ValueSpan args) {
+        TaggedValue ret{check_arity(args.size())};
+        if(ret.is_error())
+            return ret;
+        return function(caller, args);
+    }
+protected:
+    NativeFunction function;
+};
+
+/// Names and globals of the running program, filled in by its main.
+struct NativeProgram {
+    const char *const *names{nullptr};
+    ValueList globals;
+};
+
+inline NativeProgram native_program;
+
+inline TaggedValue native_global(int name) {
+    const TaggedValue &value{native_program.globals[name]};
+    if(!value.is_undefined())
+        return value;
+    std::string var_name{native_program.names[name]};
+    if(BUILTIN_ALGOS.count(var_name))
+        return BUILTIN_ALGOS.at(var_name);
+    return make_error(
+        Color(0xFF, 0x39, 0x6E).get() + "Identifier: \""+ var_name +"\" has not defined\n" RESET);
+}
+
+// A name that is not local is searched for through the calling scopes,
+// then the globals.
+inline TaggedValue native_lookup(NativeFrame *frame, int name) {
+    for(; frame != nullptr; frame = frame->caller) {
+        int slot{frame->layout->slot_of(name)};
+        if(slot >= 0 && !frame->slots[slot].is_undefined())
+            return frame->slots[slot];
+    }
+    return native_global(name);
+}
+
+inline TaggedValue native_local(NativeFrame *frame, int slot) {
+    if(frame->slots[slot].is_undefined())
+        return native_lookup(frame->caller, frame->layout->slot_names[slot]);
+    return frame->slots[slot];
+}
+
+inline TaggedValue native_set_local(NativeFrame *frame, int slot, TaggedValue value) {
+    if(!value.is_error())
+        frame->slots[slot] = value;
+    return value;
+}
+
+inline TaggedValue native_set_global(int name, TaggedValue value) {
+    if(!value.is_error())
+        native_program.globals[name] = value;
+    return value;
+}
+
+inline TaggedValue native_negate(TaggedValue a) {
+    return a.is_error() ? a : -a;
+}
+
+inline TaggedValue native_not(TaggedValue a) {
+    return a.is_error() ? a : !a;
+}
+
+inline TaggedValue native_array(std::initializer_list<TaggedValue> elements) {
+    return make_boxed<ArrayValue>(ValueList(elements));
+}
+
+inline TaggedValue native_array_get(const TaggedValue &arr, const TaggedValue &index) {
+    return index_get(arr, index);
+}
+
+// An assignment that misses the container still evaluates to the value.
+inline TaggedValue native_array_set(const TaggedValue &arr, const TaggedValue &index, const TaggedValue &value) {
+    return index_set(arr, index, value);
+}
+
+// Calling anything but an Algorithm gives none.
+inline TaggedValue native_call(NativeFrame *caller, const TaggedValue &callee, ValueSpan args) {
+    if(callee.get_kind() != ValueKind::Algo)
+        return TaggedValue();
+    if(NativeAlgoValue *algo = dynamic_cast<NativeAlgoValue*>(callee.as<BaseAlgoValue>()))
+        return algo->call_from(caller, args);
+    return callee.as<BaseAlgoValue>()->call(args, nullptr);
+}
+
+inline TaggedValue native_float(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return make_float(value);
+}
+
+/// Counter of a for loop, stepping the same way the VM does.
+struct NativeForLoop {
+    TaggedValue counter, end, step;
+    bool upward;
+
+    // False when the step is 0.
+    bool prepare() {
+        double direction{step.get_kind() == ValueKind::Int ? step.get_int() : std::stod(step.get_num())};
+        upward = direction > 0;
+        return direction != 0;
+    }
+    bool test() const {
+        if(counter.get_kind() == ValueKind::Int && end.get_kind() == ValueKind::Int)
+            return upward ? counter.get_int() <= end.get_int() : counter.get_int() >= end.get_int();
+        return as_integer(upward ? counter <= end : counter >= end) == 1;
+    }
+    const TaggedValue& advance() {
+        if(counter.get_kind() == ValueKind::Int && step.get_kind() == ValueKind::Int)
+            counter = make_int(counter.get_int() + step.get_int());
+        else
+            counter = counter + step;
+        return counter;
+    }
+    // Ends the first pass of a loop over a constant like ForFill does.
+    void fill(ValueList &results) {
+        if(counter.get_kind() != ValueKind::Int || end.get_kind() != ValueKind::Int || step.get_kind() != ValueKind::Int)
+            return;
+        uint64_t passes{fill_passes(counter.get_int(), end.get_int(), step.get_int())};
+        if(passes == 0)
+            return;
+        TaggedValue last{results.back()};
+        results.insert(results.end(), passes, last);
+        counter = make_int(counter_after(counter.get_int(), passes, step.get_int()));
+    }
+};
+
+#endif
\ No newline at end of file
@@ -1,40 +1,228 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include "pseudo.h"
+#include "memo.h"
 #include "color.h"
 
 using time_point = std::chrono::steady_clock::time_point;
 
+struct ShellOptions {
+    bool alloc_stats{false};
+    bool vm{false};
+    bool time{false};
+    bool memo_stats{false};
+    bool quicken_stats{false};
+    bool emit_cpp{false};
+    bool compile{false};
+    bool lex_bench{false};
+    bool parse_bench{false};
+    size_t max_depth{VM::DEFAULT_MAX_DEPTH};
+};
+
+ShellOptions options;
+
+void PrintAllocStats(int64_t start_count) {
+    if(!options.alloc_stats) return;
+    std::cout << "Value allocations: " << Value::get_allocation_count() - start_count << "\n";
+}
+
+void PrintMemoStats() {
+    if(!options.memo_stats) return;
+    std::cout << "Memo hits: " << MemoCache::get_hits() << ", misses: " << MemoCache::get_misses() << "\n";
+}
+
+void PrintQuickenStats() {
+    if(!options.quicken_stats) return;
+    std::cout << "Node specializations: " << Interpreter::get_specializations()
+              << ", despecializations: " << Interpreter::get_despecializations() << "\n";
+}
+
+// The tree walker stays the default engine, --vm compiles to bytecode first.
+std::string RunWith(std::string file_name, std::string code, SymbolTable &global_symbol_table, VM &vm) {
+    if(options.vm)
+        return Run(file_name, code, vm);
+    return Run(file_name, code, global_symbol_table);
+}
+
 void RunShell(std::string file_name) {
     SymbolTable global_symbol_table;
+    VM vm(options.max_depth);
     while(true) {
         std::cout << Color(0x34, 0xD3, 0xDE) << "Pseudo >> " RESET;
         std::string input;
         std::getline(std::cin, input);
+        int64_t alloc_start{Value::get_allocation_count()};
         time_point start{std::chrono::steady_clock::now()};
-        std::cout << Run(file_name, input, global_symbol_table) << "\n";
+        std::cout << RunWith(file_name, input, global_symbol_table, vm) << "\n";
         time_point end{std::chrono::steady_clock::now()};
         int64_t time_cost{std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()};
         std::cout << "Execution time: " << time_cost << " ms\n";
+        PrintAllocStats(alloc_start);
+        PrintMemoStats();
+        PrintQuickenStats();
     }
 }
 
-void RunCode(std::string file_name, char *args[]) {
-    std::ifstream input(file_name);
-    std::string code, line;
-    while(std::getline(input, line)) {
-        code += line + "\n";
+// Read in one go, every line ends with a newline.
+std::string ReadSource(std::string file_name) {
+    std::ifstream input(file_name, std::ios::binary);
+    std::stringstream ss;
+    ss << input.rdbuf();
+    std::string code{ss.str()};
+    if(!code.empty() && code.back() != '\n')
+        code += '\n';
+    return code;
+}
+
+double MegabytesPerSecond(size_t bytes, time_point start, time_point end) {
+    double seconds{std::chrono::duration<double>(end - start).count()};
+    return bytes / 1e6 / seconds;
+}
+
+// Lexer throughput, next to a plain pass counting the newlines of the
+// same buffer, which is about as fast as memory can be read.
+int LexBench(std::string file_name) {
+    std::string code{ReadSource(file_name)};
+    time_point start{std::chrono::steady_clock::now()};
+    TokenStream stream{Lexer(file_name, code).lex()};
+    time_point end{std::chrono::steady_clock::now()};
+    if(stream.failed()) {
+        TokenList tokens{stream.to_token_list()};
+        std::cout << "Tokens: " << tokens << "\n";
+        return 1;
     }
+    time_point scan_start{std::chrono::steady_clock::now()};
+    size_t lines = std::count(code.begin(), code.end(), '\n');
+    time_point scan_end{std::chrono::steady_clock::now()};
+    std::cout << "Lexed " << stream.get_lexemes().size() << " tokens from " << lines << " lines, " << code.size() << " bytes in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us\n";
+    std::cout << "Lexer: " << MegabytesPerSecond(code.size(), start, end) << " MB/s, newline scan: "
+              << MegabytesPerSecond(code.size(), scan_start, scan_end) << " MB/s\n";
+    return 0;
+}
+
+// Parser throughput, lexing is not counted.
+int ParseBench(std::string file_name) {
+    std::string code{ReadSource(file_name)};
+    TokenStream stream{Lexer(file_name, code).lex()};
+    if(stream.failed()) {
+        TokenList tokens{stream.to_token_list()};
+        std::cout << "Tokens: " << tokens << "\n";
+        return 1;
+    }
+    time_point start{std::chrono::steady_clock::now()};
+    NodeList ast{Parser(stream).parse()};
+    time_point end{std::chrono::steady_clock::now()};
+    for(auto node : ast) {
+        if(node->get_kind() == NodeKind::Error) {
+            std::cout << "Nodes: " << node->get_node() << "\n";
+            return 1;
+        }
+    }
+    std::cout << "Parsed " << stream.get_lexemes().size() << " tokens into " << ast.size() << " statements in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us\n";
+    std::cout << "Parser: " << MegabytesPerSecond(code.size(), start, end) << " MB/s\n";
+    return 0;
+}
+
+// Writes script.cpp next to script.ps, and with --compile builds it into
+// script against the interpreter's library.
+int CompileCode(std::string file_name) {
+    std::string base{file_name};
+    if(base.size() > 3 && base.compare(base.size() - 3, 3, ".ps") == 0)
+        base.erase(base.size() - 3);
+    std::string cpp{Transpile(file_name, ReadSource(file_name))};
+    if(cpp.empty())
+        return 1;
+    std::ofstream output(base + ".cpp");
+    output << cpp;
+    output.close();
+    if(!options.compile)
+        return 0;
+    std::string command{"g++ -std=c++17 -O2 -I" PSEUDO_ROOT "/src \"" + base + ".cpp\" "
+        PSEUDO_ROOT "/build/libpseudo.a -o \"" + base + "\""};
+    return std::system(command.c_str()) == 0 ? 0 : 1;
+}
+
+void RunCode(std::string file_name) {
+    std::string code{ReadSource(file_name)};
     SymbolTable global_symbol_table;
-    Run(file_name, code, global_symbol_table);
+    VM vm(options.max_depth);
+    int64_t alloc_start{Value::get_allocation_count()};
+    time_point start{std::chrono::steady_clock::now()};
+    RunWith(file_name, code, global_symbol_table, vm);
+    time_point end{std::chrono::steady_clock::now()};
+    if(options.time) {
+        int64_t time_cost{std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()};
+        std::cout << "Execution time: " << time_cost << " us\n";
+    }
+    PrintAllocStats(alloc_start);
+    PrintMemoStats();
+    PrintQuickenStats();
 }
 
 int main(int argc, char *args[]) {
-    if(argc == 1) {
+    int arg_index{1};
+    for(; arg_index < argc && std::string(args[arg_index]).rfind("--", 0) == 0; ++arg_index) {
+        std::string flag{args[arg_index]};
+        if(flag == "--alloc-stats") {
+            options.alloc_stats = true;
+        } else if(flag == "--vm") {
+            options.vm = true;
+        } else if(flag == "--time") {
+            options.time = true;
+        } else if(flag == "--dump-ast") {
+            Optimizer::dump = true;
+        } else if(flag == "--emit-cpp") {
+            options.emit_cpp = true;
+        } else if(flag == "--compile") {
+            options.emit_cpp = options.compile = true;
+        } else if(flag == "--lex-bench") {
+            options.lex_bench = true;
+        } else if(flag == "--parse-bench") {
+            options.parse_bench = true;
+        } else if(flag == "--quicken-stats") {
+            options.quicken_stats = true;
+        } else if(flag == "--memo-stats") {
+            options.memo_stats = true;
+        } else if(flag.rfind("--memo-size=", 0) == 0) {
+            MemoCache::default_capacity = std::stoull(flag.substr(std::string("--memo-size=").size()));
+        } else if(flag.rfind("--max-depth=", 0) == 0) {
+            options.max_depth = std::stoull(flag.substr(std::string("--max-depth=").size()));
+        } else {
+            std::cout << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+    if(options.lex_bench) {
+        if(arg_index == argc) {
+            std::cout << "--lex-bench needs a script\n";
+            return 1;
+        }
+        return LexBench(args[arg_index]);
+    }
+    if(options.parse_bench) {
+        if(arg_index == argc) {
+            std::cout << "--parse-bench needs a script\n";
+            return 1;
+        }
+        return ParseBench(args[arg_index]);
+    }
+    if(options.emit_cpp) {
+        if(arg_index == argc) {
+            std::cout << "--emit-cpp and --compile need a script\n";
+            return 1;
+        }
+        return CompileCode(args[arg_index]);
+    }
+    if(arg_index == argc) {
         RunShell("stdin");
     } else {
-        RunCode(args[1], args + 1);
+        RunCode(args[arg_index]);
     }
     return 0;
 }
\ No newline at end of file
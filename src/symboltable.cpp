@@ -6,24 +6,67 @@
 #include "color.h"
 #include <memory>
 
-std::shared_ptr<Value> SymbolTable::get(std::string name) {
-    if(symbols.count(name) == 0){
-        if(parent != nullptr) {
-            return parent->get(name);
-        } else if(BUILTIN_ALGOS.count(name)) {
-            return BUILTIN_ALGOS.at(name);
-        } else {
-            return std::make_shared<ErrorValue>(
-                VALUE_ERROR, Color(0xFF, 0x39, 0x6E).get() + "Identifier: \""+ name +"\" has not defined\n" RESET);
-        }
+// A local that has not been assigned yet still reads through the callers.
+TaggedValue SymbolTable::get_local(int slot) {
+    if(!slots[slot].is_undefined())
+        return slots[slot];
+    return parent->lookup(layout->slot_names[slot]);
+}
+
+// A builtin is kept in the slot of its name once looked up. Reserved
+// names can never be assigned; a script that assigns `sum` or another
+// unreserved builtin name just replaces it.
+TaggedValue SymbolTable::get_global(int name) {
+    if(root != this)
+        return root->get_global(name);
+    if(static_cast<size_t>(name) < slots.size() && !slots[name].is_undefined())
+        return slots[name];
+    const std::string &var_name{names.names[name]};
+    if(BUILTIN_ALGOS.count(var_name)) {
+        set_global(name, BUILTIN_ALGOS.at(var_name));
+        return slots[name];
     }
-    return symbols[name];
+    return make_error(
+        Color(0xFF, 0x39, 0x6E).get() + "Identifier: \""+ var_name +"\" has not defined\n" RESET);
+}
+
+void SymbolTable::set_global(int name, TaggedValue value) {
+    if(root != this)
+        return root->set_global(name, std::move(value));
+    if(static_cast<size_t>(name) >= slots.size())
+        slots.resize(names.names.size(), TaggedValue::undefined());
+    slots[name] = std::move(value);
+}
+
+// Algorithms see the variables of whoever called them: the slots of each
+// calling scope are searched before the globals.
+TaggedValue SymbolTable::lookup(int name) {
+    if(!root->names.is_bound(name))
+        return root->get_global(name);
+    for(SymbolTable *table{this}; table != root; table = table->parent) {
+        int slot{table->layout->slot_of(name)};
+        if(slot >= 0 && !table->slots[slot].is_undefined())
+            return table->slots[slot];
+    }
+    return root->get_global(name);
+}
+
+SymbolTable& SymbolTable::push_frame(const FrameLayout *frame_layout) {
+    if(root->frame_depth == root->frames.size())
+        root->frames.push_back(std::make_unique<SymbolTable>());
+    SymbolTable &frame{*root->frames[root->frame_depth++]};
+    frame.reset(this, frame_layout);
+    return frame;
 }
 
-void SymbolTable::set(std::string name, std::shared_ptr<Value> value) {
-    symbols[name] = value;
+// Drops the values of the innermost call but keeps its storage.
+void SymbolTable::pop_frame() {
+    root->frames[--root->frame_depth]->slots.clear();
 }
 
-void SymbolTable::erase(std::string name) {
-    symbols.erase(name);
+void SymbolTable::reset(SymbolTable *_parent, const FrameLayout *_layout) {
+    parent = _parent;
+    root = _parent->root;
+    layout = _layout;
+    slots.assign(layout->slot_count(), TaggedValue::undefined());
 }
\ No newline at end of file
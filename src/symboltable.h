@@ -7,50 +7,190 @@
 
 #include "node.h"
 #include "value.h"
+#include "resolver.h"
 #include <map>
 #include <string>
 #include <memory>
 
-const std::map<std::string, std::shared_ptr<Value>> BUILTIN_ALGOS {
-    {"print", std::make_shared<BuiltinAlgoValue>("print", 
+const std::map<std::string, TaggedValue> BUILTIN_ALGOS {
+    {"print", make_boxed<BuiltinAlgoValue>("print", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "print"), 
         TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "s")}))}, 
-    {"read", std::make_shared<BuiltinAlgoValue>("read", 
+    {"read", make_boxed<BuiltinAlgoValue>("read", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "read"), 
         TokenList{}))},
-    {"read_line", std::make_shared<BuiltinAlgoValue>("read_line", 
+    {"read_line", make_boxed<BuiltinAlgoValue>("read_line", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "read_line"), 
         TokenList{}))},
-    {"open", std::make_shared<BuiltinAlgoValue>("open", 
+    {"open", make_boxed<BuiltinAlgoValue>("open", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "open"), 
         TokenList{}))},
-    {"clear", std::make_shared<BuiltinAlgoValue>("clear", 
+    {"clear", make_boxed<BuiltinAlgoValue>("clear", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "clear"), 
         TokenList{}))},
-    {"quit", std::make_shared<BuiltinAlgoValue>("quit", 
+    {"quit", make_boxed<BuiltinAlgoValue>("quit", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "quit"), 
         TokenList{}))},
-    {"int", std::make_shared<BuiltinAlgoValue>("int", 
+    {"int", make_boxed<BuiltinAlgoValue>("int", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "int"), 
         TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "n")}))}, 
-    {"float", std::make_shared<BuiltinAlgoValue>("float",
+    {"float", make_boxed<BuiltinAlgoValue>("float",
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "float"), 
         TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "n")}))}, 
-    {"string", std::make_shared<BuiltinAlgoValue>("string", 
+    {"string", make_boxed<BuiltinAlgoValue>("string", 
         std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "string"), 
         TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "s")}))}, 
+    // Not reserved words: a script may use these names for its own values.
+    {"array", make_boxed<BuiltinAlgoValue>("array",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "array"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "n"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "fill")}))},
+    {"sum", make_boxed<BuiltinAlgoValue>("sum",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "sum"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr")}))},
+    {"min_of", make_boxed<BuiltinAlgoValue>("min_of",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "min_of"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr")}))},
+    {"max_of", make_boxed<BuiltinAlgoValue>("max_of",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "max_of"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr")}))},
+    {"count", make_boxed<BuiltinAlgoValue>("count",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "count"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"index_of", make_boxed<BuiltinAlgoValue>("index_of",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "index_of"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"dot", make_boxed<BuiltinAlgoValue>("dot",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "dot"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "a"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "b")}))},
+    {"sort", make_boxed<BuiltinAlgoValue>("sort",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "sort"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "before")}), 1)},
+    {"reverse", make_boxed<BuiltinAlgoValue>("reverse",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "reverse"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr")}))},
+    {"lower_bound", make_boxed<BuiltinAlgoValue>("lower_bound",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "lower_bound"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"upper_bound", make_boxed<BuiltinAlgoValue>("upper_bound",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "upper_bound"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"unique", make_boxed<BuiltinAlgoValue>("unique",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "unique"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "arr")}))},
+    {"map", make_boxed<BuiltinAlgoValue>("map",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "map"),
+        TokenList{}))},
+    {"set", make_boxed<BuiltinAlgoValue>("set",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "set"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "from")}), 1)},
+    {"heap", make_boxed<BuiltinAlgoValue>("heap",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "heap"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "from")}), 1)},
+    {"deque", make_boxed<BuiltinAlgoValue>("deque",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "deque"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "from")}), 1)},
+    {"size", make_boxed<BuiltinAlgoValue>("size",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "size"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c")}))},
+    {"has", make_boxed<BuiltinAlgoValue>("has",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "has"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "key")}))},
+    {"insert", make_boxed<BuiltinAlgoValue>("insert",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "insert"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "s"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"remove", make_boxed<BuiltinAlgoValue>("remove",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "remove"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "key")}))},
+    {"keys", make_boxed<BuiltinAlgoValue>("keys",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "keys"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c")}))},
+    {"values", make_boxed<BuiltinAlgoValue>("values",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "values"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "m")}))},
+    {"push", make_boxed<BuiltinAlgoValue>("push",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "push"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "h"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "priority")}), 1)},
+    {"top", make_boxed<BuiltinAlgoValue>("top",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "top"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "h")}))},
+    {"pop", make_boxed<BuiltinAlgoValue>("pop",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "pop"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "h")}))},
+    {"push_front", make_boxed<BuiltinAlgoValue>("push_front",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "push_front"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "d"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"push_back", make_boxed<BuiltinAlgoValue>("push_back",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "push_back"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c"),
+        std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "x")}))},
+    {"front", make_boxed<BuiltinAlgoValue>("front",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "front"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "d")}))},
+    {"back", make_boxed<BuiltinAlgoValue>("back",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "back"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c")}))},
+    {"pop_front", make_boxed<BuiltinAlgoValue>("pop_front",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "pop_front"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "d")}))},
+    {"pop_back", make_boxed<BuiltinAlgoValue>("pop_back",
+        std::make_shared<AlgorithmDefNode>(std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "pop_back"),
+        TokenList{std::make_shared<TypedToken<std::string>>(TOKEN_STRING, Position(), "c")}))},
 };
 
+/// Variables of one scope. The global scope owns the names and an array
+/// indexed by them, an Algorithm call has the slots of its FrameLayout.
+/// Call scopes come from a pool kept by the global scope and are reused
+/// from one call to the next, so a call does not allocate once the pool
+/// is as deep as the recursion.
 class SymbolTable {
 public:
-    SymbolTable(SymbolTable *_parent = nullptr)
-        : parent(_parent) {}
-    std::shared_ptr<Value> get(std::string);
-    void set(std::string, std::shared_ptr<Value>);
-    void erase(std::string);
+    SymbolTable()
+        : parent(nullptr), root(this), layout(nullptr), frame_depth(0) {}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    TaggedValue get_local(int slot);
+    void set_local(int slot, TaggedValue value) { slots[slot] = std::move(value);}
+    ValueSpan get_slots(size_t count) { return ValueSpan{slots.data(), count};}
+    TaggedValue get_global(int name);
+    // The value in a slot, null while it is undefined.
+    const TaggedValue* find_local(int slot) const {
+        return slots[slot].is_undefined() ? nullptr : &slots[slot];
+    }
+    const TaggedValue* find_global(int name) const {
+        const ValueList &globals{root->slots};
+        return static_cast<size_t>(name) < globals.size() && !globals[name].is_undefined() ? &globals[name] : nullptr;
+    }
+    void set_global(int name, TaggedValue);
+    TaggedValue lookup(int name);
+    NameTable& get_names() { return root->names;}
+    // Whether no callee could read this call scope, so that a tail call can
+    // replace it.
+    bool hidden_from_callees() const { return layout != nullptr && root->names.hides(*layout);}
+    // A scope for a call made from this one, released by pop_frame.
+    SymbolTable& push_frame(const FrameLayout*);
+    void pop_frame();
 protected:
-    std::map<std::string, std::shared_ptr<Value>> symbols;
-    SymbolTable *parent;
+    void reset(SymbolTable*, const FrameLayout*);
+
+    SymbolTable *parent, *root;
+    const FrameLayout *layout;
+    ValueList slots;
+    NameTable names;
+    std::vector<std::unique_ptr<SymbolTable>> frames;
+    size_t frame_depth;
 };
 
 #endif
\ No newline at end of file
@@ -4,14 +4,93 @@
 
 #include "token.h"
 #include "color.h"
+#include "lexer.h"
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <map>
 
 // template class TypedToken<double>;
 // template class TypedToken<int64_t>;
 // template class TypedToken<std::string>;
 
+// Literals rather than the TOKEN_* constants: tokens are also built during
+// static initialization, before those constants may exist.
+TokenKind to_token_kind(const std::string &type) {
+    static const std::map<std::string, TokenKind> kinds{
+        {"KEYWORD", TokenKind::Keyword}, {"IDENTIFIER", TokenKind::Identifier},
+        {"ASSIGN", TokenKind::Assign}, {"BICONST", TokenKind::BuiltinConst},
+        {"BIALGO", TokenKind::BuiltinAlgo}, {"INT", TokenKind::Int},
+        {"FLOAT", TokenKind::Float}, {"ADD", TokenKind::Add},
+        {"SUB", TokenKind::Sub}, {"MUL", TokenKind::Mul},
+        {"DIV", TokenKind::Div}, {"MOD", TokenKind::Mod},
+        {"POW", TokenKind::Pow}, {"LPAREN", TokenKind::LeftParen},
+        {"RPAREN", TokenKind::RightParen}, {"EQUAL", TokenKind::Equal},
+        {"NEQ", TokenKind::Neq}, {"LESS", TokenKind::Less},
+        {"GREATER", TokenKind::Greater}, {"LEQ", TokenKind::Leq},
+        {"GEQ", TokenKind::Geq}, {"COMMA", TokenKind::Comma},
+        {"COLON", TokenKind::Colon}, {"ARGS", TokenKind::Args},
+        {"STR", TokenKind::String}, {"LBRACE", TokenKind::LeftBrace},
+        {"RBRACE", TokenKind::RightBrace}, {"LSQUARE", TokenKind::LeftSquare},
+        {"RSQUARE", TokenKind::RightSquare}, {"DOT", TokenKind::Dot},
+        {"ERROR", TokenKind::Error}, {"NEWL", TokenKind::Newline},
+        {"SEMIC", TokenKind::Semicolon}, {"TAB", TokenKind::Tab}
+    };
+    auto it = kinds.find(type);
+    return it == kinds.end() ? TokenKind::None : it->second;
+}
+
+// Builtin constants and Algorithms are reserved words too, but not
+// keywords.
+TokenKind to_keyword_kind(std::string_view keyword) {
+    const ReservedWord *word{find_reserved_word(keyword)};
+    if(word == nullptr || word->kind == TokenKind::BuiltinConst || word->kind == TokenKind::BuiltinAlgo)
+        return TokenKind::Keyword;
+    return word->kind;
+}
+
+// Every keyword kind is of the KEYWORD type.
+const std::string& token_type(TokenKind kind) {
+    switch(kind) {
+        case TokenKind::Identifier: return TOKEN_IDENTIFIER;
+        case TokenKind::Assign: return TOKEN_ASSIGN;
+        case TokenKind::BuiltinConst: return TOKEN_BUILTIN_CONST;
+        case TokenKind::BuiltinAlgo: return TOKEN_BUILTIN_ALGO;
+        case TokenKind::Int: return TOKEN_INT;
+        case TokenKind::Float: return TOKEN_FLOAT;
+        case TokenKind::Add: return TOKEN_ADD;
+        case TokenKind::Sub: return TOKEN_SUB;
+        case TokenKind::Mul: return TOKEN_MUL;
+        case TokenKind::Div: return TOKEN_DIV;
+        case TokenKind::Mod: return TOKEN_MOD;
+        case TokenKind::Pow: return TOKEN_POW;
+        case TokenKind::LeftParen: return TOKEN_LEFT_PAREN;
+        case TokenKind::RightParen: return TOKEN_RIGHT_PAREN;
+        case TokenKind::Equal: return TOKEN_EQUAL;
+        case TokenKind::Neq: return TOKEN_NEQ;
+        case TokenKind::Less: return TOKEN_LESS;
+        case TokenKind::Greater: return TOKEN_GREATER;
+        case TokenKind::Leq: return TOKEN_LEQ;
+        case TokenKind::Geq: return TOKEN_GEQ;
+        case TokenKind::Comma: return TOKEN_COMMA;
+        case TokenKind::Colon: return TOKEN_COLON;
+        case TokenKind::Args: return TOKEN_ARGS;
+        case TokenKind::String: return TOKEN_STRING;
+        case TokenKind::LeftBrace: return TOKEN_LEFT_BRACE;
+        case TokenKind::RightBrace: return TOKEN_RIGHT_BRACE;
+        case TokenKind::LeftSquare: return TOKEN_LEFT_SQUARE;
+        case TokenKind::RightSquare: return TOKEN_RIGHT_SQUARE;
+        case TokenKind::Dot: return TOKEN_DOT;
+        case TokenKind::Error: return TOKEN_ERROR;
+        case TokenKind::Newline: return TOKEN_NEWLINE;
+        case TokenKind::Semicolon: return TOKEN_SEMICOLON;
+        case TokenKind::Tab: return TOKEN_TAB;
+        case TokenKind::None: return TOKEN_NONE;
+        default: return TOKEN_KEYWORD;
+    }
+}
+
 std::string Token::get_tok() {
     return type;
 }
@@ -61,4 +140,59 @@ std::string TypedToken<T>::get_value() {
     std::string ret;
     std::getline(ss, ret);
     return ret;
+}
+
+/// --------------------
+/// TokenStream
+/// --------------------
+
+void TokenStream::fail(size_t offset, const std::string &message) {
+    lexemes.clear();
+    push(TokenKind::Error, offset, 0);
+    error = message;
+}
+
+// Lines are only counted up to where lexing stopped.
+Position TokenStream::position(size_t offset) const {
+    auto it = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    int line(it - line_starts.begin() - 1);
+    return Position(offset, line, offset - line_starts[line], file);
+}
+
+// Numbers and strings get their value only here, the lexer just checked
+// they have one.
+std::shared_ptr<Token> TokenStream::to_token(const Lexeme &lexeme) const {
+    Position pos{position(lexeme.offset)};
+    std::string_view lexeme_text{text(lexeme)};
+    switch(lexeme.kind) {
+        case TokenKind::Int:
+            return std::make_shared<TypedToken<int64_t>>(lexeme.kind, pos, std::stoll(std::string(lexeme_text)));
+        case TokenKind::Float:
+            return std::make_shared<TypedToken<double>>(lexeme.kind, pos, std::stod(std::string(lexeme_text)));
+        case TokenKind::String: {
+            std::string value;
+            for(size_t i{1}; i + 1 < lexeme_text.size(); ++i) {
+                if(lexeme_text[i] == '\\')
+                    value += ESCAPE_CHARS[static_cast<uint8_t>(lexeme_text[++i])];
+                else
+                    value += lexeme_text[i];
+            }
+            return std::make_shared<TypedToken<std::string>>(lexeme.kind, pos, value);
+        }
+        case TokenKind::Error:
+            return std::make_shared<ErrorToken>(lexeme.kind, pos, error);
+        default:
+            // Words keep their text, any other token is told by its kind.
+            if(is_char_class(lexeme_text[0], CHAR_ALPHA))
+                return std::make_shared<TypedToken<std::string>>(lexeme.kind, pos, std::string(lexeme_text));
+            return std::make_shared<Token>(lexeme.kind, pos);
+    }
+}
+
+TokenList TokenStream::to_token_list() const {
+    TokenList tokens;
+    tokens.reserve(lexemes.size());
+    for(const Lexeme &lexeme : lexemes)
+        tokens.push_back(to_token(lexeme));
+    return tokens;
 }
\ No newline at end of file
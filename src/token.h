@@ -6,8 +6,11 @@
 #define TOKEN_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <type_traits>
 #include "position.h"
 
 // Builtin
@@ -55,12 +58,32 @@ const std::string TOKEN_SEMICOLON{"SEMIC"};
 const std::string TOKEN_TAB{"TAB"};
 const std::string TOKEN_NONE{"NONE"};
 
+// Keywords share the KEYWORD type string but each get their own kind.
+enum class TokenKind : uint8_t {
+    None, Keyword, Identifier, Assign, BuiltinConst, BuiltinAlgo,
+    Int, Float,
+    Add, Sub, Mul, Div, Mod, Pow, LeftParen, RightParen,
+    Equal, Neq, Less, Greater, Leq, Geq,
+    Comma, Colon, Args, String,
+    LeftBrace, RightBrace, LeftSquare, RightSquare, Dot,
+    Error, Newline, Semicolon, Tab,
+    And, Or, Not, For, To, Step, While, Do, Repeat, Until,
+    If, Then, Else, Algorithm, Continue, Break
+};
+
+TokenKind to_token_kind(const std::string &type);
+TokenKind to_keyword_kind(std::string_view keyword);
+const std::string& token_type(TokenKind kind);
+
 class Token {
 public:
     Token(const std::string& _type = TOKEN_NONE, Position _pos = Position())
-        : type(_type), pos(_pos) {}
+        : type(_type), pos(_pos), kind(to_token_kind(_type)) {}
+    Token(TokenKind _kind, Position _pos)
+        : type(token_type(_kind)), pos(_pos), kind(_kind) {}
     virtual std::string get_tok();
     virtual std::string get_type();
+    TokenKind get_kind() const { return kind;}
     virtual std::string get_value() { return "";}
     virtual Position get_pos() { return pos;}
     virtual inline bool isnumber() { return false;}
@@ -68,13 +91,20 @@ public:
 protected:
     std::string type;
     Position pos;
+    TokenKind kind;
 };
 
 template<typename T>
 class TypedToken: public Token {
 public:
-    TypedToken(const std::string& _type, const Position &_pos, const T &_value) 
-        : Token(_type, _pos), value(_value) {}
+    TypedToken(const std::string& _type, const Position &_pos, const T &_value)
+        : Token(_type, _pos), value(_value) {
+        if constexpr(std::is_same_v<T, std::string>) {
+            if(kind == TokenKind::Keyword) kind = to_keyword_kind(value);
+        }
+    }
+    TypedToken(TokenKind _kind, const Position &_pos, const T &_value)
+        : Token(_kind, _pos), value(_value) {}
     virtual std::string get_tok();
     virtual std::string get_value();
     virtual inline bool isnumber() { return type == TOKEN_INT || type == TOKEN_FLOAT;}
@@ -87,6 +117,42 @@ using ErrorToken = TypedToken<std::string>;
 using ArgsToken = TypedToken<TokenList>;
 std::ostream& operator<<(std::ostream &out, TokenList &tokens);
 
+/// A token as Lexer leaves it, its text is the span of the source it was
+/// read from.
+struct Lexeme {
+    TokenKind kind;
+    uint32_t offset, length;
+};
+
+/// All tokens of a source, in order, in one vector. Text and positions are
+/// looked up in the source, which has to outlive the stream. A failed lex
+/// leaves a single Error lexeme.
+class TokenStream {
+public:
+    TokenStream(std::string_view _source, uint16_t _file)
+        : source(_source), file(_file), line_starts{0} {}
+    void push(TokenKind kind, size_t offset, size_t length) {
+        lexemes.push_back(Lexeme{kind, uint32_t(offset), uint32_t(length)});
+    }
+    void new_line(size_t offset) { line_starts.push_back(offset);}
+    void reserve(size_t n) { lexemes.reserve(n);}
+    void fail(size_t offset, const std::string &message);
+
+    const std::vector<Lexeme>& get_lexemes() const { return lexemes;}
+    std::string_view text(const Lexeme &lexeme) const { return source.substr(lexeme.offset, lexeme.length);}
+    Position position(size_t offset) const;
+    bool failed() const { return !lexemes.empty() && lexemes[0].kind == TokenKind::Error;}
+
+    std::shared_ptr<Token> to_token(const Lexeme&) const;
+    TokenList to_token_list() const;
+protected:
+    std::string_view source;
+    uint16_t file;
+    std::vector<Lexeme> lexemes;
+    std::vector<uint32_t> line_starts;
+    std::string error;
+};
+
 template class TypedToken<double>;
 template class TypedToken<int64_t>;
 template class TypedToken<std::string>;
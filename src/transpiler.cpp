@@ -0,0 +1,410 @@
+/// --------------------
+/// Transpiler
+/// --------------------
+
+#include "transpiler.h"
+#include "optimizer.h"
+#include "symboltable.h"
+#include "value.h"
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+static std::string quote(const std::string &text) {
+    std::string ret{"\""};
+    for(unsigned char c : text) {
+        if(c == '\\' || c == '"') {
+            ret += '\\';
+            ret += c;
+        } else if(c < 0x20 || c >= 0x7F) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\%03o", c);
+            ret += escaped;
+        } else {
+            ret += c;
+        }
+    }
+    return ret + "\"";
+}
+
+static std::string join(const std::vector<int> &values) {
+    std::string ret;
+    for(size_t i{0}; i < values.size(); ++i)
+        ret += (i ? ", " : "") + std::to_string(values[i]);
+    return ret;
+}
+
+// Constants and variable reads have no side effects, so they can be passed
+// straight as arguments whatever order C++ evaluates them in.
+static bool is_simple(std::shared_ptr<Node> node) {
+    return node->get_kind() == NodeKind::Const || node->get_kind() == NodeKind::VarAccess;
+}
+
+static const char* op_code_name(TokenKind kind) {
+    switch(kind) {
+        case TokenKind::Add: return "OpCode::Add";
+        case TokenKind::Sub: return "OpCode::Sub";
+        case TokenKind::Mul: return "OpCode::Mul";
+        case TokenKind::Div: return "OpCode::Div";
+        case TokenKind::Mod: return "OpCode::Mod";
+        case TokenKind::Pow: return "OpCode::Pow";
+        case TokenKind::Equal: return "OpCode::Equal";
+        case TokenKind::Neq: return "OpCode::Neq";
+        case TokenKind::Less: return "OpCode::Less";
+        case TokenKind::Greater: return "OpCode::Greater";
+        case TokenKind::Leq: return "OpCode::Leq";
+        case TokenKind::Geq: return "OpCode::Geq";
+        case TokenKind::And: return "OpCode::And";
+        case TokenKind::Or: return "OpCode::Or";
+        default: return nullptr;
+    }
+}
+
+std::string Transpiler::transpile(const NodeList &program) {
+    std::string main_body;
+    for(auto &node : program) {
+        main_body += "    result = " + emit(node) + ";\n";
+        main_body += "    if(result.is_error()) {\n"
+                     "        std::cout << result.get_num() << \"\\n\";\n"
+                     "        return 0;\n"
+                     "    }\n";
+    }
+
+    std::stringstream ss;
+    ss << "// Generated from a Pseudo script, do not edit.\n"
+       << "#include \"runtime.h\"\n\n";
+    ss << "static const char *const names[] = {";
+    for(size_t i{0}; i < names.names.size(); ++i)
+        ss << (i ? ", " : "") << quote(names.names[i]);
+    if(names.names.empty())
+        ss << "\"\"";
+    ss << "};\n\n";
+    for(auto &layout : layouts)
+        ss << layout;
+    ss << "static TaggedValue constants[] = {\n";
+    for(auto &constant : constants)
+        ss << "    " << constant << ",\n";
+    if(constants.empty())
+        ss << "    TaggedValue()\n";
+    ss << "};\n\n";
+    for(auto &declaration : declarations)
+        ss << declaration;
+    ss << "\n";
+    for(auto &function : functions)
+        ss << function << "\n";
+    ss << "int main() {\n"
+       << "    native_program.names = names;\n"
+       << "    native_program.globals.assign(" << names.names.size() << ", TaggedValue::undefined());\n"
+       << "    NativeFrame *frame{nullptr};\n"
+       << "    (void)frame;\n"
+       << "    TaggedValue result;\n"
+       << main_body
+       << "    return 0;\n"
+       << "}\n";
+    return ss.str();
+}
+
+std::string Transpiler::emit(std::shared_ptr<Node> node) {
+    switch(node->get_kind()) {
+        case NodeKind::Const: return emit_const(node);
+        case NodeKind::VarAccess: return emit_var_access(node);
+        case NodeKind::VarAssign: return emit_var_assign(node);
+        case NodeKind::BinOp: return emit_bin_op(node);
+        case NodeKind::UnaryOp: return emit_unary_op(node);
+        case NodeKind::If: return emit_if(node);
+        case NodeKind::For: return emit_for(node);
+        case NodeKind::While: return emit_while(node);
+        case NodeKind::Repeat: return emit_repeat(node);
+        case NodeKind::AlgoDef: return emit_algo_def(node);
+        case NodeKind::AlgoCall: return emit_algo_call(node);
+        case NodeKind::Array: return emit_array(node);
+        case NodeKind::ArrAccess: return emit_array_access(node);
+        case NodeKind::ArrAssign: return emit_array_assign(node);
+        default: break;
+    }
+    return "make_error(\"Fail to get result\\n\")";
+}
+
+std::string Transpiler::add_constant(const std::string &init) {
+    constants.push_back(init);
+    return "constants[" + std::to_string(constants.size() - 1) + "]";
+}
+
+std::string Transpiler::emit_const(std::shared_ptr<Node> node) {
+    const TaggedValue &value{static_cast<ConstNode*>(node.get())->get_value()};
+    switch(value.get_kind()) {
+        case ValueKind::Int:
+            if(value.get_int() == INT64_MIN)
+                return "make_int(INT64_MIN)";
+            return "make_int(" + std::to_string(value.get_int()) + "LL)";
+        case ValueKind::Float: {
+            double number{value.get_float()};
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            return "native_float(" + std::to_string(bits) + "ULL)";
+        }
+        case ValueKind::Str:
+            return add_constant("make_string(" + quote(value.get_num()) + ")");
+        default:
+            return "TaggedValue()";
+    }
+}
+
+std::string Transpiler::emit_var_access(std::shared_ptr<Node> node) {
+    VarAccessNode *var = static_cast<VarAccessNode*>(node.get());
+    if(node->get_tok()->get_kind() == TokenKind::BuiltinAlgo && BUILTIN_ALGOS.count(var->get_name()))
+        return add_constant("BUILTIN_ALGOS.at(" + quote(var->get_name()) + ")");
+    switch(var->get_scope()) {
+        case VarScope::Local: return "native_local(frame, " + std::to_string(var->get_index()) + ")";
+        case VarScope::Global: return "native_global(" + std::to_string(var->get_index()) + ")";
+        case VarScope::Dynamic:
+            // The whole program is known, a name no Algorithm binds is a global.
+            if(!names.is_bound(var->get_index()))
+                return "native_global(" + std::to_string(var->get_index()) + ")";
+            return "native_lookup(frame->caller, " + std::to_string(var->get_index()) + ")";
+        default: break;
+    }
+    return "make_error(" + quote("Identifier: \"" + var->get_name() + "\" was not resolved\n") + ")";
+}
+
+// Resolver makes every assigned name either a global or a local.
+std::string Transpiler::store(VarScope scope, int index, const std::string &value) {
+    if(scope == VarScope::Global)
+        return "native_set_global(" + std::to_string(index) + ", " + value + ")";
+    return "native_set_local(frame, " + std::to_string(index) + ", " + value + ")";
+}
+
+std::string Transpiler::emit_var_assign(std::shared_ptr<Node> node) {
+    VarAssignNode *var = static_cast<VarAssignNode*>(node.get());
+    return store(var->get_scope(), var->get_index(), emit(node->get_child()[0]));
+}
+
+std::string Transpiler::emit_bin_op(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    const char *op{op_code_name(node->get_tok()->get_kind())};
+    if(op == nullptr)
+        return "make_error(\"Not a binary op\\n\")";
+    // The right side only runs when the left one does not decide.
+    TokenKind kind{node->get_tok()->get_kind()};
+    if(kind == TokenKind::And || kind == TokenKind::Or) {
+        std::string decided{kind == TokenKind::And ? "false" : "true"};
+        return "[&]() -> TaggedValue {\n"
+               "TaggedValue a{" + emit(child[0]) + "};\n"
+               "if(a.is_error()) return a;\n"
+               "if(is_truthy(a) == " + decided + ") return make_int(" + decided + ");\n"
+               "TaggedValue b{" + emit(child[1]) + "};\n"
+               "if(b.is_error()) return b;\n"
+               "return make_int(is_truthy(b));\n"
+               "}()";
+    }
+    if(is_simple(child[0]) && is_simple(child[1]))
+        return std::string("binary_op(") + op + ", " + emit(child[0]) + ", " + emit(child[1]) + ")";
+    return "[&]() -> TaggedValue {\n"
+           "TaggedValue a{" + emit(child[0]) + "};\n"
+           "TaggedValue b{" + emit(child[1]) + "};\n"
+           "return binary_op(" + op + ", a, b);\n"
+           "}()";
+}
+
+std::string Transpiler::emit_unary_op(std::shared_ptr<Node> node) {
+    std::string operand{emit(node->get_child()[0])};
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Add: return operand;
+        case TokenKind::Sub: return "native_negate(" + operand + ")";
+        case TokenKind::Not: return "native_not(" + operand + ")";
+        default: break;
+    }
+    return "make_error(\"Not an unary op\\n\")";
+}
+
+// Braced lists are evaluated left to right.
+std::string Transpiler::emit_array(std::shared_ptr<Node> node) {
+    std::string ret{"native_array({"};
+    const NodeList &child{node->get_child()};
+    for(size_t i{0}; i < child.size(); ++i)
+        ret += (i ? ", " : "") + emit(child[i]);
+    return ret + "})";
+}
+
+std::string Transpiler::emit_array_access(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    if(is_simple(child[0]) && is_simple(child[1]))
+        return "native_array_get(" + emit(child[0]) + ", " + emit(child[1]) + ")";
+    return "[&]() -> TaggedValue {\n"
+           "TaggedValue arr{" + emit(child[0]) + "};\n"
+           "TaggedValue index{" + emit(child[1]) + "};\n"
+           "return native_array_get(arr, index);\n"
+           "}()";
+}
+
+std::string Transpiler::emit_array_assign(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    if(child[0]->get_kind() != NodeKind::ArrAccess)
+        return "make_error(\"Access can only apply on array\\n\")";
+    const NodeList &target{child[0]->get_child()};
+    return "[&]() -> TaggedValue {\n"
+           "TaggedValue arr{" + emit(target[0]) + "};\n"
+           "TaggedValue index{" + emit(target[1]) + "};\n"
+           "TaggedValue value{" + emit(child[1]) + "};\n"
+           "return native_array_set(arr, index, value);\n"
+           "}()";
+}
+
+// Statements of an if branch; a failing one ends the whole if.
+std::string Transpiler::emit_branch(NodeSpan body) {
+    std::string ret{"TaggedValue ret;\n"};
+    for(auto &stmt : body) {
+        ret += "ret = " + emit(stmt) + ";\n"
+               "if(ret.is_error()) return ret;\n";
+    }
+    return ret + "return ret;\n";
+}
+
+std::string Transpiler::emit_if(std::shared_ptr<Node> node) {
+    IfNode* if_node = static_cast<IfNode*>(node.get());
+    std::string ret{"[&]() -> TaggedValue {\n"
+        "TaggedValue cond{" + emit(if_node->get_condition()) + "};\n"
+        "if(cond.is_error()) return cond;\n"
+        "if(as_integer(cond) == 1) {\n" + emit_branch(if_node->get_expr()) + "}\n"};
+    if(!if_node->get_else().empty())
+        ret += "{\n" + emit_branch(if_node->get_else()) + "}\n";
+    else
+        ret += "return make_int(0);\n";
+    return ret + "}()";
+}
+
+// A loop with a single statement collects its results, unless its value is
+// unused. A failing statement ends the loop with the error as its value.
+std::string Transpiler::emit_loop_body(NodeSpan body, bool collect) {
+    std::string ret;
+    for(auto &stmt : body) {
+        if(collect) {
+            ret += "results.push_back(" + emit(stmt) + ");\n"
+                   "if(results.back().is_error()) return results.back();\n";
+        } else {
+            ret += "{\nTaggedValue ret{" + emit(stmt) + "};\n"
+                   "if(ret.is_error()) return ret;\n}\n";
+        }
+    }
+    return ret;
+}
+
+// The counter is kept apart from the variable, the body may assign the
+// variable without changing how many times the loop runs.
+std::string Transpiler::emit_for(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 3);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    VarAssignNode *var = static_cast<VarAssignNode*>(child[0].get());
+    std::string ret{"[&]() -> TaggedValue {\n"
+        "NativeForLoop loop;\n"
+        "loop.counter = " + emit(child[0]) + ";\n"
+        "if(loop.counter.is_error()) return loop.counter;\n"
+        "loop.step = " + (child[2] != nullptr ? emit(child[2]) : std::string("make_int(1)")) + ";\n"
+        "if(loop.step.is_error()) return loop.step;\n"
+        "loop.end = " + emit(child[1]) + ";\n"
+        "if(loop.end.is_error()) return loop.end;\n"
+        "if(!loop.prepare()) return make_error(\"Infinite for loop\\n\");\n"
+        "ValueList results;\n"
+        "while(loop.test()) {\n" + emit_loop_body(body, collect)};
+    if(collect && body[0]->get_kind() == NodeKind::Const)
+        ret += "loop.fill(results);\n";
+    if(var->get_scope() == VarScope::Global)
+        ret += "native_program.globals[" + std::to_string(var->get_index()) + "] = loop.advance();\n";
+    else
+        ret += "frame->slots[" + std::to_string(var->get_index()) + "] = loop.advance();\n";
+    ret += "}\n";
+    if(!node->is_value_used())
+        ret += "return TaggedValue();\n";
+    else if(collect)
+        ret += "return make_boxed<ArrayValue>(std::move(results));\n";
+    else
+        ret += "return native_array({TaggedValue()});\n";
+    return ret + "}()";
+}
+
+std::string Transpiler::emit_while(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 1);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    return "[&]() -> TaggedValue {\n"
+        "ValueList results;\n"
+        "while(true) {\n"
+        "TaggedValue cond{" + emit(child[0]) + "};\n"
+        "if(cond.is_error()) return cond;\n"
+        "if(as_integer(cond) != 1) break;\n" + emit_loop_body(body, collect) + "}\n"
+        + (node->is_value_used() ? "return make_boxed<ArrayValue>(std::move(results));\n" : "return TaggedValue();\n")
+        + "}()";
+}
+
+std::string Transpiler::emit_repeat(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 1);
+    bool collect{body.size() == 1 && node->is_value_used()};
+    return "[&]() -> TaggedValue {\n"
+        "ValueList results;\n"
+        "while(true) {\n" + emit_loop_body(body, collect) +
+        "TaggedValue cond{" + emit(child[0]) + "};\n"
+        "if(cond.is_error()) return cond;\n"
+        "if(as_integer(cond) != 0) break;\n"
+        "}\n"
+        + (node->is_value_used() ? "return make_boxed<ArrayValue>(std::move(results));\n" : "return TaggedValue();\n")
+        + "}()";
+}
+
+// The body runs to its end even when a statement fails, and the last
+// statement is the result. A pure `memo` Algorithm looks its arguments up
+// first.
+std::string Transpiler::emit_algo_def(std::shared_ptr<Node> node) {
+    AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+    const FrameLayout &layout{*algo_def->get_layout()};
+    std::string id{std::to_string(functions.size())};
+    functions.emplace_back();
+    layouts.push_back("static const FrameLayout layout_" + id + "{" + std::to_string(layout.param_count)
+        + ", {" + join(layout.slot_names) + "}, {" + join(layout.name_slots) + "}};\n");
+    declarations.push_back("static TaggedValue algo_" + id + "(NativeFrame *caller, ValueSpan args);\n");
+    bool memo{algo_def->get_memo_cache() != nullptr};
+    if(memo)
+        declarations.push_back("static MemoCache memo_" + id + ";\n");
+
+    std::string function{"// " + node->get_name() + "\n"
+        "static TaggedValue algo_" + id + "(NativeFrame *caller, ValueSpan args) {\n"};
+    if(memo) {
+        function += "    std::string key;\n"
+                    "    bool cacheable{MemoCache::make_key(args, key)};\n"
+                    "    TaggedValue cached;\n"
+                    "    if(cacheable && memo_" + id + ".find(key, cached)) return cached;\n";
+    }
+    function += "    TaggedValue slots[" + std::to_string(std::max(layout.slot_count(), 1)) + "];\n"
+                "    for(auto &slot : slots) slot = TaggedValue::undefined();\n"
+                "    for(size_t i{0}; i < args.size(); ++i) slots[i] = args[i];\n"
+                "    NativeFrame self{&layout_" + id + ", caller, slots};\n"
+                "    NativeFrame *frame{&self};\n"
+                "    TaggedValue ret;\n";
+    for(auto &stmt : algo_def->get_body())
+        function += "    ret = " + emit(stmt) + ";\n";
+    if(memo)
+        function += "    if(cacheable) memo_" + id + ".insert(key, ret);\n";
+    function += "    return ret;\n}\n";
+    functions[std::stoi(id)] = function;
+
+    return store(algo_def->get_scope(), algo_def->get_index(),
+        "make_boxed<NativeAlgoValue>(" + quote(node->get_name()) + ", "
+        + std::to_string(node->get_toks().size()) + ", &algo_" + id + ")");
+}
+
+std::string Transpiler::emit_algo_call(std::shared_ptr<Node> node) {
+    AlgorithmCallNode *algo_call_node = static_cast<AlgorithmCallNode*>(node.get());
+    const NodeList &args{algo_call_node->get_args()};
+    std::string ret{"[&]() -> TaggedValue {\n"
+        "TaggedValue callee{" + emit(algo_call_node->get_call()) + "};\n"};
+    if(args.empty())
+        return ret + "return native_call(frame, callee, ValueSpan{nullptr, 0});\n}()";
+    ret += "TaggedValue args[] = {";
+    for(size_t i{0}; i < args.size(); ++i)
+        ret += (i ? ", " : "") + emit(args[i]);
+    return ret + "};\n"
+        "return native_call(frame, callee, ValueSpan{args, " + std::to_string(args.size()) + "});\n}()";
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/// --------------------
+/// Transpiler
+/// --------------------
+
+#ifndef TRANSPILER_H
+#define TRANSPILER_H
+
+#include "node.h"
+#include "resolver.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Writes a C++17 translation unit for the NodeList returned by
+/// Parser::parse(), after Optimizer and Resolver. Every Algorithm becomes a
+/// function, every node an expression giving the TaggedValue
+/// Interpreter::visit would return, on top of runtime.h.
+class Transpiler {
+public:
+    Transpiler(NameTable &_names)
+        : names(_names) {}
+    std::string transpile(const NodeList &program);
+
+protected:
+    std::string emit(std::shared_ptr<Node>);
+    std::string emit_const(std::shared_ptr<Node>);
+    std::string emit_var_access(std::shared_ptr<Node>);
+    std::string emit_var_assign(std::shared_ptr<Node>);
+    std::string emit_bin_op(std::shared_ptr<Node>);
+    std::string emit_unary_op(std::shared_ptr<Node>);
+    std::string emit_array(std::shared_ptr<Node>);
+    std::string emit_array_access(std::shared_ptr<Node>);
+    std::string emit_array_assign(std::shared_ptr<Node>);
+    std::string emit_if(std::shared_ptr<Node>);
+    std::string emit_for(std::shared_ptr<Node>);
+    std::string emit_while(std::shared_ptr<Node>);
+    std::string emit_repeat(std::shared_ptr<Node>);
+    std::string emit_algo_def(std::shared_ptr<Node>);
+    std::string emit_algo_call(std::shared_ptr<Node>);
+
+    std::string emit_branch(NodeSpan);
+    std::string emit_loop_body(NodeSpan, bool collect);
+    std::string store(VarScope, int index, const std::string &value);
+    std::string add_constant(const std::string &init);
+
+    NameTable &names;
+    std::vector<std::string> constants, layouts, declarations, functions;
+};
+
+#endif
\ No newline at end of file
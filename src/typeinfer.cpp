@@ -0,0 +1,241 @@
+/// --------------------
+/// TypeInference
+/// --------------------
+
+#include "typeinfer.h"
+#include "optimizer.h"
+#include "value.h"
+
+TypeInference::TypeInference(const FrameLayout &layout, const std::vector<StaticType> &params)
+    : env(layout.slot_count(), StaticType::Undefined) {
+    for(size_t i{0}; i < params.size() && i < env.size(); ++i)
+        env[i] = params[i];
+}
+
+void TypeInference::infer(const NodeList &body) {
+    for(auto &stmt : body)
+        infer(stmt);
+}
+
+StaticType TypeInference::type_of(const Node *node) const {
+    auto it = types.find(node);
+    return it == types.end() ? StaticType::Unknown : it->second;
+}
+
+static bool is_number(StaticType type) {
+    return type == StaticType::Int || type == StaticType::Float;
+}
+
+StaticType TypeInference::infer(std::shared_ptr<Node> node) {
+    switch(node->get_kind()) {
+        case NodeKind::Const: {
+            ValueKind kind{static_cast<ConstNode*>(node.get())->get_value().get_kind()};
+            if(kind == ValueKind::Int) return record(node.get(), StaticType::Int);
+            if(kind == ValueKind::Float) return record(node.get(), StaticType::Float);
+            return record(node.get(), StaticType::Unknown);
+        }
+        case NodeKind::Value:
+            if(node->get_tok()->get_kind() == TokenKind::Int) return record(node.get(), StaticType::Int);
+            if(node->get_tok()->get_kind() == TokenKind::Float) return record(node.get(), StaticType::Float);
+            return record(node.get(), StaticType::Unknown);
+        case NodeKind::VarAccess: {
+            VarAccessNode *var = static_cast<VarAccessNode*>(node.get());
+            // A local no path has assigned yet is looked up in the callers.
+            if(var->get_scope() == VarScope::Local && node->get_tok()->get_kind() != TokenKind::BuiltinAlgo
+                && is_number(env[var->get_index()]))
+                return record(node.get(), env[var->get_index()]);
+            return record(node.get(), StaticType::Unknown);
+        }
+        case NodeKind::VarAssign: {
+            VarAssignNode *var = static_cast<VarAssignNode*>(node.get());
+            StaticType type{infer(node->get_child()[0])};
+            if(var->get_scope() == VarScope::Local)
+                set_local(var->get_index(), type);
+            return record(node.get(), type);
+        }
+        case NodeKind::BinOp: return record(node.get(), infer_bin_op(node));
+        case NodeKind::UnaryOp: return record(node.get(), infer_unary_op(node));
+        case NodeKind::If:
+            infer_if(node);
+            break;
+        case NodeKind::For:
+            infer_for(node);
+            break;
+        case NodeKind::While: {
+            const NodeList &child{node->get_child()};
+            infer_loop(child[0], NodeSpan(child, 1), true);
+            break;
+        }
+        case NodeKind::Repeat: {
+            const NodeList &child{node->get_child()};
+            infer_loop(child[0], NodeSpan(child, 1), false);
+            break;
+        }
+        // The body of a nested Algorithm has slots of its own.
+        case NodeKind::AlgoDef: {
+            AlgorithmDefNode *algo_def = static_cast<AlgorithmDefNode*>(node.get());
+            if(algo_def->get_scope() == VarScope::Local)
+                set_local(algo_def->get_index(), StaticType::Unknown);
+            break;
+        }
+        case NodeKind::AlgoCall: {
+            AlgorithmCallNode *algo_call_node = static_cast<AlgorithmCallNode*>(node.get());
+            infer(algo_call_node->get_call());
+            for(auto &arg : algo_call_node->get_args())
+                infer(arg);
+            break;
+        }
+        default:
+            for(auto &child : node->get_child()) {
+                if(child != nullptr)
+                    infer(child);
+            }
+            break;
+    }
+    return record(node.get(), StaticType::Unknown);
+}
+
+// Division and powers may fail, and so are never known.
+StaticType TypeInference::infer_bin_op(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    StaticType left{infer(child[0])};
+    // The right side of `and` and `or` may not run.
+    Env after_left{env};
+    StaticType right{infer(child[1])};
+    TokenKind op{node->get_tok()->get_kind()};
+    if(op == TokenKind::And || op == TokenKind::Or)
+        join(env, after_left);
+    if(!is_number(left) || !is_number(right))
+        return StaticType::Unknown;
+    bool both_int{left == StaticType::Int && right == StaticType::Int};
+    switch(op) {
+        case TokenKind::Add:
+        case TokenKind::Sub:
+        case TokenKind::Mul:
+            return both_int ? StaticType::Int : StaticType::Float;
+        case TokenKind::Mod:
+            return both_int ? StaticType::Int : StaticType::Unknown;
+        case TokenKind::Equal:
+        case TokenKind::Neq:
+        case TokenKind::Less:
+        case TokenKind::Greater:
+        case TokenKind::Leq:
+        case TokenKind::Geq:
+        case TokenKind::And:
+        case TokenKind::Or:
+            return StaticType::Int;
+        default: break;
+    }
+    return StaticType::Unknown;
+}
+
+// `not` keeps the kind of its operand, like operator! does.
+StaticType TypeInference::infer_unary_op(std::shared_ptr<Node> node) {
+    StaticType operand{infer(node->get_child()[0])};
+    switch(node->get_tok()->get_kind()) {
+        case TokenKind::Add:
+        case TokenKind::Sub:
+        case TokenKind::Not:
+            return is_number(operand) ? operand : StaticType::Unknown;
+        default: break;
+    }
+    return StaticType::Unknown;
+}
+
+void TypeInference::infer_if(std::shared_ptr<Node> node) {
+    IfNode* if_node = static_cast<IfNode*>(node.get());
+    infer(if_node->get_condition());
+    Env after_condition{env}, exits{env};
+    infer_stmts(if_node->get_expr(), exits);
+    env = after_condition;
+    infer_stmts(if_node->get_else(), exits);
+    env = exits;
+}
+
+// The loop stores its counter into the variable after every pass, which is
+// an Int only when start and step both are.
+void TypeInference::infer_for(std::shared_ptr<Node> node) {
+    const NodeList &child{node->get_child()};
+    NodeSpan body(child, 3);
+    StaticType start{infer(child[0])};
+    StaticType step{child[2] != nullptr ? infer(child[2]) : StaticType::Int};
+    infer(child[1]);
+    StaticType counter{StaticType::Unknown};
+    if(start == StaticType::Int && step == StaticType::Int)
+        counter = StaticType::Int;
+    else if(start == StaticType::Float && is_number(step))
+        counter = StaticType::Float;
+    VarAssignNode *var = static_cast<VarAssignNode*>(child[0].get());
+
+    Env head{env};
+    while(true) {
+        env = head;
+        Env exits{env};
+        infer_stmts(body, exits);
+        if(var->get_scope() == VarScope::Local)
+            set_local(var->get_index(), counter);
+        join(exits, env);
+        Env next{head};
+        join(next, exits);
+        if(next == head) break;
+        head = std::move(next);
+    }
+    env = head;
+}
+
+// Runs the body until the slots stop changing. The types only ever widen,
+// so this takes at most a pass more than there are slots.
+void TypeInference::infer_loop(std::shared_ptr<Node> condition, NodeSpan body, bool condition_first) {
+    Env head{env};
+    while(true) {
+        env = head;
+        Env exits{env};
+        if(condition_first) {
+            infer(condition);
+            join(exits, env);
+        }
+        infer_stmts(body, exits);
+        if(!condition_first) {
+            infer(condition);
+            join(exits, env);
+        }
+        Env next{head};
+        join(next, exits);
+        if(next == head) break;
+        head = std::move(next);
+    }
+    env = head;
+}
+
+// A failing statement ends the construct, so the state after each one is
+// a way out of it.
+void TypeInference::infer_stmts(NodeSpan stmts, Env &exits) {
+    for(auto &stmt : stmts) {
+        infer(stmt);
+        join(exits, env);
+    }
+}
+
+// Anything but a number may also be an error, which is never stored.
+void TypeInference::set_local(int slot, StaticType type) {
+    env[slot] = is_number(type) ? type : StaticType::Unknown;
+}
+
+// A node inside a loop is seen once per pass, its type holds for all.
+StaticType TypeInference::record(const Node *node, StaticType type) {
+    auto it = types.find(node);
+    if(it == types.end())
+        types.emplace(node, type);
+    else
+        it->second = join(it->second, type);
+    return type;
+}
+
+StaticType TypeInference::join(StaticType a, StaticType b) {
+    return a == b ? a : StaticType::Unknown;
+}
+
+void TypeInference::join(Env &into, const Env &from) {
+    for(size_t i{0}; i < into.size(); ++i)
+        into[i] = join(into[i], from[i]);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/// --------------------
+/// TypeInference
+/// --------------------
+
+#ifndef TYPEINFER_H
+#define TYPEINFER_H
+
+#include "node.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// What a slot or an expression is known to hold. Undefined is a slot no
+// path has assigned yet, Unknown anything that may not be a number.
+enum class StaticType : uint8_t {
+    Undefined, Int, Float, Unknown
+};
+
+/// Flows through an Algorithm body, after Resolver, with its parameters
+/// bound to the given types, and finds the expressions that always give an
+/// Int or a Float. Branches and loops join what each of their paths leaves
+/// in the slots, and every exit an error can take counts as a path.
+class TypeInference {
+public:
+    TypeInference(const FrameLayout &layout, const std::vector<StaticType> &params);
+    void infer(const NodeList &body);
+    StaticType type_of(const Node *node) const;
+
+protected:
+    using Env = std::vector<StaticType>;
+
+    StaticType infer(std::shared_ptr<Node>);
+    StaticType infer_bin_op(std::shared_ptr<Node>);
+    StaticType infer_unary_op(std::shared_ptr<Node>);
+    void infer_if(std::shared_ptr<Node>);
+    void infer_for(std::shared_ptr<Node>);
+    void infer_loop(std::shared_ptr<Node> condition, NodeSpan body, bool condition_first);
+    void infer_stmts(NodeSpan, Env &exits);
+    void set_local(int slot, StaticType);
+    StaticType record(const Node*, StaticType);
+
+    static StaticType join(StaticType a, StaticType b);
+    static void join(Env &into, const Env &from);
+
+    Env env;
+    std::unordered_map<const Node*, StaticType> types;
+};
+
+#endif
\ No newline at end of file
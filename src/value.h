@@ -9,6 +9,8 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <deque>
+#include <cstdint>
 #include "node.h"
 
 const std::string VALUE_NONE{"NONE"};
@@ -18,6 +20,20 @@ const std::string VALUE_ALGO{"Algo"};
 const std::string VALUE_STRING{"Str"};
 const std::string VALUE_ERROR{"ERROR"};
 const std::string VALUE_ARRAY{"Array"};
+const std::string VALUE_MAP{"Map"};
+const std::string VALUE_SET{"Set"};
+const std::string VALUE_HEAP{"Heap"};
+const std::string VALUE_DEQUE{"Deque"};
+
+// Kinds up to Float are stored inline in a TaggedValue, the rest are boxed.
+// Undefined never reaches a program, it marks a variable slot that has not
+// been assigned yet.
+enum class ValueKind : uint8_t {
+    Undefined, None, Int, Float, Algo, Str, Error, Array, Map, Set, Heap, Deque
+};
+
+ValueKind to_value_kind(const std::string&);
+const std::string& value_type_name(ValueKind);
 
 const std::map<char, char> REVERSE_ESCAPE_CHAR {
     {'\n', 'n'}, {'\r', 'r'},
@@ -28,115 +44,511 @@ const std::map<char, char> REVERSE_ESCAPE_CHAR {
 
 class SymbolTable;
 class Interpreter;
+class TaggedValue;
+struct FunctionProto;
+
+// The Float that writing x with six significant digits, as Floats are
+// printed, and reading it back gives. The operators used to read Float
+// operands through that text, so every Float is rounded so when it is made.
+double six_digits(double x);
+
+/// Heap part of a value. Only strings, errors, algorithms, arrays and the
+/// other containers live here; they are reference counted by the
+/// TaggedValue that holds them.
 class Value {
 public:
     Value(const std::string& _type = VALUE_NONE)
-        : type(_type) {}
+        : type(_type), kind(to_value_kind(_type)), ref_count(0) {}
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+    virtual ~Value() {}
     virtual std::string get_num() { return type;}
     virtual std::string repr() { return type;}
     virtual std::string get_type(){ return type;}
-    virtual std::shared_ptr<Value> execute(NodeList args = {}, SymbolTable *parent = nullptr)
-        { return std::make_shared<Value>();};
+    ValueKind get_kind() const { return kind;}
+    virtual TaggedValue execute(const NodeList &args = {}, SymbolTable *parent = nullptr);
     friend std::ostream& operator<<(std::ostream &out, Value &token);
-    
+
+    void retain() { ++ref_count;}
+    void release() { if(--ref_count == 0) delete this;}
+
+    static void* operator new(std::size_t size) {
+        ++allocation_count;
+        return ::operator new(size);
+    }
+    static void operator delete(void *ptr) { ::operator delete(ptr);}
+    static int64_t get_allocation_count() { return allocation_count;}
+
 protected:
     std::string type;
+    ValueKind kind;
+    int64_t ref_count;
+    inline static int64_t allocation_count{0};
 };
 
-using ValueList = std::vector<std::shared_ptr<Value>>;
+/// 16 byte value passed around by the interpreter. Int, Float and none are
+/// stored inline, everything else points to a reference counted Value.
+class TaggedValue {
+public:
+    TaggedValue()
+        : kind(ValueKind::None), int_value(0) {}
+    explicit TaggedValue(Value *_object)
+        : kind(_object->get_kind()), object(_object) { object->retain();}
+    TaggedValue(const TaggedValue &other)
+        : kind(other.kind), int_value(other.int_value) { if(is_boxed()) object->retain();}
+    TaggedValue(TaggedValue &&other) noexcept
+        : kind(other.kind), int_value(other.int_value) { other.kind = ValueKind::None;}
+    TaggedValue& operator=(const TaggedValue &other) {
+        if(other.is_boxed()) other.object->retain();
+        if(is_boxed()) object->release();
+        kind = other.kind;
+        int_value = other.int_value;
+        return *this;
+    }
+    TaggedValue& operator=(TaggedValue &&other) noexcept {
+        if(this != &other) {
+            if(is_boxed()) object->release();
+            kind = other.kind;
+            int_value = other.int_value;
+            other.kind = ValueKind::None;
+        }
+        return *this;
+    }
+    ~TaggedValue() { if(is_boxed()) object->release();}
+
+    static TaggedValue from_int(int64_t value) {
+        TaggedValue ret;
+        ret.kind = ValueKind::Int;
+        ret.int_value = value;
+        return ret;
+    }
+    static TaggedValue from_float(double value) {
+        TaggedValue ret;
+        ret.kind = ValueKind::Float;
+        ret.float_value = six_digits(value);
+        return ret;
+    }
+    static TaggedValue undefined() {
+        TaggedValue ret;
+        ret.kind = ValueKind::Undefined;
+        return ret;
+    }
+
+    ValueKind get_kind() const { return kind;}
+    bool is_boxed() const { return kind > ValueKind::Float;}
+    bool is_error() const { return kind == ValueKind::Error;}
+    bool is_undefined() const { return kind == ValueKind::Undefined;}
+    int64_t get_int() const { return int_value;}
+    double get_float() const { return kind == ValueKind::Int ? int_value : float_value;}
+    Value* get_object() const { return is_boxed() ? object : nullptr;}
+    template<typename T>
+    T* as() const { return static_cast<T*>(object);}
+
+    std::string get_num() const;
+    std::string repr() const;
+    const std::string& get_type() const { return value_type_name(kind);}
+    TaggedValue execute(const NodeList &args = {}, SymbolTable *parent = nullptr) const;
+
+private:
+    ValueKind kind;
+    union {
+        int64_t int_value;
+        double float_value;
+        Value *object;
+    };
+};
+
+static_assert(sizeof(TaggedValue) == 16, "TaggedValue should stay two words wide");
+
+using ValueList = std::vector<TaggedValue>;
+
+/// Arguments of a call, viewed where the caller evaluated them.
+struct ValueSpan {
+    TaggedValue *data;
+    size_t count;
+    size_t size() const { return count;}
+    TaggedValue& operator[](size_t i) const { return data[i];}
+};
 
 template<typename T>
 class TypedValue: public Value {
 public:
-    TypedValue(const std::string& _type, const T &_value) 
+    TypedValue(const std::string& _type, const T &_value)
         : Value(_type), value(_value) {}
     std::string get_num() override;
     std::string repr() override;
+    const T& get_value() const { return value;}
 
 protected:
     T value;
 };
 
+using StringValue = TypedValue<std::string>;
 using ErrorValue = TypedValue<std::string>;
 
+template<typename T, typename... Args>
+inline TaggedValue make_boxed(Args&&... args) {
+    return TaggedValue(new T(std::forward<Args>(args)...));
+}
+
+inline TaggedValue make_int(int64_t value) { return TaggedValue::from_int(value);}
+inline TaggedValue make_float(double value) { return TaggedValue::from_float(value);}
+inline TaggedValue make_number(int64_t value) { return make_int(value);}
+inline TaggedValue make_number(double value) { return make_float(value);}
+inline TaggedValue make_string(const std::string &value) {
+    return make_boxed<StringValue>(VALUE_STRING, value);
+}
+inline TaggedValue make_error(const std::string &message) {
+    return make_boxed<ErrorValue>(VALUE_ERROR, message);
+}
+
+inline TaggedValue Value::execute(const NodeList &args, SymbolTable *parent) {
+    return TaggedValue();
+}
+
+// Integer view used by conditions and array indices. Anything but an Int
+// goes through its text form.
+int64_t as_integer(const TaggedValue&);
+// How `and` and `or` read an operand: a number other than 0. Anything else
+// goes through its text form.
+bool is_truthy(const TaggedValue&);
+
+// Passes a for loop counting in Ints makes after the one at counter, 0 once
+// the counter is past the end. The step is not 0.
+inline uint64_t passes_after(int64_t counter, int64_t end, int64_t step) {
+    if(step > 0)
+        return end < counter ? 0 : (uint64_t(end) - uint64_t(counter)) / uint64_t(step);
+    return end > counter ? 0 : (uint64_t(counter) - uint64_t(end)) / (uint64_t(0) - uint64_t(step));
+}
+// The passes_after a loop over a constant can make at once: the counter
+// then steps past the end without wrapping around, and the array has room.
+// 0 otherwise, and the loop goes on one pass at a time.
+inline uint64_t fill_passes(int64_t counter, int64_t end, int64_t step) {
+    uint64_t passes{passes_after(counter, end, step)};
+    uint64_t stride{step > 0 ? uint64_t(step) : uint64_t(0) - uint64_t(step)};
+    uint64_t room{step > 0 ? uint64_t(INT64_MAX) - uint64_t(counter) : uint64_t(counter) - uint64_t(INT64_MIN)};
+    if(passes >= ValueList().max_size() || passes + 1 > room / stride)
+        return 0;
+    return passes;
+}
+// The counter after that many more passes, which fill_passes keeps in range.
+inline int64_t counter_after(int64_t counter, uint64_t passes, int64_t step) {
+    return int64_t(uint64_t(counter) + passes * uint64_t(step));
+}
+
 class BaseAlgoValue: public Value {
 public:
-    BaseAlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value) 
-        : Value(VALUE_ALGO), value(_value), algo_name(_algo_name) {}
+    BaseAlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value)
+        : Value(VALUE_ALGO), algo_name(_algo_name), value(_value), arity(_value->get_toks().size()),
+        min_arity(arity) {}
     std::string get_num() override { return algo_name;}
-    virtual std::shared_ptr<Value> set_args(NodeList&, SymbolTable&, Interpreter&);
     std::string repr() override { return get_num();}
+    std::shared_ptr<Node> get_def() { return value;}
+    virtual FunctionProto* get_proto() { return nullptr;}
+    MemoCache* get_memo_cache() { return static_cast<AlgorithmDefNode*>(value.get())->get_memo_cache();}
+    TaggedValue check_arity(size_t args_count);
+    virtual TaggedValue call(ValueSpan, SymbolTable*) = 0;
 
 protected:
     std::string algo_name;
     std::shared_ptr<Node> value;
+    size_t arity;
+    // Fewer than arity arguments, when the last parameters are optional.
+    size_t min_arity;
 };
 
 class AlgoValue: public BaseAlgoValue {
 public:
-    AlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value) 
+    AlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value)
         : BaseAlgoValue(_algo_name, _value) {}
     std::string get_num() override { return algo_name;}
     std::string repr() override { return get_num();}
-    std::shared_ptr<Value> execute(NodeList args = {}, SymbolTable *parent = nullptr) override;
+    TaggedValue execute(const NodeList &args = {}, SymbolTable *parent = nullptr) override;
+    TaggedValue call(ValueSpan, SymbolTable*) override;
 protected:
+    TaggedValue run_body(SymbolTable *parent, SymbolTable *frame);
+    TaggedValue run_memo(MemoCache*, SymbolTable *parent, SymbolTable &frame);
 };
 
+// Which builtin a BuiltinAlgoValue is, found from its name once when it
+// is made so that a call is one switch.
+enum class Builtin : uint8_t {
+    Print, Read, ReadLine, Open, Clear, Quit, Int, Float, String, Array, Sum, MinOf, MaxOf, Count,
+    IndexOf, Dot, Sort, Reverse, LowerBound, UpperBound, Unique, Map, Set, Heap, Deque, Size, Has,
+    Insert, Remove, Keys, Values, Push, Top, Pop, PushFront, PushBack, Front, Back, PopFront,
+    PopBack, Unknown
+};
+Builtin builtin_of(const std::string &name);
+
 class BuiltinAlgoValue: public BaseAlgoValue {
 public:
-    BuiltinAlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value) 
-        : BaseAlgoValue(_algo_name, _value) {}
+    // The last optional parameters may be left out, they are then none.
+    BuiltinAlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value, size_t optional = 0)
+        : BaseAlgoValue(_algo_name, _value), builtin(builtin_of(_algo_name)) { min_arity = arity - optional;}
     std::string get_num() override { return algo_name;}
-    std::shared_ptr<Value> execute(NodeList args = {}, SymbolTable *parent = nullptr) override;
-    std::shared_ptr<Value> execute_print(const std::string&);
-    std::shared_ptr<Value> execute_read();
-    std::shared_ptr<Value> execute_read_line();
-    std::shared_ptr<Value> execute_clear();
-    std::shared_ptr<Value> execute_int(const std::string&);
-    std::shared_ptr<Value> execute_float(const std::string&);
-    std::shared_ptr<Value> execute_string(const std::string&);
+    TaggedValue execute(const NodeList &args = {}, SymbolTable *parent = nullptr) override;
+    TaggedValue call(ValueSpan, SymbolTable*) override;
+    TaggedValue execute_print(const std::string&);
+    TaggedValue execute_read();
+    TaggedValue execute_read_line();
+    TaggedValue execute_clear();
+    TaggedValue execute_int(const std::string&);
+    TaggedValue execute_float(const std::string&);
+    TaggedValue execute_string(const std::string&);
+    TaggedValue execute_array(const TaggedValue &size, const TaggedValue &fill);
+    TaggedValue execute_sum(const TaggedValue &arr);
+    TaggedValue execute_min_of(const TaggedValue &arr);
+    TaggedValue execute_max_of(const TaggedValue &arr);
+    TaggedValue execute_count(const TaggedValue &arr, const TaggedValue &x);
+    TaggedValue execute_index_of(const TaggedValue &arr, const TaggedValue &x);
+    TaggedValue execute_dot(const TaggedValue &a, const TaggedValue &b);
+    TaggedValue execute_sort(TaggedValue arr, TaggedValue before, SymbolTable *parent);
+    TaggedValue execute_reverse(const TaggedValue &arr);
+    TaggedValue execute_bound(const TaggedValue &arr, const TaggedValue &x, bool upper);
+    TaggedValue execute_unique(const TaggedValue &arr);
+    TaggedValue execute_map();
+    TaggedValue execute_set(const TaggedValue &from);
+    TaggedValue execute_heap(const TaggedValue &from);
+    TaggedValue execute_deque(const TaggedValue &from);
+    TaggedValue execute_size(const TaggedValue &container);
+    TaggedValue execute_has(const TaggedValue &container, const TaggedValue &key);
+    TaggedValue execute_insert(const TaggedValue &set, const TaggedValue &x);
+    TaggedValue execute_remove(const TaggedValue &container, const TaggedValue &key);
+    TaggedValue execute_keys(const TaggedValue &container, bool values);
+    TaggedValue execute_push(const TaggedValue &heap, const TaggedValue &x, const TaggedValue &priority);
+    TaggedValue execute_top(const TaggedValue &heap, bool pop);
+    TaggedValue execute_push_end(const TaggedValue &container, const TaggedValue &x, bool front);
+    TaggedValue execute_end(const TaggedValue &container, bool front, bool pop);
     std::string repr() override { return get_num();}
 protected:
+    Builtin builtin;
+};
+
+// How an ArrayValue keeps its elements. While they are all Ints, or all
+// Floats, they are packed 8 bytes each. The first element of another kind
+// moves the array to Boxed, a ValueList, for good.
+enum class ArrayLayout : uint8_t {
+    Int, Float, Boxed
 };
 
 class ArrayValue: public Value {
 public:
-    ArrayValue(ValueList _value) 
-        : Value(VALUE_ARRAY), value(_value) {}
+    ArrayValue(ValueList _value);
+    // Packed arrays of the given elements.
+    ArrayValue(std::vector<int64_t> _ints);
+    ArrayValue(std::vector<double> _floats);
     std::string get_num() override;
-    std::shared_ptr<Value>& operator[](int p);
-    void push_back(std::shared_ptr<Value>);
-    std::shared_ptr<Value> pop_back();
-    std::shared_ptr<Value>& back() { return value.back();};
     std::string repr() override { return get_num();}
+    ArrayLayout get_layout() const { return layout;}
+    size_t size() const {
+        switch(layout) {
+            case ArrayLayout::Int: return ints.size();
+            case ArrayLayout::Float: return floats.size();
+            default: return value.size();
+        }
+    }
+    // Positions count from 1. Reading out of range gives an error, storing
+    // there does nothing.
+    TaggedValue get(int64_t p) const {
+        if(p < 1 || p > static_cast<int64_t>(size()))
+            return out_of_range(p);
+        switch(layout) {
+            case ArrayLayout::Int: return make_int(ints[p - 1]);
+            case ArrayLayout::Float: return make_float(floats[p - 1]);
+            default: return value[p - 1];
+        }
+    }
+    void set(int64_t p, const TaggedValue &element) {
+        if(p < 1 || p > static_cast<int64_t>(size()))
+            return;
+        if(layout == ArrayLayout::Int && element.get_kind() == ValueKind::Int)
+            ints[p - 1] = element.get_int();
+        else if(layout == ArrayLayout::Float && element.get_kind() == ValueKind::Float)
+            floats[p - 1] = element.get_float();
+        else {
+            box();
+            value[p - 1] = element;
+        }
+    }
+    void push_back(TaggedValue);
+    // Appends count copies of element, in one pass.
+    void fill(const TaggedValue &element, size_t count);
+    // Removes the last element and gives it back.
+    TaggedValue pop_back();
+    TaggedValue back() const { return get(size());}
+    // The packed elements, empty unless the array has their layout.
+    const std::vector<int64_t>& get_ints() const { return ints;}
+    const std::vector<double>& get_floats() const { return floats;}
+    // A new array with the same elements, in the same layout.
+    TaggedValue copy() const;
+    // Orders the elements by `<`, NaNs last. Packed elements go through
+    // std::sort, an introsort. Boxed ones are merge sorted, which stays in
+    // bounds whatever `<` makes of mixed kinds.
+    void sort();
+    // Merge sorts the elements by an Algorithm that tells whether its first
+    // argument goes before its second, called in the scope parent. On an
+    // error, or a result that is not a number, the elements are left as
+    // they were and the error is returned.
+    TaggedValue sort(BaseAlgoValue *before, SymbolTable *parent);
+    void reverse();
+    // Drops every element that is `=` to the one before it.
+    void unique();
+    // The first position, from 1, whose element is not `<` x, or for the
+    // upper bound the first that x is `<`. size() + 1 when there is none.
+    int64_t lower_bound(const TaggedValue &x) const;
+    int64_t upper_bound(const TaggedValue &x) const;
 
 protected:
+    TaggedValue out_of_range(int64_t p) const;
+    void box();
+    ArrayLayout layout;
+    std::vector<int64_t> ints;
+    std::vector<double> floats;
     ValueList value;
-    std::shared_ptr<Value> error;
 };
 
-std::shared_ptr<Value> operator+(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator-(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator*(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator/(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator%(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> pow(std::shared_ptr<Value>, std::shared_ptr<Value>);
+/// Open addressing hash table behind Map and Set. Keys are Ints, Floats
+/// and Strs, hashed from their payload, never from their text; 1 and 1.0
+/// are one key, as they are `=`. Entries stay in the order they were added
+/// and the slots, probed linearly, hold their positions. A removed entry
+/// leaves a hole in both until the table is rebuilt.
+class HashTable {
+public:
+    // Whether a value can be a key.
+    static bool is_key(const TaggedValue&);
+    size_t size() const { return count;}
+    // The value stored under key, null when there is none.
+    TaggedValue* find(const TaggedValue &key);
+    // Stores value under key, and tells whether the key was new.
+    bool insert(const TaggedValue &key, TaggedValue value);
+    bool remove(const TaggedValue &key);
+    // Calls f(key, value) on every entry, in the order they were added.
+    template<typename F>
+    void for_each(F f) const {
+        for(const Entry &entry : entries) {
+            if(!entry.key.is_undefined())
+                f(entry.key, entry.value);
+        }
+    }
+
+protected:
+    struct Entry {
+        TaggedValue key, value;
+        uint64_t hash;
+    };
+    static uint64_t hash_of(const TaggedValue&);
+    static bool same_key(const TaggedValue&, const TaggedValue&);
+    // The slot holding key, or the empty slot its probe ends on.
+    size_t probe(const TaggedValue &key, uint64_t hash) const;
+    // Drops the holes, with slots for four times the entries.
+    void rebuild();
+    std::vector<Entry> entries;
+    // Positions in entries, EMPTY or REMOVED.
+    std::vector<int32_t> slots;
+    size_t count{0};
+    static constexpr int32_t EMPTY{-1}, REMOVED{-2};
+};
+
+class MapValue: public Value {
+public:
+    MapValue()
+        : Value(VALUE_MAP) {}
+    std::string get_num() override;
+    std::string repr() override { return get_num();}
+    HashTable& get_table() { return table;}
+    // Reading a key that is not there gives an error.
+    TaggedValue get(const TaggedValue &key);
+    // The value, or an error when key cannot be one.
+    TaggedValue set(const TaggedValue &key, const TaggedValue &value);
+
+protected:
+    HashTable table;
+};
+
+class SetValue: public Value {
+public:
+    SetValue()
+        : Value(VALUE_SET) {}
+    std::string get_num() override;
+    std::string repr() override { return get_num();}
+    // The elements are keys with none as their value.
+    HashTable& get_table() { return table;}
+
+protected:
+    HashTable table;
+};
+
+/// Binary min heap, by `<` on the priorities. Equal priorities come out in
+/// the order they went in.
+class HeapValue: public Value {
+public:
+    HeapValue()
+        : Value(VALUE_HEAP) {}
+    std::string get_num() override;
+    std::string repr() override { return get_num();}
+    size_t size() const { return entries.size();}
+    void push(TaggedValue value, TaggedValue priority);
+    // The value of least priority. The heap must not be empty.
+    const TaggedValue& top() const { return entries.front().value;}
+    TaggedValue pop();
+
+protected:
+    struct Entry {
+        TaggedValue value, priority;
+        uint64_t order;
+    };
+    // Whether a comes out after b, the order of std::push_heap.
+    static bool after(const Entry &a, const Entry &b);
+    std::vector<Entry> entries;
+    uint64_t pushed{0};
+};
+
+class DequeValue: public Value {
+public:
+    DequeValue()
+        : Value(VALUE_DEQUE) {}
+    std::string get_num() override;
+    std::string repr() override { return get_num();}
+    std::deque<TaggedValue>& get_elements() { return value;}
+    // Positions count from 1, as in an Array.
+    TaggedValue get(int64_t p) const;
+    void set(int64_t p, const TaggedValue &element) {
+        if(p >= 1 && p <= static_cast<int64_t>(value.size()))
+            value[p - 1] = element;
+    }
+
+protected:
+    std::deque<TaggedValue> value;
+};
+
+// container[index] for every kind that can be indexed: an Array or Deque
+// by position, a Map by key and a Set by element, giving whether it is in.
+TaggedValue index_get(const TaggedValue &container, const TaggedValue &index);
+// container[index] <- value. Like an Array, a Deque ignores a position out
+// of range. A Set takes the element in when value is true and drops it
+// otherwise. Gives the value, or an error when index cannot be a key.
+TaggedValue index_set(const TaggedValue &container, const TaggedValue &index, const TaggedValue &value);
+
+TaggedValue operator+(const TaggedValue&, const TaggedValue&);
+TaggedValue operator-(const TaggedValue&, const TaggedValue&);
+TaggedValue operator*(const TaggedValue&, const TaggedValue&);
+TaggedValue operator/(const TaggedValue&, const TaggedValue&);
+TaggedValue operator%(const TaggedValue&, const TaggedValue&);
+TaggedValue pow(const TaggedValue&, const TaggedValue&);
 
-std::shared_ptr<Value> operator==(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator!=(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator<(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator>(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator<=(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator>=(std::shared_ptr<Value>, std::shared_ptr<Value>);
+TaggedValue operator==(const TaggedValue&, const TaggedValue&);
+TaggedValue operator!=(const TaggedValue&, const TaggedValue&);
+TaggedValue operator<(const TaggedValue&, const TaggedValue&);
+TaggedValue operator>(const TaggedValue&, const TaggedValue&);
+TaggedValue operator<=(const TaggedValue&, const TaggedValue&);
+TaggedValue operator>=(const TaggedValue&, const TaggedValue&);
 
-std::shared_ptr<Value> operator&&(std::shared_ptr<Value>, std::shared_ptr<Value>);
-std::shared_ptr<Value> operator||(std::shared_ptr<Value>, std::shared_ptr<Value>);
+TaggedValue operator&&(const TaggedValue&, const TaggedValue&);
+TaggedValue operator||(const TaggedValue&, const TaggedValue&);
 
-std::shared_ptr<Value> operator-(std::shared_ptr<Value>);
-std::shared_ptr<Value> operator!(std::shared_ptr<Value>);
+TaggedValue operator-(const TaggedValue&);
+TaggedValue operator!(const TaggedValue&);
 
-template class TypedValue<double>;
-template class TypedValue<int64_t>;
 template class TypedValue<std::string>;
 
-#endif
\ No newline at end of file
+#endif
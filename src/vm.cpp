@@ -0,0 +1,501 @@
+/// --------------------
+/// VM
+/// --------------------
+
+#include "vm.h"
+#include "compiler.h"
+#include "symboltable.h"
+#include "color.h"
+#include "memo.h"
+#include <iterator>
+#include <string>
+#include <type_traits>
+
+template<OpCode op>
+inline void VM::binary() {
+    TaggedValue &a{stack[stack.size() - 2]};
+    a = binary_op(op, a, stack.back());
+    stack.pop_back();
+}
+
+// Operands the compiler proved to be numbers, computed as T without looking
+// at their kinds.
+template<OpCode op, typename T>
+inline void VM::typed_binary() {
+    TaggedValue &a{stack[stack.size() - 2]};
+    T x, y;
+    if constexpr(std::is_same_v<T, int64_t>) {
+        x = a.get_int();
+        y = stack.back().get_int();
+    } else {
+        x = a.get_float();
+        y = stack.back().get_float();
+    }
+    if constexpr(op == OpCode::Add) a = make_number(x + y);
+    else if constexpr(op == OpCode::Sub) a = make_number(x - y);
+    else if constexpr(op == OpCode::Mul) a = make_number(x * y);
+    else if constexpr(op == OpCode::Equal) a = make_int(x == y);
+    else if constexpr(op == OpCode::Neq) a = make_int(x != y);
+    else if constexpr(op == OpCode::Less) a = make_int(x < y);
+    else if constexpr(op == OpCode::Greater) a = make_int(x > y);
+    else if constexpr(op == OpCode::Leq) a = make_int(x <= y);
+    else a = make_int(x >= y);
+    stack.pop_back();
+}
+
+template<OpCode op, typename T>
+static inline bool compare(T x, T y) {
+    if constexpr(op == OpCode::Equal) return x == y;
+    else if constexpr(op == OpCode::Neq) return x != y;
+    else if constexpr(op == OpCode::Less) return x < y;
+    else if constexpr(op == OpCode::Greater) return x > y;
+    else if constexpr(op == OpCode::Leq) return x <= y;
+    else return x >= y;
+}
+
+// Where a compare and branch goes, null to fall through. Numbers are
+// compared in place, anything else through binary_op.
+template<OpCode op>
+inline const Instruction* VM::compare_jump(const Instruction &ins, const Instruction *code) {
+    const TaggedValue &a{stack[stack.size() - 2]}, &b{stack.back()};
+    bool holds;
+    if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int) {
+        holds = compare<op>(a.get_int(), b.get_int());
+    } else if((a.get_kind() == ValueKind::Int || a.get_kind() == ValueKind::Float)
+        && (b.get_kind() == ValueKind::Int || b.get_kind() == ValueKind::Float)) {
+        holds = compare<op>(a.get_float(), b.get_float());
+    } else {
+        TaggedValue result{binary_op(op, a, b)};
+        stack.resize(stack.size() - 2);
+        if(result.is_error()) {
+            stack.push_back(std::move(result));
+            return code + ins.b;
+        }
+        return as_integer(result) == 1 ? nullptr : code + ins.a;
+    }
+    stack.resize(stack.size() - 2);
+    return holds ? nullptr : code + ins.a;
+}
+
+// The version of an Algorithm compiled for the kinds of its arguments,
+// made on the first call with them. Calls with anything but numbers, and
+// kinds past MAX_SPECIALIZATIONS versions, run the generic code.
+FunctionProto* VM::specialize(FunctionProto *proto, const TaggedValue *args) {
+    int count{proto->layout->param_count};
+    if(count == 0 || count > 32)
+        return proto;
+    uint32_t signature{0};
+    for(int i{0}; i < count; ++i) {
+        ValueKind kind{args[i].get_kind()};
+        if(kind == ValueKind::Float)
+            signature |= uint32_t(1) << i;
+        else if(kind != ValueKind::Int)
+            return proto;
+    }
+    for(auto &[key, version] : proto->specializations) {
+        if(key == signature)
+            return version != nullptr ? version.get() : proto;
+    }
+    if(proto->specializations.size() >= MAX_SPECIALIZATIONS)
+        return proto;
+    std::vector<StaticType> params(count);
+    for(int i{0}; i < count; ++i)
+        params[i] = (signature >> i & 1) ? StaticType::Float : StaticType::Int;
+    std::shared_ptr<FunctionProto> version{Compiler().compile_specialized(proto->def, params)};
+    proto->specializations.emplace_back(signature, version);
+    return version != nullptr ? version.get() : proto;
+}
+
+TaggedValue VM::run(FunctionProto &entry) {
+    size_t entry_depth{frames.size()};
+    size_t base{stack.size()};
+    stack.resize(base + entry.slot_count, TaggedValue::undefined());
+    frames.push_back(CallFrame{&entry, entry.code.data(), base});
+    return execute(entry_depth);
+}
+
+// The frame is set up as OpCode::Call sets one up, and execute returns
+// once it returns. A memo cache is not used.
+TaggedValue VM::call(FunctionProto *callee, ValueSpan args) {
+    if(frames.size() >= max_depth)
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Maximum recursion depth of "
+            + std::to_string(max_depth) + " exceeded\n" RESET);
+    if(nested_runs >= MAX_NESTED_RUNS)
+        return make_error(
+            Color(0xFF, 0x39, 0x6E).get() + "Maximum of " + std::to_string(MAX_NESTED_RUNS)
+            + " nested calls from builtins exceeded\n" RESET);
+    size_t entry_depth{frames.size()};
+    size_t base{stack.size()};
+    for(size_t i{0}; i < args.size(); ++i)
+        stack.push_back(args[i]);
+    callee = specialize(callee, stack.data() + base);
+    stack.resize(base + callee->slot_count, TaggedValue::undefined());
+    frames.push_back(CallFrame{callee, callee->code.data(), base});
+    ++nested_runs;
+    TaggedValue ret{execute(entry_depth)};
+    --nested_runs;
+    return ret;
+}
+
+TaggedValue CompiledAlgoValue::call(ValueSpan args, SymbolTable *parent) {
+    if(parent != nullptr)
+        return AlgoValue::call(args, parent);
+    TaggedValue ret{check_arity(args.size())};
+    if(ret.is_error())
+        return ret;
+    return vm->call(proto.get(), args);
+}
+
+// Algorithms see the variables of whoever called them, so a name that is
+// not local is searched for through the calling frames, then the globals.
+TaggedValue VM::lookup(int name, size_t frame_index) {
+    if(!names.is_bound(name))
+        return lookup_global(name);
+    while(frame_index-- > 0) {
+        const CallFrame &frame{frames[frame_index]};
+        if(frame.proto->top_level) continue;
+        int slot{frame.proto->layout->slot_of(name)};
+        if(slot >= 0 && !stack[frame.base + slot].is_undefined())
+            return stack[frame.base + slot];
+    }
+    return lookup_global(name);
+}
+
+TaggedValue VM::lookup_global(int name) {
+    if(static_cast<size_t>(name) < globals.size() && !globals[name].is_undefined())
+        return globals[name];
+    const std::string &var_name{names.names[name]};
+    if(BUILTIN_ALGOS.count(var_name))
+        return BUILTIN_ALGOS.at(var_name);
+    return make_error(
+        Color(0xFF, 0x39, 0x6E).get() + "Identifier: \""+ var_name +"\" has not defined\n" RESET);
+}
+
+TaggedValue VM::execute(size_t entry_depth) {
+    FunctionProto *proto{frames.back().proto};
+    const Instruction *ip{frames.back().ip};
+    size_t base{frames.back().base};
+
+    while(true) {
+        const Instruction &ins{*ip++};
+        switch(ins.op) {
+            case OpCode::Constant:
+                stack.push_back(proto->constants[ins.a]);
+                break;
+            case OpCode::Pop:
+                stack.pop_back();
+                break;
+            case OpCode::LoadLocal: {
+                TaggedValue value{stack[base + ins.a]};
+                if(value.is_undefined())
+                    value = lookup(proto->layout->slot_names[ins.a], frames.size() - 1);
+                stack.push_back(std::move(value));
+                break;
+            }
+            case OpCode::StoreLocal:
+                stack[base + ins.a] = stack.back();
+                break;
+            case OpCode::LoadGlobal:
+                stack.push_back(lookup_global(ins.a));
+                break;
+            case OpCode::StoreGlobal:
+                if(static_cast<size_t>(ins.a) >= globals.size())
+                    globals.resize(names.names.size(), TaggedValue::undefined());
+                globals[ins.a] = stack.back();
+                break;
+            case OpCode::LoadName:
+                stack.push_back(lookup(ins.a, frames.size() - 1));
+                break;
+
+            case OpCode::Add: binary<OpCode::Add>(); break;
+            case OpCode::Sub: binary<OpCode::Sub>(); break;
+            case OpCode::Mul: binary<OpCode::Mul>(); break;
+            case OpCode::Div: binary<OpCode::Div>(); break;
+            case OpCode::Mod: binary<OpCode::Mod>(); break;
+            case OpCode::Pow: binary<OpCode::Pow>(); break;
+            case OpCode::Equal: binary<OpCode::Equal>(); break;
+            case OpCode::Neq: binary<OpCode::Neq>(); break;
+            case OpCode::Less: binary<OpCode::Less>(); break;
+            case OpCode::Greater: binary<OpCode::Greater>(); break;
+            case OpCode::Leq: binary<OpCode::Leq>(); break;
+            case OpCode::Geq: binary<OpCode::Geq>(); break;
+            case OpCode::And: binary<OpCode::And>(); break;
+            case OpCode::Or: binary<OpCode::Or>(); break;
+            case OpCode::AddInt: typed_binary<OpCode::Add, int64_t>(); break;
+            case OpCode::SubInt: typed_binary<OpCode::Sub, int64_t>(); break;
+            case OpCode::MulInt: typed_binary<OpCode::Mul, int64_t>(); break;
+            case OpCode::EqualInt: typed_binary<OpCode::Equal, int64_t>(); break;
+            case OpCode::NeqInt: typed_binary<OpCode::Neq, int64_t>(); break;
+            case OpCode::LessInt: typed_binary<OpCode::Less, int64_t>(); break;
+            case OpCode::GreaterInt: typed_binary<OpCode::Greater, int64_t>(); break;
+            case OpCode::LeqInt: typed_binary<OpCode::Leq, int64_t>(); break;
+            case OpCode::GeqInt: typed_binary<OpCode::Geq, int64_t>(); break;
+            case OpCode::AddFloat: typed_binary<OpCode::Add, double>(); break;
+            case OpCode::SubFloat: typed_binary<OpCode::Sub, double>(); break;
+            case OpCode::MulFloat: typed_binary<OpCode::Mul, double>(); break;
+            case OpCode::EqualFloat: typed_binary<OpCode::Equal, double>(); break;
+            case OpCode::NeqFloat: typed_binary<OpCode::Neq, double>(); break;
+            case OpCode::LessFloat: typed_binary<OpCode::Less, double>(); break;
+            case OpCode::GreaterFloat: typed_binary<OpCode::Greater, double>(); break;
+            case OpCode::LeqFloat: typed_binary<OpCode::Leq, double>(); break;
+            case OpCode::GeqFloat: typed_binary<OpCode::Geq, double>(); break;
+            case OpCode::Negate:
+                if(!stack.back().is_error())
+                    stack.back() = -stack.back();
+                break;
+            case OpCode::Not:
+                if(!stack.back().is_error())
+                    stack.back() = !stack.back();
+                break;
+
+            case OpCode::Jump:
+                ip = proto->code.data() + ins.a;
+                break;
+            case OpCode::JumpIfError:
+                if(stack.back().is_error())
+                    ip = proto->code.data() + ins.a;
+                break;
+            case OpCode::JumpIfFalse: {
+                TaggedValue cond{std::move(stack.back())};
+                stack.pop_back();
+                if(as_integer(cond) != 1)
+                    ip = proto->code.data() + ins.a;
+                break;
+            }
+            case OpCode::JumpIfZero: {
+                TaggedValue cond{std::move(stack.back())};
+                stack.pop_back();
+                if(as_integer(cond) == 0)
+                    ip = proto->code.data() + ins.a;
+                break;
+            }
+
+            case OpCode::JumpIfFalsy:
+                if(stack.back().is_error()) {
+                    ip = proto->code.data() + ins.a;
+                } else if(!is_truthy(stack.back())) {
+                    stack.back() = make_int(0);
+                    ip = proto->code.data() + ins.a;
+                } else {
+                    stack.pop_back();
+                }
+                break;
+            case OpCode::JumpIfTruthy:
+                if(stack.back().is_error()) {
+                    ip = proto->code.data() + ins.a;
+                } else if(is_truthy(stack.back())) {
+                    stack.back() = make_int(1);
+                    ip = proto->code.data() + ins.a;
+                } else {
+                    stack.pop_back();
+                }
+                break;
+            case OpCode::Truth:
+                if(!stack.back().is_error())
+                    stack.back() = make_int(is_truthy(stack.back()));
+                break;
+            case OpCode::JumpUnlessEqual:
+                if(const Instruction *target{compare_jump<OpCode::Equal>(ins, proto->code.data())})
+                    ip = target;
+                break;
+            case OpCode::JumpUnlessNeq:
+                if(const Instruction *target{compare_jump<OpCode::Neq>(ins, proto->code.data())})
+                    ip = target;
+                break;
+            case OpCode::JumpUnlessLess:
+                if(const Instruction *target{compare_jump<OpCode::Less>(ins, proto->code.data())})
+                    ip = target;
+                break;
+            case OpCode::JumpUnlessGreater:
+                if(const Instruction *target{compare_jump<OpCode::Greater>(ins, proto->code.data())})
+                    ip = target;
+                break;
+            case OpCode::JumpUnlessLeq:
+                if(const Instruction *target{compare_jump<OpCode::Leq>(ins, proto->code.data())})
+                    ip = target;
+                break;
+            case OpCode::JumpUnlessGeq:
+                if(const Instruction *target{compare_jump<OpCode::Geq>(ins, proto->code.data())})
+                    ip = target;
+                break;
+
+            case OpCode::MakeArray: {
+                ValueList elements(
+                    std::make_move_iterator(stack.end() - ins.a), std::make_move_iterator(stack.end()));
+                stack.resize(stack.size() - ins.a);
+                stack.push_back(make_boxed<ArrayValue>(std::move(elements)));
+                break;
+            }
+            case OpCode::AppendLocal:
+                stack[base + ins.a].as<ArrayValue>()->push_back(std::move(stack.back()));
+                stack.pop_back();
+                break;
+            case OpCode::ArrayGet: {
+                TaggedValue &arr{stack[stack.size() - 2]};
+                TaggedValue element{index_get(arr, stack.back())};
+                arr = std::move(element);
+                stack.pop_back();
+                break;
+            }
+            case OpCode::ArraySet: {
+                // Like the tree walker, an assignment that misses the array
+                // still evaluates to the assigned value.
+                TaggedValue value{std::move(stack.back())};
+                stack.pop_back();
+                TaggedValue &arr{stack[stack.size() - 2]};
+                value = index_set(arr, stack.back(), value);
+                stack.resize(stack.size() - 2);
+                stack.push_back(std::move(value));
+                break;
+            }
+
+            case OpCode::TailCall: {
+                size_t callee_index{stack.size() - ins.a - 1};
+                const TaggedValue &callee{stack[callee_index]};
+                FunctionProto *callee_proto{
+                    callee.get_kind() == ValueKind::Algo ? callee.as<BaseAlgoValue>()->get_proto() : nullptr};
+                if(callee_proto != nullptr && ins.a == callee_proto->layout->param_count
+                    && proto->memo == nullptr && callee_proto->memo == nullptr && names.hides(*proto->layout)) {
+                    // Moves the callee and its arguments over the ending frame.
+                    std::move(stack.begin() + callee_index, stack.end(), stack.begin() + (base - 1));
+                    stack.resize(base + ins.a);
+                    proto = specialize(callee_proto, stack.data() + base);
+                    ip = proto->code.data();
+                    stack.resize(base + proto->slot_count, TaggedValue::undefined());
+                    frames.back() = CallFrame{proto, ip, base};
+                    break;
+                }
+                [[fallthrough]];
+            }
+            case OpCode::Call: {
+                size_t callee_index{stack.size() - ins.a - 1};
+                const TaggedValue &callee{stack[callee_index]};
+                if(callee.get_kind() != ValueKind::Algo) {
+                    stack.resize(callee_index);
+                    stack.push_back(TaggedValue());
+                    break;
+                }
+                BaseAlgoValue *algo{callee.as<BaseAlgoValue>()};
+                FunctionProto *callee_proto{algo->get_proto()};
+                if(callee_proto == nullptr) {
+                    TaggedValue result{algo->call(ValueSpan{stack.data() + callee_index + 1, size_t(ins.a)}, nullptr)};
+                    stack.resize(callee_index);
+                    stack.push_back(std::move(result));
+                    break;
+                }
+                if(ins.a != callee_proto->layout->param_count) {
+                    TaggedValue result{algo->check_arity(ins.a)};
+                    stack.resize(callee_index);
+                    stack.push_back(std::move(result));
+                    break;
+                }
+                callee_proto = specialize(callee_proto, stack.data() + callee_index + 1);
+                MemoCache *memo{nullptr};
+                if(callee_proto->memo != nullptr) {
+                    std::string key;
+                    if(MemoCache::make_key(ValueSpan{stack.data() + callee_index + 1, size_t(ins.a)}, key)) {
+                        TaggedValue result;
+                        if(callee_proto->memo->find(key, result)) {
+                            stack.resize(callee_index);
+                            stack.push_back(std::move(result));
+                            break;
+                        }
+                        memo = callee_proto->memo;
+                        memo_keys.push_back(std::move(key));
+                    }
+                }
+                if(frames.size() >= max_depth) {
+                    // Unwinds everything this run started, the error ends it.
+                    for(size_t i{entry_depth}; i < frames.size(); ++i) {
+                        if(frames[i].memo != nullptr)
+                            memo_keys.pop_back();
+                    }
+                    if(memo != nullptr)
+                        memo_keys.pop_back();
+                    stack.resize(frames[entry_depth].base);
+                    frames.resize(entry_depth);
+                    return make_error(
+                        Color(0xFF, 0x39, 0x6E).get() + "Maximum recursion depth of "
+                        + std::to_string(max_depth) + " exceeded\n" RESET);
+                }
+                frames.back().ip = ip;
+                proto = callee_proto;
+                ip = proto->code.data();
+                base = callee_index + 1;
+                stack.resize(base + proto->slot_count, TaggedValue::undefined());
+                frames.push_back(CallFrame{proto, ip, base, memo});
+                break;
+            }
+            case OpCode::Return: {
+                TaggedValue result{std::move(stack.back())};
+                if(frames.back().memo != nullptr) {
+                    frames.back().memo->insert(memo_keys.back(), result);
+                    memo_keys.pop_back();
+                }
+                frames.pop_back();
+                if(frames.size() == entry_depth) {
+                    stack.resize(base);
+                    return result;
+                }
+                // Drops the slots and the callee below them.
+                stack.resize(base - 1);
+                stack.push_back(std::move(result));
+                proto = frames.back().proto;
+                ip = frames.back().ip;
+                base = frames.back().base;
+                break;
+            }
+            case OpCode::MakeAlgo: {
+                std::shared_ptr<FunctionProto> &function{proto->functions[ins.a]};
+                stack.push_back(make_boxed<CompiledAlgoValue>(function->name, function->def, function, this));
+                break;
+            }
+
+            case OpCode::ForPrepare: {
+                const TaggedValue &step{stack[base + ins.a + 2]};
+                double direction{step.get_kind() == ValueKind::Int ? step.get_int() : std::stod(step.get_num())};
+                if(direction == 0) {
+                    stack.push_back(make_error("Infinite for loop\n"));
+                    ip = proto->code.data() + ins.b;
+                    break;
+                }
+                stack[base + ins.a + 3] = make_int(direction > 0 ? 1 : -1);
+                break;
+            }
+            case OpCode::ForTest: {
+                const TaggedValue &counter{stack[base + ins.a]}, &end{stack[base + ins.a + 1]};
+                bool upward{stack[base + ins.a + 3].get_int() > 0};
+                bool in_range;
+                if(counter.get_kind() == ValueKind::Int && end.get_kind() == ValueKind::Int)
+                    in_range = upward ? counter.get_int() <= end.get_int() : counter.get_int() >= end.get_int();
+                else
+                    in_range = as_integer(upward ? counter <= end : counter >= end) == 1;
+                if(!in_range)
+                    ip = proto->code.data() + ins.b;
+                break;
+            }
+            case OpCode::ForStep: {
+                const TaggedValue &counter{stack[base + ins.a]}, &step{stack[base + ins.a + 2]};
+                TaggedValue next{
+                    counter.get_kind() == ValueKind::Int && step.get_kind() == ValueKind::Int ?
+                    make_int(counter.get_int() + step.get_int()) : counter + step};
+                stack[base + ins.a] = next;
+                stack.push_back(std::move(next));
+                break;
+            }
+            case OpCode::ForFill: {
+                const TaggedValue &counter{stack[base + ins.a]}, &end{stack[base + ins.a + 1]}, &step{stack[base + ins.a + 2]};
+                if(counter.get_kind() != ValueKind::Int || end.get_kind() != ValueKind::Int || step.get_kind() != ValueKind::Int)
+                    break;
+                uint64_t passes{fill_passes(counter.get_int(), end.get_int(), step.get_int())};
+                if(passes == 0)
+                    break;
+                ArrayValue *results{stack[base + ins.b].as<ArrayValue>()};
+                results->fill(results->back(), passes);
+                stack[base + ins.a] = make_int(counter_after(counter.get_int(), passes, step.get_int()));
+                break;
+            }
+        }
+    }
+}
\ No newline at end of file
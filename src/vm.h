@@ -0,0 +1,124 @@
+/// --------------------
+/// VM
+/// --------------------
+
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "value.h"
+#include "node.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Int pairs are computed in place, everything else goes through the value
+// operators, after the same error checks Interpreter::visit_bin_op does.
+inline TaggedValue binary_op(OpCode op, const TaggedValue &a, const TaggedValue &b) {
+    if(a.get_kind() == ValueKind::Int && b.get_kind() == ValueKind::Int) {
+        int64_t x{a.get_int()}, y{b.get_int()};
+        switch(op) {
+            case OpCode::Add: return make_int(x + y);
+            case OpCode::Sub: return make_int(x - y);
+            case OpCode::Mul: return make_int(x * y);
+            case OpCode::Equal: return make_int(x == y);
+            case OpCode::Neq: return make_int(x != y);
+            case OpCode::Less: return make_int(x < y);
+            case OpCode::Greater: return make_int(x > y);
+            case OpCode::Leq: return make_int(x <= y);
+            case OpCode::Geq: return make_int(x >= y);
+            default: break;
+        }
+    }
+    if(a.is_error()) return a;
+    if(b.is_error()) return b;
+    switch(op) {
+        case OpCode::Add: return a + b;
+        case OpCode::Sub: return a - b;
+        case OpCode::Mul: return a * b;
+        case OpCode::Div: return a / b;
+        case OpCode::Mod: return a % b;
+        case OpCode::Pow: return pow(a, b);
+        case OpCode::Equal: return a == b;
+        case OpCode::Neq: return a != b;
+        case OpCode::Less: return a < b;
+        case OpCode::Greater: return a > b;
+        case OpCode::Leq: return a <= b;
+        case OpCode::Geq: return a >= b;
+        case OpCode::And: return a && b;
+        case OpCode::Or: return a || b;
+        default: break;
+    }
+    return make_error("Not a binary op\n");
+}
+
+class VM;
+
+/// An Algorithm compiled for the VM. It keeps the definition node, so the
+/// tree walker can still run it through AlgoValue::call. Called without a
+/// scope, as builtins like sort call it, it runs on the VM that made it.
+class CompiledAlgoValue: public AlgoValue {
+public:
+    CompiledAlgoValue(const std::string &_algo_name, std::shared_ptr<Node> _value,
+        std::shared_ptr<FunctionProto> _proto, VM *_vm)
+        : AlgoValue(_algo_name, _value), proto(_proto), vm(_vm) {}
+    FunctionProto* get_proto() override { return proto.get();}
+    TaggedValue call(ValueSpan, SymbolTable*) override;
+protected:
+    std::shared_ptr<FunctionProto> proto;
+    VM *vm;
+};
+
+struct CallFrame {
+    FunctionProto *proto;
+    const Instruction *ip;
+    // Index of the first slot on the value stack.
+    size_t base;
+    // Set when the result goes into the cache under the last of memo_keys.
+    MemoCache *memo{nullptr};
+};
+
+/// Stack based virtual machine running the output of Compiler. Globals live
+/// as long as the VM, so a shell session keeps them between inputs.
+/// Calls between Algorithms do not recurse on the native stack, so their
+/// depth is only bounded by max_depth. An Algorithm called by a builtin,
+/// like the comparator of sort, runs in a nested execute(), and at most
+/// MAX_NESTED_RUNS of those may be open at once.
+class VM {
+public:
+    VM(size_t _max_depth = DEFAULT_MAX_DEPTH)
+        : max_depth(_max_depth) {}
+    TaggedValue run(FunctionProto&);
+    // Runs an Algorithm for a builtin in the middle of a run, above the
+    // frames there are. The arguments must not be on the VM stack.
+    TaggedValue call(FunctionProto*, ValueSpan args);
+    NameTable& get_names() { return names;}
+    void set_max_depth(size_t depth) { max_depth = depth;}
+
+    static const size_t DEFAULT_MAX_DEPTH{1000000};
+    static const size_t MAX_SPECIALIZATIONS{4};
+    static const size_t MAX_NESTED_RUNS{1000};
+
+protected:
+    TaggedValue execute(size_t entry_depth);
+    TaggedValue lookup(int name, size_t frame_index);
+    TaggedValue lookup_global(int name);
+    FunctionProto* specialize(FunctionProto*, const TaggedValue *args);
+    template<OpCode op>
+    void binary();
+    template<OpCode op, typename T>
+    void typed_binary();
+    template<OpCode op>
+    const Instruction* compare_jump(const Instruction&, const Instruction *code);
+
+    NameTable names;
+    ValueList globals;
+    ValueList stack;
+    std::vector<CallFrame> frames;
+    // execute() calls open on the native stack below the current one.
+    size_t nested_runs{0};
+    std::vector<std::string> memo_keys;
+    size_t max_depth;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Runs every test/scripts/*.ps on the tree walker, on the VM and compiled
+# with --compile, and compares what each prints with the .out file next to
+# it. A script that does not compile is compared by what --compile printed.
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+failed=0
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+
+report() {
+    if [ "$2" != "$(cat "$3")" ]; then
+        echo "FAIL $1 $4"
+        echo "$2" | diff "$3" - | head -20
+        failed=1
+    fi
+}
+
+for script in test/scripts/*.ps; do
+    expected=${script%.ps}.out
+    for engine in "" "--vm"; do
+        actual=$($SHELL_BIN $engine "$script" 2>&1)
+        report "${engine:-tree}" "$actual" "$expected" "$script"
+    done
+    name=$(basename "${script%.ps}")
+    cp "$script" "$workdir/$name.ps"
+    actual=$($SHELL_BIN --compile "$workdir/$name.ps" 2>&1)
+    if [ -x "$workdir/$name" ]; then
+        actual=$("$workdir/$name" 2>&1)
+    fi
+    report compiled "$actual" "$expected" "$script"
+done
+
+[ $failed = 0 ] && echo "script tests passed"
+exit $failed
\ No newline at end of file
@@ -0,0 +1,128 @@
+/// --------------------
+/// Unit tests
+/// --------------------
+
+#include "../src/kernels.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures{0};
+
+static void check(bool ok, const std::string &what, const Kernels &set, size_t n) {
+    if(ok) return;
+    std::cout << "FAIL " << set.name << " " << what << " n = " << n << "\n";
+    ++failures;
+}
+
+// Floats must agree bit for bit, NaN included.
+static bool same(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool same(const std::vector<double> &a, const std::vector<double> &b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0);
+}
+
+/// --------------------
+/// Kernel agreement
+/// --------------------
+
+// Every set gives what the portable one gives, for every size up to a few
+// vectors past the widest, so each tail of n % 4 elements is covered.
+static void test_kernels(const Kernels &portable, const Kernels &set) {
+    std::mt19937_64 random{42};
+    const MapOp INT_OPS[]{MapOp::Add, MapOp::Sub, MapOp::Mul,
+        MapOp::Equal, MapOp::Neq, MapOp::Less, MapOp::Greater, MapOp::Leq, MapOp::Geq};
+    const MapOp FLOAT_OPS[]{MapOp::Add, MapOp::Sub, MapOp::Mul, MapOp::Div};
+    const MapOp COMPARE_OPS[]{MapOp::Equal, MapOp::Neq, MapOp::Less, MapOp::Greater, MapOp::Leq, MapOp::Geq};
+    for(size_t n{0}; n <= 37; ++n) {
+        std::vector<int64_t> ints(n), other_ints(n);
+        std::vector<double> floats(n), other_floats(n);
+        for(size_t i{0}; i < n; ++i) {
+            // Small values repeat so that counts and finds hit, the odd huge
+            // one makes the sums wrap around.
+            ints[i] = i % 7 == 6 ? static_cast<int64_t>(random()) : static_cast<int64_t>(random() % 9) - 4;
+            other_ints[i] = static_cast<int64_t>(random() % 9) - 4;
+            floats[i] = static_cast<double>(static_cast<int64_t>(random() % 2001) - 1000) / 8;
+            other_floats[i] = i % 5 == 4 ? floats[i] : static_cast<double>(random() % 1000 + 1) / 16;
+        }
+        check(set.sum_ints(ints.data(), n) == portable.sum_ints(ints.data(), n), "sum_ints", set, n);
+        check(same(set.sum_floats(floats.data(), n), portable.sum_floats(floats.data(), n)), "sum_floats", set, n);
+        check(set.dot_ints(ints.data(), other_ints.data(), n) == portable.dot_ints(ints.data(), other_ints.data(), n),
+            "dot_ints", set, n);
+        check(same(set.dot_floats(floats.data(), other_floats.data(), n),
+            portable.dot_floats(floats.data(), other_floats.data(), n)), "dot_floats", set, n);
+        if(n > 0) {
+            check(set.min_ints(ints.data(), n) == portable.min_ints(ints.data(), n), "min_ints", set, n);
+            check(set.max_ints(ints.data(), n) == portable.max_ints(ints.data(), n), "max_ints", set, n);
+            check(same(set.min_floats(floats.data(), n), portable.min_floats(floats.data(), n)), "min_floats", set, n);
+            check(same(set.max_floats(floats.data(), n), portable.max_floats(floats.data(), n)), "max_floats", set, n);
+        }
+        for(int64_t x{-4}; x <= 4; ++x) {
+            check(set.count_ints(ints.data(), n, x) == portable.count_ints(ints.data(), n, x), "count_ints", set, n);
+            check(set.find_int(ints.data(), n, x) == portable.find_int(ints.data(), n, x), "find_int", set, n);
+            double y{n > 0 ? floats[(x + 4) % n] : 0.0};
+            check(set.count_floats(floats.data(), n, y) == portable.count_floats(floats.data(), n, y), "count_floats", set, n);
+            check(set.find_float(floats.data(), n, y) == portable.find_float(floats.data(), n, y), "find_float", set, n);
+        }
+        // A step of 0 on either side stands for a number.
+        for(size_t x_step{0}; x_step <= 1; ++x_step) {
+            for(size_t y_step{0}; y_step <= 1; ++y_step) {
+                if(n == 0 && (x_step == 0 || y_step == 0)) continue;
+                for(MapOp op : INT_OPS) {
+                    std::vector<int64_t> expected(n), actual(n);
+                    portable.map_ints(op, ints.data(), x_step, other_ints.data(), y_step, expected.data(), n);
+                    set.map_ints(op, ints.data(), x_step, other_ints.data(), y_step, actual.data(), n);
+                    check(actual == expected, "map_ints " + std::to_string(static_cast<int>(op)), set, n);
+                }
+                for(MapOp op : FLOAT_OPS) {
+                    std::vector<double> expected(n), actual(n);
+                    portable.map_floats(op, floats.data(), x_step, other_floats.data(), y_step, expected.data(), n);
+                    set.map_floats(op, floats.data(), x_step, other_floats.data(), y_step, actual.data(), n);
+                    check(same(actual, expected), "map_floats " + std::to_string(static_cast<int>(op)), set, n);
+                }
+                for(MapOp op : COMPARE_OPS) {
+                    std::vector<int64_t> expected(n), actual(n);
+                    portable.compare_floats(op, floats.data(), x_step, other_floats.data(), y_step, expected.data(), n);
+                    set.compare_floats(op, floats.data(), x_step, other_floats.data(), y_step, actual.data(), n);
+                    check(actual == expected, "compare_floats " + std::to_string(static_cast<int>(op)), set, n);
+                }
+            }
+        }
+    }
+}
+
+// The portable set against plain loops, NaN and the wrap around included.
+static void test_portable(const Kernels &portable) {
+    const double NaN{std::numeric_limits<double>::quiet_NaN()};
+    for(size_t n{1}; n <= 9; ++n) {
+        std::vector<int64_t> ints(n, std::numeric_limits<int64_t>::max());
+        check(portable.sum_ints(ints.data(), n) == static_cast<int64_t>(n * static_cast<uint64_t>(ints[0])),
+            "sum_ints wraps", portable, n);
+        std::vector<double> floats(n, 1.5);
+        floats[n / 2] = NaN;
+        check(portable.count_floats(floats.data(), n, NaN) == 0, "count_floats NaN", portable, n);
+        check(portable.find_float(floats.data(), n, NaN) == n, "find_float NaN", portable, n);
+        check(portable.count_floats(floats.data(), n, 1.5) == n - 1, "count_floats", portable, n);
+        check(portable.find_int(ints.data(), n, 0) == n, "find_int none", portable, n);
+    }
+}
+
+int main() {
+    std::vector<const Kernels*> sets{kernel_sets()};
+    test_portable(*sets[0]);
+    for(const Kernels *set : sets)
+        test_kernels(*sets[0], *set);
+    if(failures == 0) {
+        std::cout << "unit tests passed (";
+        for(size_t i{0}; i < sets.size(); ++i)
+            std::cout << (i ? ", " : "") << sets[i]->name;
+        std::cout << ")\n";
+    }
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file